@@ -0,0 +1,774 @@
+//=============================================================================
+// RayTracerBench.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "../Platform.h"
+#include "../ImageEncoder.h"
+#include "../ImageWriter.h"
+#include "../Math.h"
+#include "../MeshShape.h"
+#include "../ObjParser.h"
+#include "../Profiler.h"
+#include "../RayTracerRenderer.h"
+#include "../RayTracerScene.h"
+#include "../RenderSession.h"
+#include "../SceneSetup.h"
+#include "../SequenceRenderer.h"
+#include "../Texture.h"
+#include "../ThreadUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+#if PLATFORM_WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+	// Number of heap allocations made by the whole process, counted by the global operator new below
+	std::atomic<long long> NumHeapAllocations(0);
+}
+
+void* operator new(size_t Size)
+{
+	NumHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void* Memory = malloc(Size > 0 ? Size : 1))
+	{
+		return Memory;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* Memory) noexcept
+{
+	free(Memory);
+}
+
+namespace
+{
+	// Reference scenes rendered by the benchmark
+	struct BenchSceneDesc
+	{
+		const char* Name;
+
+		// Add spheres, capsule and ground of the default scene
+		bool bAddPrimitiveShapes;
+
+		// OBJ file of the mesh in scene, or nullptr
+		const char* MeshFilename;
+
+		// Number of mesh instances placed side by side, sharing geometry
+		int NumInstances;
+	};
+
+	const BenchSceneDesc BenchScenes[] =
+	{
+		{ "spheres",			true,	nullptr,				0 },
+		{ "BlenderMonkey",		false,	"Data/BlenderMonkey.obj",	1 },
+		{ "TorusKnot",			false,	"Data/TorusKnot.obj",		1 },
+		{ "unitychan",			false,	"Data/unitychan.obj",		1 },
+		{ "unitychan_crowd",	false,	"Data/unitychan.obj",		5 },
+	};
+
+	// Transform of an instance in a row of instances facing the camera at slightly different angles
+	RTransform GetInstanceTransform(int Index, int NumInstances)
+	{
+		if (NumInstances == 1)
+		{
+			return RTransform();
+		}
+
+		const float Offset = Index - (NumInstances - 1) * 0.5f;
+		return RTransform::MakeTranslation(RVec3(Offset * 0.7f, 0.0f, -fabsf(Offset) * 0.4f)) *
+			   RTransform::MakeRotation(RVec3(0, 1, 0), Offset * 0.3f);
+	}
+
+	struct BenchOptions
+	{
+		BenchOptions()
+			: NumSamples(4)
+			, Seed(12345)
+			, OutputFilename("BenchResults.json")
+			, bSaveImages(false)
+			, bCheckAllocations(false)
+			, bTimeEdits(false)
+			, NumDeformFrames(0)
+			, NumSequenceFrames(0)
+			, TextureBudgetMb(0)
+			, EncodeScale(0)
+		{}
+
+		// Number of sample passes timed for each thread count
+		int NumSamples;
+
+		// Seed of random numbers, set before loading and before each run
+		unsigned int Seed;
+
+		std::vector<int> ThreadCounts;
+
+		// Names of scenes to run. Runs all scenes when empty.
+		std::vector<std::string> SceneNames;
+
+		std::string OutputFilename;
+
+		// Save the image of last run of each scene for checking render results
+		bool bSaveImages;
+
+		// Fail if sample passes after the first one of a run allocate heap memory, not counting texture streaming
+		bool bCheckAllocations;
+
+		// Time previews after edits of each scene in an interactive session
+		bool bTimeEdits;
+
+		// Number of frames of a deforming copy of the mesh of each scene, timing vertex updates
+		int NumDeformFrames;
+
+		// Number of frames of an animation rendered and saved for each scene, with one sample pass per frame
+		int NumSequenceFrames;
+
+		// Memory budget of texture cache in megabytes. Uses the default budget when zero.
+		int TextureBudgetMb;
+
+		// Format and compression of saved images and sequence frames
+		ImageEncodeOptions ImageOptions;
+
+		// Time encoding the final image of each scene, tiled this many times in each direction. Not timed when zero.
+		int EncodeScale;
+	};
+
+	// Names of png filter strategies on command line, in order of the enum
+	const char* const PngFilterNames[] = { "none", "sub", "up", "average", "paeth", "adaptive" };
+
+	// Encoder settings timed for the final image of each scene
+	struct BenchEncoding
+	{
+		const char* Name;
+		ImageFileFormat Format;
+		int CompressionLevel;
+		PngFilterStrategy Filter;
+
+		// Compress stripes of the image with all hardware threads
+		bool bParallel;
+	};
+
+	const BenchEncoding BenchEncodings[] =
+	{
+		{ "png",			ImageFileFormat::PNG,	6,	PngFilterStrategy::Adaptive,	false },
+		{ "png_striped",	ImageFileFormat::PNG,	6,	PngFilterStrategy::Adaptive,	true },
+		{ "png_fast",		ImageFileFormat::PNG,	1,	PngFilterStrategy::Up,			true },
+		{ "ppm",			ImageFileFormat::PPM,	0,	PngFilterStrategy::None,		false },
+	};
+
+	// Repeat an image a number of times in each direction
+	std::vector<Pixel> TileImage(const Pixel* Pixels, int Width, int Height, int Scale)
+	{
+		std::vector<Pixel> Tiled((size_t)Width * Height * Scale * Scale);
+
+		for (int y = 0; y < Height * Scale; y++)
+		{
+			const Pixel* Row = Pixels + (y % Height) * Width;
+			for (int Tile = 0; Tile < Scale; Tile++)
+			{
+				std::copy(Row, Row + Width, Tiled.begin() + ((size_t)y * Scale + Tile) * Width);
+			}
+		}
+
+		return Tiled;
+	}
+
+	// Peak resident set size of the process in kilobytes
+	long long GetPeakResidentSetSizeKb()
+	{
+#if PLATFORM_WIN32
+		PROCESS_MEMORY_COUNTERS Counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+		{
+			return (long long)Counters.PeakWorkingSetSize / 1024;
+		}
+		return 0;
+#else
+		rusage Usage;
+		getrusage(RUSAGE_SELF, &Usage);
+#if PLATFORM_OSX
+		// Reported in bytes on OSX
+		return (long long)Usage.ru_maxrss / 1024;
+#else
+		return (long long)Usage.ru_maxrss;
+#endif
+#endif
+	}
+
+	double GetElapsedMs(const std::chrono::steady_clock::time_point& StartTime)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+	}
+
+	// Parse comma separated list of values
+	std::vector<std::string> SplitList(const char* List)
+	{
+		std::vector<std::string> Values;
+		std::string Value;
+
+		for (const char* c = List; ; c++)
+		{
+			if (*c == ',' || *c == '\0')
+			{
+				if (!Value.empty())
+				{
+					Values.push_back(Value);
+					Value.clear();
+				}
+
+				if (*c == '\0')
+				{
+					break;
+				}
+			}
+			else
+			{
+				Value += *c;
+			}
+		}
+
+		return Values;
+	}
+
+	bool ParseCommandLine(int argc, char* argv[], BenchOptions& Options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const bool bHasValue = (i + 1 < argc);
+
+			if (!strcmp(argv[i], "--samples") && bHasValue)
+			{
+				Options.NumSamples = Math::Max(atoi(argv[++i]), 1);
+			}
+			else if (!strcmp(argv[i], "--seed") && bHasValue)
+			{
+				Options.Seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+			}
+			else if (!strcmp(argv[i], "--threads") && bHasValue)
+			{
+				for (const std::string& Value : SplitList(argv[++i]))
+				{
+					Options.ThreadCounts.push_back(Math::Max(atoi(Value.c_str()), 1));
+				}
+			}
+			else if (!strcmp(argv[i], "--scenes") && bHasValue)
+			{
+				Options.SceneNames = SplitList(argv[++i]);
+			}
+			else if (!strcmp(argv[i], "--output") && bHasValue)
+			{
+				Options.OutputFilename = argv[++i];
+			}
+			else if (!strcmp(argv[i], "--save-images"))
+			{
+				Options.bSaveImages = true;
+			}
+			else if (!strcmp(argv[i], "--check-allocations"))
+			{
+				Options.bCheckAllocations = true;
+			}
+			else if (!strcmp(argv[i], "--edits"))
+			{
+				Options.bTimeEdits = true;
+			}
+			else if (!strcmp(argv[i], "--deform") && bHasValue)
+			{
+				Options.NumDeformFrames = Math::Max(atoi(argv[++i]), 1);
+			}
+			else if (!strcmp(argv[i], "--sequence") && bHasValue)
+			{
+				Options.NumSequenceFrames = Math::Max(atoi(argv[++i]), 1);
+			}
+			else if (!strcmp(argv[i], "--texture-budget") && bHasValue)
+			{
+				Options.TextureBudgetMb = Math::Max(atoi(argv[++i]), 1);
+			}
+			else if (!strcmp(argv[i], "--image-format") && bHasValue)
+			{
+				i++;
+				Options.ImageOptions.Format = !strcmp(argv[i], "ppm") ? ImageFileFormat::PPM : ImageFileFormat::PNG;
+			}
+			else if (!strcmp(argv[i], "--compression") && bHasValue)
+			{
+				Options.ImageOptions.CompressionLevel = Math::Max(Math::Min(atoi(argv[++i]), 9), 0);
+			}
+			else if (!strcmp(argv[i], "--png-filter") && bHasValue)
+			{
+				i++;
+				for (int Filter = 0; Filter < (int)(sizeof(PngFilterNames) / sizeof(PngFilterNames[0])); Filter++)
+				{
+					if (!strcmp(argv[i], PngFilterNames[Filter]))
+					{
+						Options.ImageOptions.Filter = (PngFilterStrategy)Filter;
+					}
+				}
+			}
+			else if (!strcmp(argv[i], "--encode-threads") && bHasValue)
+			{
+				Options.ImageOptions.MaxThreads = Math::Max(atoi(argv[++i]), 1);
+			}
+			else if (!strcmp(argv[i], "--encode") && bHasValue)
+			{
+				Options.EncodeScale = Math::Max(atoi(argv[++i]), 1);
+			}
+			else
+			{
+				printf("Usage: RayTracerBench [--samples N] [--seed N] [--threads 1,2,4] [--scenes spheres,unitychan] [--output BenchResults.json] [--save-images] [--check-allocations] [--edits] [--deform N] [--sequence N] [--texture-budget MB]"
+					" [--image-format png|ppm] [--compression 0-9] [--png-filter none|sub|up|average|paeth|adaptive] [--encode-threads N] [--encode SCALE]\n");
+				return false;
+			}
+		}
+
+		// Default to powers of two up to the number of hardware threads
+		if (Options.ThreadCounts.empty())
+		{
+			const int MaxThreads = ThreadUtils::DetectWorkerThreadsNum();
+			for (int Threads = 1; Threads < MaxThreads; Threads *= 2)
+			{
+				Options.ThreadCounts.push_back(Threads);
+			}
+			Options.ThreadCounts.push_back(MaxThreads);
+		}
+
+		return true;
+	}
+
+	// Edit of the scene applied by an interactive session
+	struct BenchEdit
+	{
+		const char* Name;
+
+		// Queue the edit in a session
+		void (*Apply)(RenderSession& Session);
+	};
+
+	const BenchEdit BenchEdits[] =
+	{
+		{ "camera",		[](RenderSession& Session) { Session.SetCamera(RCamera::MakeLookAt(RVec3(3.0f, 1.0f, 6.0f), RVec3(0, 0, 0))); } },
+		{ "material",	[](RenderSession& Session) { Session.SetShapeMaterial(0, unique_ptr<ISurfaceMaterial>(new SurfaceMaterial_Diffuse(RVec3(0.8f, 0.2f, 0.2f)))); } },
+		{ "move",		[](RenderSession& Session) { Session.MoveShape(0, RVec3(0.5f, 0.0f, 0.0f)); } },
+	};
+
+	// Average time of updating vertices of a mesh for a number of frames of a wave deformation, in milliseconds.
+	// Positions are in order of the source file, as an animation would provide them. Outputs positions of the last frame.
+	double TimeMeshDeformation(RMeshShape& Mesh, const std::vector<RVec3>& RestPoints, int NumFrames, std::vector<RVec3>& OutPoints)
+	{
+		const RAabb Bounds = Mesh.GetBounds();
+		const RVec3 Size = Bounds.pMax - Bounds.pMin;
+
+		OutPoints.resize(RestPoints.size());
+		double TotalTimeMs = 0.0;
+
+		for (int Frame = 0; Frame < NumFrames; Frame++)
+		{
+			// Sway the mesh sideways, more at the top than at the bottom
+			for (int i = 0; i < (int)OutPoints.size(); i++)
+			{
+				const float Height = (RestPoints[i].y - Bounds.pMin.y) / Size.y;
+				OutPoints[i] = RestPoints[i] + RVec3(Size.x * 0.1f * Height * sinf(Height * 6.0f + Frame * 0.5f), 0.0f, 0.0f);
+			}
+
+			const auto StartTime = std::chrono::steady_clock::now();
+			Mesh.UpdatePoints(OutPoints.data(), (int)OutPoints.size());
+			TotalTimeMs += GetElapsedMs(StartTime);
+		}
+
+		return TotalTimeMs / NumFrames;
+	}
+
+	// Random rays compared between a refitted tree and a fresh build after deformation
+	const int NumRefitCheckRays = 20000;
+
+	// Count random rays through a deformed mesh whose closest hits differ from a fresh build of the same points.
+	// Triangle tests depend slightly on ray length, so distances are compared with a small tolerance.
+	int CountRefitMismatches(const RMeshShape& RefitMesh, const char* MeshFilename, const std::vector<RVec3>& SourcePoints, int NumRays)
+	{
+		unique_ptr<RMeshShape> BuiltMesh = RMeshShape::Create(MeshFilename);
+		BuiltMesh->UpdatePoints(SourcePoints.data(), (int)SourcePoints.size());
+		BuiltMesh->RebuildSpatial();
+
+		const RAabb Bounds = RefitMesh.GetBounds();
+		const RVec3 Center = (Bounds.pMin + Bounds.pMax) * 0.5f;
+		const float Radius = (Bounds.pMax - Bounds.pMin).Magnitude();
+
+		int NumMismatches = 0;
+		for (int i = 0; i < NumRays; i++)
+		{
+			// Rays start outside of the mesh and aim at a point inside its bounds
+			const RVec3 Origin = Center + RMath::RandomUnitVector() * Radius;
+			const RVec3 Target(RMath::RandomRange(Bounds.pMin.x, Bounds.pMax.x),
+							   RMath::RandomRange(Bounds.pMin.y, Bounds.pMax.y),
+							   RMath::RandomRange(Bounds.pMin.z, Bounds.pMax.z));
+			const RRay Ray(Origin, (Target - Origin).GetNormalizedVec3(), Radius * 2.0f);
+
+			RayHitResult RefitResult, BuiltResult;
+			const bool bRefitHit = RefitMesh.TestRayIntersection(Ray, &RefitResult);
+			const bool bBuiltHit = BuiltMesh->TestRayIntersection(Ray, &BuiltResult);
+
+			if (bRefitHit != bBuiltHit || (bRefitHit && fabsf(RefitResult.Distance - BuiltResult.Distance) > BuiltResult.Distance * 1e-3f))
+			{
+				NumMismatches++;
+			}
+		}
+
+		return NumMismatches;
+	}
+
+	bool ShouldRunScene(const BenchOptions& Options, const char* SceneName)
+	{
+		if (Options.SceneNames.empty())
+		{
+			return true;
+		}
+
+		for (const std::string& Name : Options.SceneNames)
+		{
+			if (Name == SceneName)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	BenchOptions Options;
+	if (!ParseCommandLine(argc, argv, Options))
+	{
+		return 1;
+	}
+
+	PROFILE_THREAD_NAME("Main");
+
+	FILE* OutputFile = fopen(Options.OutputFilename.c_str(), "w");
+	if (!OutputFile)
+	{
+		RLog("Unable to open %s for writing!\n", Options.OutputFilename.c_str());
+		return 1;
+	}
+
+	if (Options.TextureBudgetMb > 0)
+	{
+		RTexture::SetMemoryBudget((size_t)Options.TextureBudgetMb * 1024 * 1024);
+	}
+
+	srand(Options.Seed);
+
+	RLog("Initializing pseudo random numbers... ");
+	RMath::InitPseudoRandomUnitVector();
+	RLog("Done\n");
+
+	fprintf(OutputFile, "{\n");
+	fprintf(OutputFile, "  \"width\": %d,\n", bitmapWidth);
+	fprintf(OutputFile, "  \"height\": %d,\n", bitmapHeight);
+	fprintf(OutputFile, "  \"samples\": %d,\n", Options.NumSamples);
+	fprintf(OutputFile, "  \"seed\": %u,\n", Options.Seed);
+	fprintf(OutputFile, "  \"scenes\": [");
+
+	// Saves images of all scenes in the background
+	ImageWriter Writer;
+	Writer.SetEncodeOptions(Options.ImageOptions);
+
+	bool bFirstScene = true;
+	bool bAllocationCheckFailed = false;
+	bool bRefitCheckFailed = false;
+	for (const BenchSceneDesc& SceneDesc : BenchScenes)
+	{
+		if (!ShouldRunScene(Options, SceneDesc.Name))
+		{
+			continue;
+		}
+
+		RLog("Benchmarking scene %s...\n", SceneDesc.Name);
+
+		RayTracerScene Scene;
+		double LoadTimeMs = 0.0;
+		double BuildTimeMs = 0.0;
+		int NumTriangles = 0;
+
+		const auto LoadStartTime = std::chrono::steady_clock::now();
+
+		if (SceneDesc.bAddPrimitiveShapes)
+		{
+			SceneSetup::AddPrimitiveShapes(Scene);
+			LoadTimeMs = GetElapsedMs(LoadStartTime);
+		}
+
+		for (int i = 0; i < SceneDesc.NumInstances; i++)
+		{
+			const RMeshInstance* Instance = SceneSetup::AddMesh(Scene, SceneDesc.MeshFilename, GetInstanceTransform(i, SceneDesc.NumInstances));
+			NumTriangles += Instance->GetMesh()->GetNumTriangles();
+
+			// Geometry is only loaded by the first instance
+			if (i == 0)
+			{
+				LoadTimeMs += Instance->GetMesh()->GetLoadTimeMs();
+				BuildTimeMs = Instance->GetMesh()->GetBuildTimeMs();
+			}
+		}
+
+		fprintf(OutputFile, "%s\n    {\n", bFirstScene ? "" : ",");
+		fprintf(OutputFile, "      \"name\": \"%s\",\n", SceneDesc.Name);
+		fprintf(OutputFile, "      \"triangles\": %d,\n", NumTriangles);
+		fprintf(OutputFile, "      \"load_time_ms\": %.3f,\n", LoadTimeMs);
+		fprintf(OutputFile, "      \"build_time_ms\": %.3f,\n", BuildTimeMs);
+
+		// Positions of the source file drive the deformation, read the same way an animation would be exported
+		ObjMeshData SourceMeshData;
+		if (Options.NumDeformFrames > 0 && SceneDesc.MeshFilename && ObjParser::ParseObjFile(SceneDesc.MeshFilename, SourceMeshData))
+		{
+			// Shared meshes are const, deform a copy of its own
+			unique_ptr<RMeshShape> DeformedMesh = RMeshShape::Create(SceneDesc.MeshFilename);
+
+			std::vector<RVec3> DeformedPoints;
+			const double UpdateTimeMs = TimeMeshDeformation(*DeformedMesh, SourceMeshData.Points, Options.NumDeformFrames, DeformedPoints);
+
+			RLog("%s: %.3fms per deformed frame of %d positions (%d welded vertices), %.3fms per build\n",
+				SceneDesc.Name, UpdateTimeMs, (int)DeformedPoints.size(), DeformedMesh->GetNumPoints(), DeformedMesh->GetBuildTimeMs());
+			fprintf(OutputFile, "      \"deform_update_time_ms\": %.3f,\n", UpdateTimeMs);
+
+			// Refitted tree must find the same hits as a tree built for the last frame
+			const int NumRefitMismatches = CountRefitMismatches(*DeformedMesh, SceneDesc.MeshFilename, DeformedPoints, NumRefitCheckRays);
+			if (NumRefitMismatches > 0)
+			{
+				RLog("%s: %d of %d rays hit differently after refitting\n", SceneDesc.Name, NumRefitMismatches, NumRefitCheckRays);
+				bRefitCheckFailed = true;
+			}
+
+			fprintf(OutputFile, "      \"deform_refit_mismatches\": %d,\n", NumRefitMismatches);
+		}
+
+		fprintf(OutputFile, "      \"runs\": [");
+		bFirstScene = false;
+
+		// Final image of the scene tiled for timing encoders
+		std::vector<Pixel> EncodeImage;
+
+		for (int RunIndex = 0; RunIndex < (int)Options.ThreadCounts.size(); RunIndex++)
+		{
+			const int ThreadCount = Options.ThreadCounts[RunIndex];
+
+			srand(Options.Seed);
+
+			RayTracerRenderer Renderer;
+			Renderer.StartWorkers(&Scene, ThreadCount);
+
+			// The first pass warms up buffers of the renderer. Later passes are expected to run without heap allocations,
+			// except for passes still streaming in texture pages, which are allowed to fill the texture cache.
+			long long SteadyStateAllocations = 0;
+			int NumSteadyStatePasses = 0;
+
+			const auto RenderStartTime = std::chrono::steady_clock::now();
+			for (int Sample = 0; Sample < Options.NumSamples; Sample++)
+			{
+				const long long AllocationsBefore = NumHeapAllocations;
+				const long long PageLoadsBefore = RTexture::GetNumPageLoads();
+
+				Renderer.RenderPass();
+
+				if (Sample > 0 && RTexture::GetNumPageLoads() == PageLoadsBefore)
+				{
+					SteadyStateAllocations += NumHeapAllocations - AllocationsBefore;
+					NumSteadyStatePasses++;
+				}
+			}
+			const double RenderTimeMs = GetElapsedMs(RenderStartTime);
+
+			if (SteadyStateAllocations > 0)
+			{
+				RLog("%s, %d threads: %lld heap allocations in %d steady state sample passes\n", SceneDesc.Name, ThreadCount, SteadyStateAllocations, NumSteadyStatePasses);
+				bAllocationCheckFailed = true;
+			}
+
+			Renderer.StopWorkers();
+
+			if (Options.bSaveImages && RunIndex == (int)Options.ThreadCounts.size() - 1)
+			{
+				Renderer.ResolveAccumulationBuffer();
+
+				const std::string ImageFilename = std::string("Bench_") + SceneDesc.Name + ImageEncoder::GetFileExtension(Options.ImageOptions.Format);
+				Writer.WriteImage(ImageFilename, Renderer.GetPixelBuffer(), bitmapWidth, bitmapHeight);
+
+#if ENABLE_TRAVERSAL_STATS
+				Renderer.SaveTraversalHeatmap(std::string("BenchHeatmap_") + SceneDesc.Name + ".png");
+#endif
+			}
+
+			if (Options.EncodeScale > 0 && RunIndex == (int)Options.ThreadCounts.size() - 1)
+			{
+				Renderer.ResolveAccumulationBuffer();
+				EncodeImage = TileImage(Renderer.GetPixelBuffer(), bitmapWidth, bitmapHeight, Options.EncodeScale);
+			}
+
+			const double RenderTimeSeconds = Math::Max(RenderTimeMs / 1000.0, 1e-6);
+			const double PrimaryRaysPerSecond = Renderer.GetNumPrimaryRays() / RenderTimeSeconds;
+			const double TotalRaysPerSecond = Renderer.GetNumTracedRays() / RenderTimeSeconds;
+
+			RLog("%s, %d threads: %.0f primary rays/s, %.0f total rays/s\n", SceneDesc.Name, ThreadCount, PrimaryRaysPerSecond, TotalRaysPerSecond);
+
+			fprintf(OutputFile, "%s\n        {\n", RunIndex == 0 ? "" : ",");
+			fprintf(OutputFile, "          \"threads\": %d,\n", ThreadCount);
+			fprintf(OutputFile, "          \"render_time_ms\": %.3f,\n", RenderTimeMs);
+			fprintf(OutputFile, "          \"primary_rays\": %lld,\n", Renderer.GetNumPrimaryRays());
+			fprintf(OutputFile, "          \"total_rays\": %lld,\n", Renderer.GetNumTracedRays());
+			fprintf(OutputFile, "          \"primary_rays_per_second\": %.1f,\n", PrimaryRaysPerSecond);
+			fprintf(OutputFile, "          \"total_rays_per_second\": %.1f,\n", TotalRaysPerSecond);
+#if ENABLE_TRAVERSAL_STATS
+			const TraversalCounters& Traversal = Renderer.GetTotalTraversalCounters();
+			TraversalStats::LogCounters(SceneDesc.Name, Traversal);
+
+			fprintf(OutputFile, "          \"traversal\": { \"rays\": %lld, \"shapes_tested\": %lld, \"nodes_visited\": %lld, \"aabb_tests\": %lld, \"triangle_tests\": %lld },\n",
+				Traversal.Rays, Traversal.ShapesTested, Traversal.NodesVisited, Traversal.AabbTests, Traversal.TriangleTests);
+#endif
+			fprintf(OutputFile, "          \"steady_state_passes\": %d,\n", NumSteadyStatePasses);
+			fprintf(OutputFile, "          \"steady_state_allocations\": %lld,\n", SteadyStateAllocations);
+			fprintf(OutputFile, "          \"texture_resident_kb\": %lld,\n", (long long)(RTexture::GetResidentMemorySize() / 1024));
+			fprintf(OutputFile, "          \"peak_rss_kb\": %lld\n", GetPeakResidentSetSizeKb());
+			fprintf(OutputFile, "        }");
+		}
+
+		fprintf(OutputFile, "\n      ]");
+
+		if (!EncodeImage.empty())
+		{
+			const int EncodeWidth = bitmapWidth * Options.EncodeScale;
+			const int EncodeHeight = bitmapHeight * Options.EncodeScale;
+			std::vector<unsigned char> EncodedData;
+
+			fprintf(OutputFile, ",\n      \"encoding\": [");
+
+			for (int EncodingIndex = 0; EncodingIndex < (int)(sizeof(BenchEncodings) / sizeof(BenchEncodings[0])); EncodingIndex++)
+			{
+				const BenchEncoding& Encoding = BenchEncodings[EncodingIndex];
+
+				ImageEncodeOptions EncodeOptions;
+				EncodeOptions.Format = Encoding.Format;
+				EncodeOptions.CompressionLevel = Encoding.CompressionLevel;
+				EncodeOptions.Filter = Encoding.Filter;
+				EncodeOptions.MaxThreads = Encoding.bParallel ? ThreadUtils::DetectWorkerThreadsNum() : 1;
+
+				const auto EncodeStartTime = std::chrono::steady_clock::now();
+				ImageEncoder::EncodeImage(EncodeImage.data(), EncodeWidth, EncodeHeight, EncodeOptions, EncodedData);
+				const double EncodeTimeMs = GetElapsedMs(EncodeStartTime);
+
+				RLog("%s, %dx%d %s: %.1fms, %d bytes\n", SceneDesc.Name, EncodeWidth, EncodeHeight, Encoding.Name, EncodeTimeMs, (int)EncodedData.size());
+
+				fprintf(OutputFile, "%s\n        { \"encoding\": \"%s\", \"width\": %d, \"height\": %d, \"encode_time_ms\": %.3f, \"bytes\": %lld }",
+					EncodingIndex == 0 ? "" : ",", Encoding.Name, EncodeWidth, EncodeHeight, EncodeTimeMs, (long long)EncodedData.size());
+			}
+
+			fprintf(OutputFile, "\n      ]");
+		}
+
+		if (Options.bTimeEdits)
+		{
+			RayTracerRenderer Renderer;
+			Renderer.StartWorkers(&Scene, Options.ThreadCounts.back());
+
+			// Edits are made to an image that has samples accumulated
+			RenderSession Session(Scene, Renderer);
+			Session.RenderNextPass();
+
+			fprintf(OutputFile, ",\n      \"edits\": [");
+
+			for (int EditIndex = 0; EditIndex < (int)(sizeof(BenchEdits) / sizeof(BenchEdits[0])); EditIndex++)
+			{
+				const BenchEdit& Edit = BenchEdits[EditIndex];
+				Edit.Apply(Session);
+
+				// Time from applying the edit until its preview is done
+				const auto PreviewStartTime = std::chrono::steady_clock::now();
+				Session.RenderNextPass();
+				const double PreviewTimeMs = GetElapsedMs(PreviewStartTime);
+
+				const auto SampleStartTime = std::chrono::steady_clock::now();
+				Session.RenderNextPass();
+				const double SampleTimeMs = GetElapsedMs(SampleStartTime);
+
+				RLog("%s, %s edit: %.1fms preview, %.1fms sample pass\n", SceneDesc.Name, Edit.Name, PreviewTimeMs, SampleTimeMs);
+
+				fprintf(OutputFile, "%s\n        { \"edit\": \"%s\", \"preview_time_ms\": %.3f, \"sample_pass_time_ms\": %.3f }", EditIndex == 0 ? "" : ",", Edit.Name, PreviewTimeMs, SampleTimeMs);
+			}
+
+			fprintf(OutputFile, "\n      ]");
+
+			Renderer.StopWorkers();
+		}
+
+		if (Options.NumSequenceFrames > 0)
+		{
+			RayTracerRenderer Renderer;
+			Renderer.StartWorkers(&Scene, Options.ThreadCounts.back());
+
+			// Camera turns halfway around the scene while the first shape rises
+			const int LastFrame = Options.NumSequenceFrames - 1;
+			AnimationSequence Sequence;
+			Sequence.AddCameraKeyframe(0, RVec3(0.0f, 0.0f, 7.0f), RVec3(0, 0, 0));
+			Sequence.AddCameraKeyframe(LastFrame / 2, RVec3(5.0f, 1.0f, 5.0f), RVec3(0, 0, 0));
+			Sequence.AddCameraKeyframe(LastFrame, RVec3(7.0f, 2.0f, 0.0f), RVec3(0, 0, 0));
+			Sequence.AddShapeKeyframe(0, 0, RVec3(0, 0, 0));
+			Sequence.AddShapeKeyframe(0, LastFrame, RVec3(0.0f, 1.0f, 0.0f));
+
+			SequenceRenderer Sequencer(Scene, Renderer);
+			Sequencer.SetEncodeOptions(Options.ImageOptions);
+			const SequenceStats Stats = Sequencer.RenderFrames(Sequence, 0, LastFrame, 1, std::string("BenchSequence_") + SceneDesc.Name + "_");
+
+			Renderer.StopWorkers();
+
+			// Time of each frame spent outside of sample passes, including waiting for frames to be written
+			const double FrameOverheadMs = (Stats.TotalTimeMs - Stats.RenderTimeMs) / Math::Max(Stats.NumFrames, 1);
+
+			RLog("%s: %d frames in %.1fms, %.3fms overhead per frame\n", SceneDesc.Name, Stats.NumFrames, Stats.TotalTimeMs, FrameOverheadMs);
+
+			fprintf(OutputFile, ",\n      \"sequence\": { \"frames\": %d, \"total_time_ms\": %.3f, \"render_time_ms\": %.3f, \"write_wait_time_ms\": %.3f, \"frame_overhead_ms\": %.3f }",
+				Stats.NumFrames, Stats.TotalTimeMs, Stats.RenderTimeMs, Stats.WriteWaitTimeMs, FrameOverheadMs);
+		}
+
+		fprintf(OutputFile, "\n    }");
+	}
+
+	fprintf(OutputFile, "\n  ]\n}\n");
+	fclose(OutputFile);
+
+	Writer.Flush();
+
+	RLog("Benchmark results saved as %s\n", Options.OutputFilename.c_str());
+
+#if ENABLE_PROFILER
+	Profiler::WriteChromeTrace("BenchTrace.json");
+#endif
+
+	if (Options.bCheckAllocations && bAllocationCheckFailed)
+	{
+		RLog("Allocation check failed\n");
+		return 1;
+	}
+
+	if (bRefitCheckFailed)
+	{
+		RLog("Refit check failed\n");
+		return 1;
+	}
+
+	return 0;
+}
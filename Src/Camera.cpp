@@ -0,0 +1,25 @@
+//=============================================================================
+// Camera.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "Camera.h"
+
+RCamera::RCamera()
+	: Position(0, 0, 7.0f)
+	, AxisX(1, 0, 0)
+	, AxisY(0, 1, 0)
+	, Forward(0, 0, -1)
+{
+}
+
+RCamera RCamera::MakeLookAt(const RVec3& InPosition, const RVec3& InTarget, const RVec3& InUp /*= RVec3(0, 1, 0)*/)
+{
+	RCamera Camera;
+	Camera.Position = InPosition;
+	Camera.Forward = (InTarget - InPosition).GetNormalizedVec3();
+	Camera.AxisX = RVec3::Cross(Camera.Forward, InUp).GetNormalizedVec3();
+	Camera.AxisY = RVec3::Cross(Camera.AxisX, Camera.Forward);
+	return Camera;
+}
@@ -0,0 +1,46 @@
+//=============================================================================
+// Camera.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "Platform.h"
+#include "RVector.h"
+
+// Pinhole camera. View rays start from the camera position and pass through an image plane
+// at distance 0.5 in front of the camera.
+class RCamera
+{
+public:
+	// Camera at (0, 0, 7) looking down the negative z axis
+	RCamera();
+
+	// Camera at a position looking at a target point
+	static RCamera MakeLookAt(const RVec3& InPosition, const RVec3& InTarget, const RVec3& InUp = RVec3(0, 1, 0));
+
+	const RVec3& GetPosition() const;
+
+	// Direction from the camera through a point of the image plane. Not normalized.
+	RVec3 GetImagePlaneDirection(float x, float y) const;
+
+private:
+	RVec3 Position;
+
+	// Axes of the image plane and the view direction
+	RVec3 AxisX;
+	RVec3 AxisY;
+	RVec3 Forward;
+};
+
+
+FORCEINLINE const RVec3& RCamera::GetPosition() const
+{
+	return Position;
+}
+
+FORCEINLINE RVec3 RCamera::GetImagePlaneDirection(float x, float y) const
+{
+	return AxisX * x + AxisY * y + Forward * 0.5f;
+}
@@ -0,0 +1,46 @@
+//=============================================================================
+// ColorBuffer.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "ColorBuffer.h"
+
+namespace
+{
+	// 20 exponents with 128 mantissa steps each, plus one entry for 1.0
+	const int LinearToGammaTableSize = 20 * 128 + 1;
+}
+
+BYTE LinearToGammaByteTable[LinearToGammaTableSize];
+float GammaByteToLinearTable[256];
+
+namespace
+{
+	struct LinearToGammaTableInitializer
+	{
+		LinearToGammaTableInitializer()
+		{
+			static const float exponent = 1.0f / 2.2f;
+
+			for (int i = 0; i < LinearToGammaTableSize - 1; i++)
+			{
+				// Use the middle value of each bucket
+				UINT32 Bits = LinearToGammaTableMinBits + (i << 16) + (1 << 15);
+				float Value;
+				memcpy(&Value, &Bits, sizeof(Value));
+
+				LinearToGammaByteTable[i] = (BYTE)(powf(Value, exponent) * 255);
+			}
+
+			LinearToGammaByteTable[LinearToGammaTableSize - 1] = 255;
+
+			for (int i = 0; i < 256; i++)
+			{
+				GammaByteToLinearTable[i] = powf((float)i / 255, 2.2f);
+			}
+		}
+	};
+
+	LinearToGammaTableInitializer TableInitializer;
+}
@@ -8,6 +8,7 @@
 #include "Platform.h"
 #include "RVector.h"
 #include <math.h>
+#include <string.h>
 
 typedef UINT32 Pixel;
 typedef unsigned char BYTE;
@@ -67,6 +68,14 @@ FORCEINLINE BYTE GetUint32ColorBlue(UINT32 Color)
 #endif
 }
 
+// Linear value of each 8-bit gamma space value
+extern float GammaByteToLinearTable[256];
+
+FORCEINLINE float GammaByteToLinear(BYTE Value)
+{
+	return GammaByteToLinearTable[Value];
+}
+
 FORCEINLINE RVec3 GammaToLinear(const RVec3& color)
 {
 	static const float exponent = 2.2f;
@@ -107,3 +116,29 @@ FORCEINLINE UINT32 MakePixelColor(const RVec3& color)
 	int b = int(Math::Min(Math::Max(color.z, 0.0f), 1.0f) * 255);
 	return MakeUint32Color(r, g, b, 255);
 }
+
+// Lookup table for converting a linear color channel to 8-bit gamma space value.
+// Indexed by the exponent and top 7 mantissa bits of a float clamped to [2^-20, 1].
+extern BYTE LinearToGammaByteTable[];
+
+// Bit pattern of the smallest value in the lookup table (2^-20)
+const UINT32 LinearToGammaTableMinBits = (127 - 20) << 23;
+
+// Convert a linear color channel to 8-bit gamma space value without calling powf
+FORCEINLINE BYTE LinearToGammaByte(float Value)
+{
+	static const float MinValue = 1.0f / (1 << 20);
+
+	// Clamping also maps NaN to the smallest value
+	Value = Math::Min(Math::Max(Value, MinValue), 1.0f);
+
+	UINT32 Bits;
+	memcpy(&Bits, &Value, sizeof(Bits));
+	return LinearToGammaByteTable[(Bits - LinearToGammaTableMinBits) >> 16];
+}
+
+// Pack linear rgb color to 32 bit gamma space pixel
+FORCEINLINE UINT32 MakeGammaSpacePixelColor(const RVec3& color)
+{
+	return MakeUint32Color(LinearToGammaByte(color.x), LinearToGammaByte(color.y), LinearToGammaByte(color.z), 255);
+}
@@ -0,0 +1,406 @@
+//=============================================================================
+// ImageEncoder.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "ImageEncoder.h"
+
+#include "MathHelper.h"
+#include "ThreadUtils.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include "zlib.h"
+
+namespace
+{
+	// Stripes are kept long enough for deflate to find matches in previous rows
+	const int MinRowsPerPngStripe = 32;
+
+	// Bytes of a pixel in rgb format
+	const int RgbPixelSize = 3;
+
+	const int NumPngFilters = 5;
+
+	// Rows of a png compressed separately as a raw deflate stream
+	struct PngStripe
+	{
+		int FirstRow;
+		int NumRows;
+
+		// Compressed rows. Stripes other than the last one end on a byte boundary without a final block, so they can be concatenated.
+		std::vector<unsigned char> Data;
+
+		// Adler-32 checksum of the filtered rows of the stripe
+		uLong Adler;
+
+		bool bSucceeded;
+	};
+
+	void ConvertRowToRgb(const Pixel* Pixels, int Width, unsigned char* OutRow)
+	{
+		for (int x = 0; x < Width; x++)
+		{
+			const Pixel Color = Pixels[x];
+			OutRow[x * 3] = GetUint32ColorRed(Color);
+			OutRow[x * 3 + 1] = GetUint32ColorGreen(Color);
+			OutRow[x * 3 + 2] = GetUint32ColorBlue(Color);
+		}
+	}
+
+	FORCEINLINE unsigned char PaethPredictor(int a, int b, int c)
+	{
+		const int p = a + b - c;
+		const int pa = abs(p - a);
+		const int pb = abs(p - b);
+		const int pc = abs(p - c);
+
+		if (pa <= pb && pa <= pc)
+		{
+			return (unsigned char)a;
+		}
+
+		return (unsigned char)(pb <= pc ? b : c);
+	}
+
+	// Filter a row by a filter type of png. Output starts with the filter type byte.
+	void FilterRow(int FilterType, const unsigned char* Row, const unsigned char* PreviousRow, int RowSize, unsigned char* OutRow)
+	{
+		OutRow[0] = (unsigned char)FilterType;
+		unsigned char* Out = OutRow + 1;
+
+		for (int i = 0; i < RowSize; i++)
+		{
+			const int a = (i >= RgbPixelSize) ? Row[i - RgbPixelSize] : 0;
+			const int b = PreviousRow[i];
+			const int c = (i >= RgbPixelSize) ? PreviousRow[i - RgbPixelSize] : 0;
+
+			switch (FilterType)
+			{
+			case 0:
+				Out[i] = Row[i];
+				break;
+			case 1:
+				Out[i] = (unsigned char)(Row[i] - a);
+				break;
+			case 2:
+				Out[i] = (unsigned char)(Row[i] - b);
+				break;
+			case 3:
+				Out[i] = (unsigned char)(Row[i] - ((a + b) >> 1));
+				break;
+			default:
+				Out[i] = (unsigned char)(Row[i] - PaethPredictor(a, b, c));
+				break;
+			}
+		}
+	}
+
+	// Sum of filtered bytes as signed values. Rows with smaller sums usually compress better.
+	int GetFilteredRowCost(const unsigned char* FilteredRow, int RowSize)
+	{
+		int Cost = 0;
+		for (int i = 1; i <= RowSize; i++)
+		{
+			Cost += abs((int)(signed char)FilteredRow[i]);
+		}
+
+		return Cost;
+	}
+
+	// Feed input of the stream to deflate, growing output buffer when it's full
+	bool DeflateInput(z_stream& Stream, int Flush, std::vector<unsigned char>& Output)
+	{
+		while (1)
+		{
+			if (Stream.avail_out == 0)
+			{
+				Output.resize(Output.size() * 2);
+				Stream.next_out = Output.data() + Stream.total_out;
+				Stream.avail_out = (uInt)(Output.size() - Stream.total_out);
+			}
+
+			const int Result = deflate(&Stream, Flush);
+			if (Result == Z_STREAM_ERROR)
+			{
+				return false;
+			}
+
+			// Flushes are complete once deflate leaves some output space unused
+			if (Flush == Z_FINISH ? (Result == Z_STREAM_END) : (Stream.avail_in == 0 && Stream.avail_out != 0))
+			{
+				return true;
+			}
+		}
+	}
+
+	// Filter and compress rows of a stripe
+	void CompressPngStripe(const Pixel* Pixels, int Width, const ImageEncodeOptions& Options, bool bLastStripe, PngStripe& Stripe)
+	{
+		Stripe.bSucceeded = false;
+		Stripe.Adler = adler32(0L, Z_NULL, 0);
+
+		z_stream Stream;
+		memset(&Stream, 0, sizeof(Stream));
+
+		// Filtered rows compress better with matches limited by filtered strategy, same as libpng does
+		const int Strategy = (Options.Filter == PngFilterStrategy::None) ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+		const int Level = Math::Max(Math::Min(Options.CompressionLevel, 9), 0);
+
+		// Negative window bits make a raw stream without zlib header and checksum
+		if (deflateInit2(&Stream, Level, Z_DEFLATED, -MAX_WBITS, 8, Strategy) != Z_OK)
+		{
+			return;
+		}
+
+		const int RowSize = Width * RgbPixelSize;
+		Stripe.Data.resize(deflateBound(&Stream, (uLong)(RowSize + 1) * Stripe.NumRows) + 16);
+		Stream.next_out = Stripe.Data.data();
+		Stream.avail_out = (uInt)Stripe.Data.size();
+
+		std::vector<unsigned char> Row(RowSize);
+		std::vector<unsigned char> PreviousRow(RowSize, 0);
+		std::vector<unsigned char> FilteredRows((RowSize + 1) * NumPngFilters);
+
+		// Filters of the first row look at the last row of the previous stripe
+		if (Stripe.FirstRow > 0)
+		{
+			ConvertRowToRgb(Pixels + (Stripe.FirstRow - 1) * Width, Width, PreviousRow.data());
+		}
+
+		bool bSucceeded = true;
+		for (int i = 0; i < Stripe.NumRows && bSucceeded; i++)
+		{
+			ConvertRowToRgb(Pixels + (Stripe.FirstRow + i) * Width, Width, Row.data());
+
+			unsigned char* FilteredRow = FilteredRows.data();
+			if (Options.Filter == PngFilterStrategy::Adaptive)
+			{
+				int BestCost = INT_MAX;
+				for (int FilterType = 0; FilterType < NumPngFilters; FilterType++)
+				{
+					unsigned char* Candidate = FilteredRows.data() + FilterType * (RowSize + 1);
+					FilterRow(FilterType, Row.data(), PreviousRow.data(), RowSize, Candidate);
+
+					const int Cost = GetFilteredRowCost(Candidate, RowSize);
+					if (Cost < BestCost)
+					{
+						BestCost = Cost;
+						FilteredRow = Candidate;
+					}
+				}
+			}
+			else
+			{
+				FilterRow((int)Options.Filter, Row.data(), PreviousRow.data(), RowSize, FilteredRow);
+			}
+
+			Stripe.Adler = adler32(Stripe.Adler, FilteredRow, RowSize + 1);
+
+			// Other stripes follow a stripe, it's flushed to a byte boundary without ending the stream
+			int Flush = Z_NO_FLUSH;
+			if (i == Stripe.NumRows - 1)
+			{
+				Flush = bLastStripe ? Z_FINISH : Z_SYNC_FLUSH;
+			}
+
+			Stream.next_in = FilteredRow;
+			Stream.avail_in = (uInt)(RowSize + 1);
+			bSucceeded = DeflateInput(Stream, Flush, Stripe.Data);
+
+			Row.swap(PreviousRow);
+		}
+
+		Stripe.Data.resize(Stream.total_out);
+		Stripe.bSucceeded = bSucceeded;
+
+		deflateEnd(&Stream);
+	}
+
+	void AppendUint32BigEndian(std::vector<unsigned char>& Data, uint32_t Value)
+	{
+		Data.push_back((unsigned char)(Value >> 24));
+		Data.push_back((unsigned char)(Value >> 16));
+		Data.push_back((unsigned char)(Value >> 8));
+		Data.push_back((unsigned char)Value);
+	}
+
+	// Start a png chunk. Returns offset of the chunk to end it with.
+	size_t BeginPngChunk(std::vector<unsigned char>& Data, const char* Type)
+	{
+		const size_t ChunkOffset = Data.size();
+
+		// Length is filled in when the chunk ends
+		AppendUint32BigEndian(Data, 0);
+		Data.insert(Data.end(), Type, Type + 4);
+
+		return ChunkOffset;
+	}
+
+	void EndPngChunk(std::vector<unsigned char>& Data, size_t ChunkOffset)
+	{
+		const size_t TypeOffset = ChunkOffset + 4;
+		const uint32_t Length = (uint32_t)(Data.size() - TypeOffset - 4);
+
+		Data[ChunkOffset] = (unsigned char)(Length >> 24);
+		Data[ChunkOffset + 1] = (unsigned char)(Length >> 16);
+		Data[ChunkOffset + 2] = (unsigned char)(Length >> 8);
+		Data[ChunkOffset + 3] = (unsigned char)Length;
+
+		// Crc covers chunk type and data
+		const uLong Crc = crc32(crc32(0L, Z_NULL, 0), Data.data() + TypeOffset, (uInt)(Data.size() - TypeOffset));
+		AppendUint32BigEndian(Data, (uint32_t)Crc);
+	}
+
+	// Encode a png with rows split into stripes compressed in parallel. Stripes are stitched into a single zlib stream.
+	bool EncodePNG(const Pixel* Pixels, int Width, int Height, const ImageEncodeOptions& Options, std::vector<unsigned char>& OutData)
+	{
+		const int NumStripes = Math::Max(Math::Min(Options.MaxThreads, Height / MinRowsPerPngStripe), 1);
+
+		std::vector<PngStripe> Stripes(NumStripes);
+		for (int i = 0; i < NumStripes; i++)
+		{
+			Stripes[i].FirstRow = Height * i / NumStripes;
+			Stripes[i].NumRows = Height * (i + 1) / NumStripes - Stripes[i].FirstRow;
+		}
+
+		// Compress all stripes in parallel. The first stripe is compressed on calling thread.
+		{
+			ScopeAutoJoinedThreads CompressThreads;
+			for (int i = 1; i < NumStripes; i++)
+			{
+				std::thread CompressThread(CompressPngStripe, Pixels, Width, std::cref(Options), i == NumStripes - 1, std::ref(Stripes[i]));
+				CompressThreads.AddThread(CompressThread);
+			}
+
+			CompressPngStripe(Pixels, Width, Options, NumStripes == 1, Stripes[0]);
+		}
+
+		size_t CompressedSize = 0;
+		uLong Adler = Stripes[0].Adler;
+
+		for (int i = 0; i < NumStripes; i++)
+		{
+			if (!Stripes[i].bSucceeded)
+			{
+				RLog("Failed to compress png rows.\n");
+				return false;
+			}
+
+			CompressedSize += Stripes[i].Data.size();
+
+			if (i > 0)
+			{
+				Adler = adler32_combine(Adler, Stripes[i].Adler, (z_off_t)(Width * RgbPixelSize + 1) * Stripes[i].NumRows);
+			}
+		}
+
+		static const unsigned char PngSignature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+		OutData.clear();
+		OutData.reserve(CompressedSize + 64);
+		OutData.insert(OutData.end(), PngSignature, PngSignature + sizeof(PngSignature));
+
+		// 8 bit rgb, no interlacing
+		const size_t HeaderChunk = BeginPngChunk(OutData, "IHDR");
+		AppendUint32BigEndian(OutData, (uint32_t)Width);
+		AppendUint32BigEndian(OutData, (uint32_t)Height);
+		OutData.push_back(8);
+		OutData.push_back(2);
+		OutData.push_back(0);
+		OutData.push_back(0);
+		OutData.push_back(0);
+		EndPngChunk(OutData, HeaderChunk);
+
+		const size_t DataChunk = BeginPngChunk(OutData, "IDAT");
+		{
+			// Zlib header with 32k window, check bits make header a multiple of 31
+			const int Level = Math::Max(Math::Min(Options.CompressionLevel, 9), 0);
+			const int CompressionMethod = 0x78;
+			int Flags = (Level < 2 ? 0 : (Level < 6 ? 1 : (Level == 6 ? 2 : 3))) << 6;
+			Flags += 31 - (CompressionMethod * 256 + Flags) % 31;
+
+			OutData.push_back((unsigned char)CompressionMethod);
+			OutData.push_back((unsigned char)Flags);
+
+			for (const PngStripe& Stripe : Stripes)
+			{
+				OutData.insert(OutData.end(), Stripe.Data.begin(), Stripe.Data.end());
+			}
+
+			AppendUint32BigEndian(OutData, (uint32_t)Adler);
+		}
+		EndPngChunk(OutData, DataChunk);
+
+		const size_t EndChunk = BeginPngChunk(OutData, "IEND");
+		EndPngChunk(OutData, EndChunk);
+
+		return true;
+	}
+
+	void EncodePPM(const Pixel* Pixels, int Width, int Height, std::vector<unsigned char>& OutData)
+	{
+		char Header[64];
+		const int HeaderSize = RPrintf(Header, sizeof(Header), "P6\n%d %d\n255\n", Width, Height);
+
+		OutData.resize(HeaderSize + (size_t)Width * Height * RgbPixelSize);
+		memcpy(OutData.data(), Header, HeaderSize);
+
+		unsigned char* Rgb = OutData.data() + HeaderSize;
+		for (int y = 0; y < Height; y++)
+		{
+			ConvertRowToRgb(Pixels + y * Width, Width, Rgb + (size_t)y * Width * RgbPixelSize);
+		}
+	}
+}
+
+namespace ImageEncoder
+{
+	const char* GetFileExtension(ImageFileFormat Format)
+	{
+		return (Format == ImageFileFormat::PPM) ? ".ppm" : ".png";
+	}
+
+	bool EncodeImage(const Pixel* Pixels, int Width, int Height, const ImageEncodeOptions& Options, std::vector<unsigned char>& OutData)
+	{
+		if (Options.Format == ImageFileFormat::PPM)
+		{
+			EncodePPM(Pixels, Width, Height, OutData);
+			return true;
+		}
+
+		return EncodePNG(Pixels, Width, Height, Options, OutData);
+	}
+
+	bool SaveImage(const std::string& Filename, const Pixel* Pixels, int Width, int Height, const ImageEncodeOptions& Options, std::vector<unsigned char>& OutData)
+	{
+		if (!EncodeImage(Pixels, Width, Height, Options, OutData))
+		{
+			RLog("Failed to encode image %s\n", Filename.c_str());
+			return false;
+		}
+
+		FILE* fp = fopen(Filename.c_str(), "wb");
+		if (fp == nullptr)
+		{
+			RLog("Failed to save to %s: Unable to open file for writing.\n", Filename.c_str());
+			return false;
+		}
+
+		const bool bWritten = (fwrite(OutData.data(), 1, OutData.size(), fp) == OutData.size());
+		fclose(fp);
+
+		if (!bWritten)
+		{
+			RLog("Failed to write image %s\n", Filename.c_str());
+		}
+
+		return bWritten;
+	}
+}
@@ -0,0 +1,64 @@
+//=============================================================================
+// ImageEncoder.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "ColorBuffer.h"
+
+#include <string>
+#include <vector>
+
+enum class ImageFileFormat
+{
+	// Deflate compressed, smallest files
+	PNG,
+
+	// Binary ppm, pixels are written without any compression. Fastest to write.
+	PPM,
+};
+
+// Filter applied to each png row before compression. Adaptive picks the filter with the smallest output for each row.
+enum class PngFilterStrategy
+{
+	None,
+	Sub,
+	Up,
+	Average,
+	Paeth,
+	Adaptive,
+};
+
+struct ImageEncodeOptions
+{
+	ImageEncodeOptions()
+		: Format(ImageFileFormat::PNG)
+		, CompressionLevel(6)
+		, Filter(PngFilterStrategy::Adaptive)
+		, MaxThreads(1)
+	{}
+
+	ImageFileFormat Format;
+
+	// Zlib compression level of png files, from 0 (stored) to 9 (smallest)
+	int CompressionLevel;
+
+	PngFilterStrategy Filter;
+
+	// Threads compressing stripes of png rows in parallel
+	int MaxThreads;
+};
+
+namespace ImageEncoder
+{
+	// Get file extension of a format including the dot
+	const char* GetFileExtension(ImageFileFormat Format);
+
+	// Encode pixels into file data of the format of options
+	bool EncodeImage(const Pixel* Pixels, int Width, int Height, const ImageEncodeOptions& Options, std::vector<unsigned char>& OutData);
+
+	// Encode pixels and save them to a file. OutData keeps the encoded data, so its memory can be reused by later images.
+	bool SaveImage(const std::string& Filename, const Pixel* Pixels, int Width, int Height, const ImageEncodeOptions& Options, std::vector<unsigned char>& OutData);
+}
@@ -0,0 +1,130 @@
+//=============================================================================
+// ImageWriter.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "ImageWriter.h"
+
+#include "Profiler.h"
+
+namespace
+{
+	// Images waiting to be written at most. Two images let the next frame be handed over while one is being encoded.
+	const int MaxQueuedImages = 2;
+}
+
+ImageWriter::ImageWriter()
+	: Tasks(MaxQueuedImages)
+	, FirstTask(0)
+	, NumTasks(0)
+	, NumFailedImages(0)
+	, bQuit(false)
+{
+	WriterThread = std::thread(&ImageWriter::WriterThreadMain, this);
+}
+
+ImageWriter::~ImageWriter()
+{
+	Flush();
+
+	{
+		std::lock_guard<std::mutex> Lock(QueueMutex);
+		bQuit = true;
+	}
+
+	QueueCondition.notify_all();
+	WriterThread.join();
+}
+
+void ImageWriter::SetEncodeOptions(const ImageEncodeOptions& InOptions)
+{
+	std::lock_guard<std::mutex> Lock(QueueMutex);
+	EncodeOptions = InOptions;
+}
+
+ImageEncodeOptions ImageWriter::GetEncodeOptions() const
+{
+	std::lock_guard<std::mutex> Lock(QueueMutex);
+	return EncodeOptions;
+}
+
+void ImageWriter::WriteImage(const std::string& Filename, const Pixel* Pixels, int Width, int Height)
+{
+	std::unique_lock<std::mutex> Lock(QueueMutex);
+
+	QueueCondition.wait(Lock, [this] {
+		return NumTasks < MaxQueuedImages;
+	});
+
+	ImageTask& Task = Tasks[(FirstTask + NumTasks) % MaxQueuedImages];
+	Task.Filename = Filename;
+	Task.Pixels.assign(Pixels, Pixels + Width * Height);
+	Task.Width = Width;
+	Task.Height = Height;
+	Task.Options = EncodeOptions;
+	NumTasks++;
+
+	Lock.unlock();
+	QueueCondition.notify_all();
+}
+
+void ImageWriter::Flush()
+{
+	std::unique_lock<std::mutex> Lock(QueueMutex);
+
+	QueueCondition.wait(Lock, [this] {
+		return NumTasks == 0;
+	});
+}
+
+int ImageWriter::GetNumFailedImages() const
+{
+	std::lock_guard<std::mutex> Lock(QueueMutex);
+	return NumFailedImages;
+}
+
+void ImageWriter::WriterThreadMain()
+{
+	PROFILE_THREAD_NAME("Image writer");
+
+	while (1)
+	{
+		ImageTask* Task = nullptr;
+		{
+			std::unique_lock<std::mutex> Lock(QueueMutex);
+
+			QueueCondition.wait(Lock, [this] {
+				return NumTasks > 0 || bQuit;
+			});
+
+			if (NumTasks == 0)
+			{
+				return;
+			}
+
+			// The task stays in the queue while it's written, so its slot isn't reused
+			Task = &Tasks[FirstTask];
+		}
+
+		bool bSaved;
+		{
+			PROFILE_SCOPE("WriteImage");
+			bSaved = ImageEncoder::SaveImage(Task->Filename, Task->Pixels.data(), Task->Width, Task->Height, Task->Options, EncodedData);
+		}
+
+		{
+			std::lock_guard<std::mutex> Lock(QueueMutex);
+
+			if (!bSaved)
+			{
+				NumFailedImages++;
+			}
+
+			FirstTask = (FirstTask + 1) % MaxQueuedImages;
+			NumTasks--;
+		}
+
+		QueueCondition.notify_all();
+	}
+}
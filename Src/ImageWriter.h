@@ -0,0 +1,74 @@
+//=============================================================================
+// ImageWriter.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "ColorBuffer.h"
+#include "ImageEncoder.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Saves images on a background thread, so rendering can go on while images are encoded
+class ImageWriter
+{
+public:
+	ImageWriter();
+
+	// Waits for all queued images to be written
+	~ImageWriter();
+
+	ImageWriter(const ImageWriter&) = delete;
+	ImageWriter& operator=(const ImageWriter&) = delete;
+
+	// Set format and compression of images queued from now on
+	void SetEncodeOptions(const ImageEncodeOptions& InOptions);
+
+	ImageEncodeOptions GetEncodeOptions() const;
+
+	// Queue pixels to be saved in the format of encode options. Pixels are copied, the buffer may be changed as soon as this returns.
+	// Blocks while the queue is full.
+	void WriteImage(const std::string& Filename, const Pixel* Pixels, int Width, int Height);
+
+	// Wait until all queued images are written
+	void Flush();
+
+	// Number of images that couldn't be written
+	int GetNumFailedImages() const;
+
+private:
+	struct ImageTask
+	{
+		std::string Filename;
+		std::vector<Pixel> Pixels;
+		int Width;
+		int Height;
+		ImageEncodeOptions Options;
+	};
+
+	// Main function of the writer thread
+	void WriterThreadMain();
+
+	// Slots of queued images in a ring buffer. Slots keep their memory for later images.
+	std::vector<ImageTask> Tasks;
+	int FirstTask;
+	int NumTasks;
+
+	ImageEncodeOptions EncodeOptions;
+
+	// Encoded file data of the image being written, kept for later images
+	std::vector<unsigned char> EncodedData;
+
+	int NumFailedImages;
+	bool bQuit;
+
+	mutable std::mutex QueueMutex;
+	std::condition_variable QueueCondition;
+	std::thread WriterThread;
+};
@@ -5,7 +5,37 @@
 //=============================================================================
 
 #include "KdTree.h"
+#include "Profiler.h"
 #include "RAabb.h"
+#include "TraversalStats.h"
+
+#include <assert.h>
+
+namespace
+{
+	// Rebuild a subtree after refit when overlap of its children grows by more than this fraction of the node's surface area
+	const float MaxChildOverlapGrowth = 0.25f;
+
+	float GetSurfaceArea(const RVec3& Size)
+	{
+		return 2.0f * (Size.x * Size.y + Size.y * Size.z + Size.z * Size.x);
+	}
+
+	// Surface area of the intersection of children bounds relative to surface area of the node
+	float GetChildOverlap(const KdNode& Node)
+	{
+		const RVec3 OverlapSize = (RVec3A::Min(Node.Left->Bounds.pMax, Node.Right->Bounds.pMax) -
+								   RVec3A::Max(Node.Left->Bounds.pMin, Node.Right->Bounds.pMin)).ToVec3();
+
+		if (OverlapSize.x <= 0.0f || OverlapSize.y <= 0.0f || OverlapSize.z <= 0.0f)
+		{
+			return 0.0f;
+		}
+
+		const float NodeArea = GetSurfaceArea((Node.Bounds.pMax - Node.Bounds.pMin).ToVec3());
+		return NodeArea > 0.0f ? GetSurfaceArea(OverlapSize) / NodeArea : 0.0f;
+	}
+}
 
 EAxis GetLargestAxisOfBounds(const RAabb& Bounds)
 {
@@ -34,99 +64,11 @@ EAxis GetLargestAxisOfBounds(const RAabb& Bounds)
 	}
 }
 
-void KdNode::Build(const RVec3 Points[], const std::vector<TriangleData>& Triangles)
-{
-	int NumTriangles = (int)Triangles.size();
-
-	// Measure bounds for all points
-	for (int i = 0; i < NumTriangles; i++)
-	{
-		Bounds.Expand(Points[Triangles[i].p0]);
-		Bounds.Expand(Points[Triangles[i].p1]);
-		Bounds.Expand(Points[Triangles[i].p2]);
-	}
-
-	// Only one triangle in the list, make current node a leaf node
-	if (Triangles.size() == 1)
-	{
-		Triangle = Triangles[0];
-
-		return;
-	}
-
-	RVec3 NodeMidPoint(0, 0, 0);
-	for (int i = 0; i < NumTriangles; i++)
-	{
-		const RVec3& v0 = Points[Triangles[i].p0];
-		const RVec3& v1 = Points[Triangles[i].p1];
-		const RVec3& v2 = Points[Triangles[i].p2];
-
-		NodeMidPoint += (v0 + v1 + v2) / 3.0f;
-	}
-	NodeMidPoint /= (float)NumTriangles;
-
-	std::vector<TriangleData> LeftNodeTriangles;
-	std::vector<TriangleData> RightNodeTriangles;
-	const EAxis Axis = GetLargestAxisOfBounds(Bounds);
-
-	for (int i = 0; i < NumTriangles; i++)
-	{
-		const RVec3& v0 = Points[Triangles[i].p0];
-		const RVec3& v1 = Points[Triangles[i].p1];
-		const RVec3& v2 = Points[Triangles[i].p2];
-
-		RVec3 MidPoint = (v0 + v1 + v2) / 3.0f;
-
-		bool bInsertToLeft = false;
-
-		switch (Axis)
-		{
-		case EAxis::X:
-			bInsertToLeft = (MidPoint.x < NodeMidPoint.x);
-			break;
-
-		case EAxis::Y:
-			bInsertToLeft = (MidPoint.y < NodeMidPoint.y);
-			break;
-
-		case EAxis::Z:
-			bInsertToLeft = (MidPoint.z < NodeMidPoint.z);
-			break;
-		}
-
-		if (bInsertToLeft)
-		{
-			LeftNodeTriangles.emplace_back(Triangles[i]);
-		}
-		else
-		{
-			RightNodeTriangles.emplace_back(Triangles[i]);
-		}
-	}
-
-	// All triangles go into one side of child node? Let's split them half-half for both nodes.
-	if (LeftNodeTriangles.size() == Triangles.size() || RightNodeTriangles.size() == Triangles.size())
-	{
-		const size_t half_size = Triangles.size() / 2;
-		LeftNodeTriangles = std::vector<TriangleData>(Triangles.begin(), Triangles.begin() + half_size);
-		RightNodeTriangles = std::vector<TriangleData>(Triangles.begin() + half_size, Triangles.end());
-	}
-
-	if (LeftNodeTriangles.size() > 0)
-	{
-		Left = std::unique_ptr<KdNode>(new KdNode());
-		Left->Build(Points, LeftNodeTriangles);
-	}
-
-	if (RightNodeTriangles.size() > 0)
-	{
-		Right = std::unique_ptr<KdNode>(new KdNode());
-		Right->Build(Points, RightNodeTriangles);
-	}
-}
-
 bool KdNode::TestRayIntersection(RRay& TestRay, const RVec3 Points[], RayHitResult* OutResult /*= nullptr*/, int* TriangleIndex /*= nullptr*/) const
 {
+	TRAVERSAL_STAT_INC(NodesVisited);
+	TRAVERSAL_STAT_INC(AabbTests);
+
 	if (!TestRay.TestIntersectionWithAabb(Bounds))
 	{
 		return false;
@@ -165,6 +107,8 @@ bool KdNode::TestRayIntersection(RRay& TestRay, const RVec3 Points[], RayHitResu
 		};
 #endif
 		
+		TRAVERSAL_STAT_INC(TriangleTests);
+
 		RayHitResult HitResult;
 		if (TestRay.TestIntersectionWithTriangle(TriPoints, &HitResult)
 #if DOUBLE_FACED
@@ -194,6 +138,78 @@ bool KdNode::TestRayIntersection(RRay& TestRay, const RVec3 Points[], RayHitResu
 	return bResult;
 }
 
+int KdNode::TestPacketIntersection(RRayPacket& Packet, int LaneMask, const RVec3 Points[], RayHitResult OutResults[], int OutTriangleIndices[]) const
+{
+	// Counted for every ray, so averages per ray match single ray traversal
+	TRAVERSAL_STAT_ADD(NodesVisited, CountLanes(LaneMask));
+	TRAVERSAL_STAT_ADD(AabbTests, CountLanes(LaneMask));
+
+	LaneMask = Packet.TestIntersectionWithAabb(Bounds, LaneMask);
+	if (LaneMask == 0)
+	{
+		return 0;
+	}
+
+	// Packet diverged to a single ray, continue without the overhead of lane masks
+	if ((LaneMask & (LaneMask - 1)) == 0)
+	{
+		int Lane = 0;
+		while (!(LaneMask & (1 << Lane)))
+		{
+			Lane++;
+		}
+
+		RRay TestRay = Packet.GetRay(Lane);
+		if (TestRayIntersection(TestRay, Points, &OutResults[Lane], &OutTriangleIndices[Lane]))
+		{
+			Packet.SetDistance(Lane, TestRay.Distance);
+			return LaneMask;
+		}
+
+		return 0;
+	}
+
+	if (Left || Right)
+	{
+		int HitMask = 0;
+
+		if (Left)
+		{
+			HitMask |= Left->TestPacketIntersection(Packet, LaneMask, Points, OutResults, OutTriangleIndices);
+		}
+
+		if (Right)
+		{
+			HitMask |= Right->TestPacketIntersection(Packet, LaneMask, Points, OutResults, OutTriangleIndices);
+		}
+
+		return HitMask;
+	}
+
+	const RVec3 TriPoints[] = {
+		Points[Triangle.p0],
+		Points[Triangle.p1],
+		Points[Triangle.p2],
+	};
+
+	TRAVERSAL_STAT_ADD(TriangleTests, CountLanes(LaneMask));
+
+	RayHitResult HitResults[RayPacketSize];
+	const int HitMask = Packet.TestIntersectionWithTriangle(TriPoints, LaneMask, HitResults);
+
+	for (int Lane = 0; Lane < RayPacketSize; Lane++)
+	{
+		if (HitMask & (1 << Lane))
+		{
+			Packet.SetDistance(Lane, HitResults[Lane].Distance);
+			OutResults[Lane] = HitResults[Lane];
+			OutTriangleIndices[Lane] = Triangle.Index;
+		}
+	}
+
+	return HitMask;
+}
+
 KdTree::KdTree()
 {
 
@@ -201,9 +217,12 @@ KdTree::KdTree()
 
 void KdTree::Build(const RVec3 Points[], const int Indices[], int NumIndices)
 {
+	PROFILE_SCOPE("BuildKdTree");
+
 	const int NumTriangles = NumIndices / 3;
 
 	std::vector<TriangleData> TriangleIndices;
+	TriangleIndices.reserve(NumTriangles);
 	for (int i = 0; i < NumTriangles; i++)
 	{
 		TriangleIndices.emplace_back(
@@ -214,28 +233,223 @@ void KdTree::Build(const RVec3 Points[], const int Indices[], int NumIndices)
 		);
 	}
 
-	RootNode = std::unique_ptr<KdNode>(new KdNode());
+	Nodes.clear();
+	BuildOverlaps.clear();
 
-	RootNode->Build(Points, TriangleIndices);
+	if (NumTriangles == 0)
+	{
+		return;
+	}
+
+	// Every leaf holds a single triangle, so the tree has exactly 2n-1 nodes
+	Nodes.resize(NumTriangles * 2 - 1);
+	BuildOverlaps.resize(Nodes.size());
+
+	std::vector<TriangleData> Scratch(NumTriangles);
+	BuildNode(Points, TriangleIndices.data(), NumTriangles, Scratch.data(), 0);
+}
+
+int KdTree::Refit(const RVec3 Points[])
+{
+	PROFILE_SCOPE("RefitKdTree");
+
+	// Children are stored after their parents, walking the pool backwards updates them first
+	for (int i = (int)Nodes.size() - 1; i >= 0; i--)
+	{
+		KdNode& Node = Nodes[i];
+
+		if (Node.Left)
+		{
+			Node.Bounds.pMin = RVec3A::Min(Node.Left->Bounds.pMin, Node.Right->Bounds.pMin);
+			Node.Bounds.pMax = RVec3A::Max(Node.Left->Bounds.pMax, Node.Right->Bounds.pMax);
+		}
+		else
+		{
+			Node.Bounds = RAabbA(Node.Triangle.GetBounds(Points));
+		}
+	}
+
+	// Rebuild the topmost subtrees that got worse. Rebuilt subtrees cover the same triangles, so bounds of their parents stay valid.
+	int NumRebuiltSubtrees = 0;
+
+	for (int i = 0; i < (int)Nodes.size(); )
+	{
+		if (Nodes[i].Left && GetChildOverlap(Nodes[i]) > BuildOverlaps[i] + MaxChildOverlapGrowth)
+		{
+			const int SubtreeSize = GetSubtreeSize(i);
+			RebuildSubtree(Points, i);
+			NumRebuiltSubtrees++;
+
+			i += SubtreeSize;
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	return NumRebuiltSubtrees;
+}
+
+void KdTree::RebuildSubtree(const RVec3 Points[], int NodeIndex)
+{
+	PROFILE_SCOPE("RebuildKdSubtree");
+
+	const int SubtreeSize = GetSubtreeSize(NodeIndex);
+
+	std::vector<TriangleData> Triangles;
+	Triangles.reserve((SubtreeSize + 1) / 2);
+
+	for (int i = NodeIndex; i < NodeIndex + SubtreeSize; i++)
+	{
+		if (!Nodes[i].Left)
+		{
+			Triangles.push_back(Nodes[i].Triangle);
+		}
+	}
+
+	std::vector<TriangleData> Scratch(Triangles.size());
+	BuildNode(Points, Triangles.data(), (int)Triangles.size(), Scratch.data(), NodeIndex);
+}
+
+int KdTree::GetSubtreeSize(int NodeIndex) const
+{
+	// Last node of a subtree is its rightmost leaf
+	const KdNode* Last = &Nodes[NodeIndex];
+	while (Last->Right)
+	{
+		Last = Last->Right;
+	}
+
+	return (int)(Last - &Nodes[NodeIndex]) + 1;
+}
+
+KdNode* KdTree::BuildNode(const RVec3 Points[], TriangleData Triangles[], int NumTriangles, TriangleData Scratch[], int NodeIndex)
+{
+	KdNode* Node = &Nodes[NodeIndex];
+	*Node = KdNode();
+	BuildOverlaps[NodeIndex] = 0.0f;
+
+	// Measure bounds for all points
+	RAabb NodeBounds;
+	for (int i = 0; i < NumTriangles; i++)
+	{
+		NodeBounds.Expand(Points[Triangles[i].p0]);
+		NodeBounds.Expand(Points[Triangles[i].p1]);
+		NodeBounds.Expand(Points[Triangles[i].p2]);
+	}
+
+	Node->Bounds = RAabbA(NodeBounds);
+
+	// Only one triangle in the list, make current node a leaf node
+	if (NumTriangles == 1)
+	{
+		Node->Triangle = Triangles[0];
+
+		return Node;
+	}
+
+	RVec3 NodeMidPoint(0, 0, 0);
+	for (int i = 0; i < NumTriangles; i++)
+	{
+		const RVec3& v0 = Points[Triangles[i].p0];
+		const RVec3& v1 = Points[Triangles[i].p1];
+		const RVec3& v2 = Points[Triangles[i].p2];
+
+		NodeMidPoint += (v0 + v1 + v2) / 3.0f;
+	}
+	NodeMidPoint /= (float)NumTriangles;
+
+	const EAxis Axis = GetLargestAxisOfBounds(NodeBounds);
+
+	// Stable partition, left triangles are compacted in place and right ones are moved after them through the scratch buffer
+	int NumLeftTriangles = 0;
+	int NumRightTriangles = 0;
+
+	for (int i = 0; i < NumTriangles; i++)
+	{
+		const RVec3& v0 = Points[Triangles[i].p0];
+		const RVec3& v1 = Points[Triangles[i].p1];
+		const RVec3& v2 = Points[Triangles[i].p2];
+
+		RVec3 MidPoint = (v0 + v1 + v2) / 3.0f;
+
+		bool bInsertToLeft = false;
+
+		switch (Axis)
+		{
+		case EAxis::X:
+			bInsertToLeft = (MidPoint.x < NodeMidPoint.x);
+			break;
+
+		case EAxis::Y:
+			bInsertToLeft = (MidPoint.y < NodeMidPoint.y);
+			break;
+
+		case EAxis::Z:
+			bInsertToLeft = (MidPoint.z < NodeMidPoint.z);
+			break;
+		}
+
+		if (bInsertToLeft)
+		{
+			Triangles[NumLeftTriangles++] = Triangles[i];
+		}
+		else
+		{
+			Scratch[NumRightTriangles++] = Triangles[i];
+		}
+	}
+
+	for (int i = 0; i < NumRightTriangles; i++)
+	{
+		Triangles[NumLeftTriangles + i] = Scratch[i];
+	}
+
+	// All triangles go into one side of child node? Let's split them half-half for both nodes.
+	if (NumLeftTriangles == NumTriangles || NumRightTriangles == NumTriangles)
+	{
+		NumLeftTriangles = NumTriangles / 2;
+		NumRightTriangles = NumTriangles - NumLeftTriangles;
+	}
+
+	// Both sides have triangles now. The left subtree follows its parent, the right one follows the left subtree.
+	assert(NumLeftTriangles > 0 && NumRightTriangles > 0);
+	Node->Left = BuildNode(Points, Triangles, NumLeftTriangles, Scratch, NodeIndex + 1);
+	Node->Right = BuildNode(Points, Triangles + NumLeftTriangles, NumRightTriangles, Scratch, NodeIndex + NumLeftTriangles * 2);
+
+	BuildOverlaps[NodeIndex] = GetChildOverlap(*Node);
+
+	return Node;
 }
 
 bool KdTree::TestRayIntersection(const RRay& InRay, const RVec3 Points[], RayHitResult* OutResult /*= nullptr*/, int* TriangleIndex /*= nullptr*/) const
 {
-	if (RootNode == nullptr)
+	if (Nodes.empty())
 	{
 		return false;
 	}
 
 	RRay TestRay = InRay;
 
-	return RootNode->TestRayIntersection(TestRay, Points, OutResult, TriangleIndex);
+	return Nodes[0].TestRayIntersection(TestRay, Points, OutResult, TriangleIndex);
+}
+
+int KdTree::TestPacketIntersection(RRayPacket& Packet, int LaneMask, const RVec3 Points[], RayHitResult OutResults[], int OutTriangleIndices[]) const
+{
+	if (Nodes.empty())
+	{
+		return 0;
+	}
+
+	return Nodes[0].TestPacketIntersection(Packet, LaneMask, Points, OutResults, OutTriangleIndices);
 }
 
 RAabb KdTree::GetBounds() const
 {
-	if (RootNode)
+	if (!Nodes.empty())
 	{
-		return RootNode->Bounds;
+		return Nodes[0].Bounds.ToAabb();
 	}
 
 	static const RAabb InvalidBounds = RAabb();
@@ -12,6 +12,7 @@
 #include <memory>
 #include <vector>
 #include "RRay.h"
+#include "RRayPacket.h"
 
 using std::unique_ptr;
 
@@ -38,13 +39,6 @@ struct TriangleData
 		, Index(InIndex)
 	{}
 
-	TriangleData(const TriangleData& rhs)
-		: p0(rhs.p0)
-		, p1(rhs.p1)
-		, p2(rhs.p2)
-		, Index(rhs.Index)
-	{}
-
 	RAabb GetBounds(const RVec3 Points[]) const
 	{
 		RAabb Bounds;
@@ -63,17 +57,22 @@ struct TriangleData
 
 struct KdNode
 {
-	unique_ptr<KdNode> Left;
-	unique_ptr<KdNode> Right;
+	// Children are allocated from the node pool of the tree
+	KdNode* Left;
+	KdNode* Right;
 
 	TriangleData Triangle;
-	RAabb Bounds;
-
-	KdNode() {}
+	RAabbA Bounds;
 
-	void Build(const RVec3 Points[], const std::vector<TriangleData>& Triangles);
+	KdNode()
+		: Left(nullptr)
+		, Right(nullptr)
+	{}
 
 	bool TestRayIntersection(RRay& TestRay, const RVec3 Points[], RayHitResult* OutResult = nullptr, int* TriangleIndex = nullptr) const;
+
+	// Test selected rays of a packet, rays that hit are shortened. Returns mask of rays that hit.
+	int TestPacketIntersection(RRayPacket& Packet, int LaneMask, const RVec3 Points[], RayHitResult OutResults[], int OutTriangleIndices[]) const;
 };
 
 class KdTree
@@ -81,15 +80,42 @@ class KdTree
 public:
 	KdTree();
 
+	// Nodes refer to each other by address
+	KdTree(const KdTree&) = delete;
+	KdTree& operator=(const KdTree&) = delete;
+
 	// Construct a tree from triangle list
 	void Build(const RVec3 Points[], const int Indices[], int NumIndices);
 
+	// Update bounds of all nodes after points have moved, keeping the topology of the tree.
+	// Subtrees whose children overlap much more than when they were built are rebuilt in place.
+	// Returns the number of rebuilt subtrees.
+	int Refit(const RVec3 Points[]);
+
 	// Test intersection with ray
 	bool TestRayIntersection(const RRay& InRay, const RVec3 Points[], RayHitResult* OutResult = nullptr, int* TriangleIndex = nullptr) const;
 
+	// Test selected rays of a packet, rays that hit are shortened. Returns mask of rays that hit.
+	int TestPacketIntersection(RRayPacket& Packet, int LaneMask, const RVec3 Points[], RayHitResult OutResults[], int OutTriangleIndices[]) const;
+
 	// Get the bounds of this kd-tree
 	RAabb GetBounds() const;
 
 private:
-	unique_ptr<KdNode> RootNode;
+	// Build a subtree for a range of triangles into the pool, starting at a node index. The subtree takes 2n-1 nodes.
+	// Triangles are reordered in place, scratch must hold as many triangles.
+	KdNode* BuildNode(const RVec3 Points[], TriangleData Triangles[], int NumTriangles, TriangleData Scratch[], int NodeIndex);
+
+	// Rebuild the subtree of a node in place from the triangles of its leaves
+	void RebuildSubtree(const RVec3 Points[], int NodeIndex);
+
+	// Number of nodes in the subtree of a node
+	int GetSubtreeSize(int NodeIndex) const;
+
+	// Pool of all nodes in depth-first order, the root node comes first.
+	// Parents are always stored before their children and every subtree takes a contiguous range.
+	std::vector<KdNode> Nodes;
+
+	// Overlap of children of each node when it was built. Zero for leaves.
+	std::vector<float> BuildOverlaps;
 };
@@ -7,10 +7,36 @@
 #include "RenderWindow_X11.h"
 
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/select.h>
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
 #include <iostream>
 #include <unistd.h>
 
+namespace
+{
+    // Minimal interval between two presentations of the render buffer
+    const int PresentIntervalMs = 50;
+
+    // Size of the square tiles compared and uploaded independently
+    const int PresentTileSize = 32;
+
+    // Set when attaching shared memory fails, e.g. on a remote display
+    bool bShmAttachFailed = false;
+
+    int HandleShmAttachError(Display* display, XErrorEvent* event)
+    {
+        bShmAttachFailed = true;
+        return 0;
+    }
+}
+
 struct RenderWindow::X11WindowContext
 {
     X11WindowContext()
@@ -18,9 +44,23 @@ struct RenderWindow::X11WindowContext
      , Width(-1)
      , Height(-1)
      , Pixels(nullptr)
+     , Image(nullptr)
+     , bUseShm(false)
+     , bNeedsFullRedraw(true)
     {
     }
 
+    // Create the image used for presenting the render buffer
+    void CreateImage();
+
+    void DestroyImage();
+
+    // Copy tiles that changed since last presentation to the image and send them to the server
+    void PresentDirtyTiles();
+
+    // Upload a region of the image to the window
+    void PutImageRegion(int x, int y, int w, int h);
+
     Display* display;
     Window window;
     GC gc;
@@ -28,9 +68,190 @@ struct RenderWindow::X11WindowContext
     int Width, Height;
     char* Pixels;
 
-    Pixmap pixmap;
+    // Image in shared memory when MIT-SHM is available, client memory otherwise
+    XImage* Image;
+    XShmSegmentInfo ShmInfo;
+    bool bUseShm;
+
+    // Set when the window content was lost and every tile must be sent again
+    bool bNeedsFullRedraw;
 };
 
+void RenderWindow::X11WindowContext::CreateImage()
+{
+    const int Screen = DefaultScreen(display);
+    Visual* visual = DefaultVisual(display, Screen);
+    const int Depth = DefaultDepth(display, Screen);
+
+    // Render buffer is packed as 0xAARRGGBB, which matches 24-bit true color visuals directly
+    if (Depth < 24 || visual->red_mask != 0xFF0000 || visual->green_mask != 0xFF00 || visual->blue_mask != 0xFF)
+    {
+        std::cout << "Unsupported X11 visual (depth " << Depth << "), render buffer will not be presented" << std::endl;
+        return;
+    }
+
+    if (XShmQueryExtension(display))
+    {
+        Image = XShmCreateImage(display, visual, Depth, ZPixmap, nullptr, &ShmInfo, Width, Height);
+        if (Image)
+        {
+            ShmInfo.shmid = shmget(IPC_PRIVATE, Image->bytes_per_line * Image->height, IPC_CREAT | 0600);
+            ShmInfo.shmaddr = (ShmInfo.shmid != -1) ? (char*)shmat(ShmInfo.shmid, nullptr, 0) : (char*)-1;
+
+            if (ShmInfo.shmaddr != (char*)-1)
+            {
+                Image->data = ShmInfo.shmaddr;
+                ShmInfo.readOnly = False;
+
+                // Attach errors are reported asynchronously, catch them instead of exiting
+                bShmAttachFailed = false;
+                XErrorHandler PreviousHandler = XSetErrorHandler(HandleShmAttachError);
+                bUseShm = XShmAttach(display, &ShmInfo);
+                XSync(display, False);
+                XSetErrorHandler(PreviousHandler);
+                bUseShm = bUseShm && !bShmAttachFailed;
+            }
+
+            // Segment is destroyed automatically once both sides detach from it
+            if (ShmInfo.shmid != -1)
+            {
+                shmctl(ShmInfo.shmid, IPC_RMID, nullptr);
+            }
+
+            if (!bUseShm)
+            {
+                if (ShmInfo.shmaddr != (char*)-1)
+                {
+                    shmdt(ShmInfo.shmaddr);
+                }
+
+                XDestroyImage(Image);
+                Image = nullptr;
+            }
+        }
+    }
+
+    if (!bUseShm)
+    {
+        std::cout << "MIT-SHM is not available, presenting with XPutImage" << std::endl;
+
+        char* ImageData = (char*)malloc(Width * Height * 4);
+        Image = XCreateImage(display, visual, Depth, ZPixmap, 0, ImageData, Width, Height, 32, 0);
+        if (!Image)
+        {
+            free(ImageData);
+            return;
+        }
+    }
+
+    if (Image->bits_per_pixel != 32)
+    {
+        std::cout << "Unsupported X11 image format (" << Image->bits_per_pixel << " bits per pixel)" << std::endl;
+        DestroyImage();
+        return;
+    }
+
+    memset(Image->data, 0, Image->bytes_per_line * Image->height);
+    bNeedsFullRedraw = true;
+}
+
+void RenderWindow::X11WindowContext::DestroyImage()
+{
+    if (!Image)
+    {
+        return;
+    }
+
+    if (bUseShm)
+    {
+        XShmDetach(display, &ShmInfo);
+        XDestroyImage(Image);
+        shmdt(ShmInfo.shmaddr);
+        bUseShm = false;
+    }
+    else
+    {
+        // Also frees the pixel data
+        XDestroyImage(Image);
+    }
+
+    Image = nullptr;
+}
+
+void RenderWindow::X11WindowContext::PresentDirtyTiles()
+{
+    if (!Image || !Pixels)
+    {
+        return;
+    }
+
+    const int RowBytes = Width * 4;
+    bool bSentAnyTile = false;
+
+    for (int TileY = 0; TileY < Height; TileY += PresentTileSize)
+    {
+        const int TileHeight = (TileY + PresentTileSize < Height) ? PresentTileSize : Height - TileY;
+
+        // Horizontal run of dirty tiles, sent with a single request
+        int RunStartX = -1;
+
+        for (int TileX = 0; TileX < Width; TileX += PresentTileSize)
+        {
+            const int TileWidth = (TileX + PresentTileSize < Width) ? PresentTileSize : Width - TileX;
+            bool bTileDirty = bNeedsFullRedraw;
+
+            for (int y = TileY; y < TileY + TileHeight; y++)
+            {
+                const char* Src = Pixels + y * RowBytes + TileX * 4;
+                char* Dest = Image->data + y * Image->bytes_per_line + TileX * 4;
+
+                if (memcmp(Src, Dest, TileWidth * 4) != 0)
+                {
+                    memcpy(Dest, Src, TileWidth * 4);
+                    bTileDirty = true;
+                }
+            }
+
+            if (bTileDirty && RunStartX == -1)
+            {
+                RunStartX = TileX;
+            }
+            else if (!bTileDirty && RunStartX != -1)
+            {
+                PutImageRegion(RunStartX, TileY, TileX - RunStartX, TileHeight);
+                RunStartX = -1;
+                bSentAnyTile = true;
+            }
+        }
+
+        if (RunStartX != -1)
+        {
+            PutImageRegion(RunStartX, TileY, Width - RunStartX, TileHeight);
+            bSentAnyTile = true;
+        }
+    }
+
+    bNeedsFullRedraw = false;
+
+    if (bSentAnyTile)
+    {
+        // Wait for the server to finish reading shared memory before it can be written again
+        XSync(display, False);
+    }
+}
+
+void RenderWindow::X11WindowContext::PutImageRegion(int x, int y, int w, int h)
+{
+    if (bUseShm)
+    {
+        XShmPutImage(display, window, gc, Image, x, y, x, y, w, h, False);
+    }
+    else
+    {
+        XPutImage(display, window, gc, Image, x, y, x, y, w, h);
+    }
+}
+
 RenderWindow::RenderWindow()
 {
     Context = new X11WindowContext();
@@ -43,6 +264,9 @@ RenderWindow::~RenderWindow()
 
 bool RenderWindow::Create(int width, int height, bool fullscreen, int bpp)
 {
+    // Window title is updated from the render thread
+    XInitThreads();
+
     Context->display = XOpenDisplay(NULL);
     assert(Context->display);
 
@@ -54,6 +278,7 @@ bool RenderWindow::Create(int width, int height, bool fullscreen, int bpp)
 
     Context->gc = XCreateGC(Context->display, Context->window, 0, 0);
 
+    XSelectInput(Context->display, Context->window, ExposureMask);
     XMapWindow(Context->display, Context->window);
 
     // Handle window close event
@@ -65,6 +290,7 @@ bool RenderWindow::Create(int width, int height, bool fullscreen, int bpp)
 
 void RenderWindow::Destroy()
 {
+    Context->DestroyImage();
     XDestroyWindow(Context->display, Context->window);
     XFreeGC(Context->display, Context->gc);
     XCloseDisplay(Context->display);
@@ -72,15 +298,22 @@ void RenderWindow::Destroy()
 
 void RenderWindow::SetRenderBufferParameters(int BufferWidth, int BufferHeight, void* BufferData)
 {
+    Context->DestroyImage();
+
     Context->Width = BufferWidth;
     Context->Height = BufferHeight;
     Context->Pixels = (char*)BufferData;
+
+    Context->CreateImage();
 }
 
 void RenderWindow::RunWindowLoop(RayTracerProgram* Program)
 {
     std::cout << "Running X11 window loop" << std::endl;
 
+    const int ConnectionFd = ConnectionNumber(Context->display);
+    auto LastPresentTime = std::chrono::steady_clock::now();
+
     bool bQuit = false;
     while (!bQuit)
     {
@@ -92,45 +325,51 @@ void RenderWindow::RunWindowLoop(RayTracerProgram* Program)
             {
                 continue;
             }
-            
+
             switch (event.type)
             {
                 case ClientMessage:
                     bQuit = true;
                     break;
+
+                case Expose:
+                    Context->bNeedsFullRedraw = true;
+                    break;
             }
         }
 
-        //PresentRenderBuffer();
+        auto Now = std::chrono::steady_clock::now();
+        int ElapsedMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(Now - LastPresentTime).count();
+
+        if (ElapsedMs >= PresentIntervalMs)
+        {
+            PresentRenderBuffer();
+            LastPresentTime = Now;
+            ElapsedMs = 0;
+        }
+
+        XFlush(Context->display);
+
+        // Sleep until the next event arrives or it's time to present again
+        const int TimeoutMs = PresentIntervalMs - ElapsedMs;
+        timeval Timeout;
+        Timeout.tv_sec = TimeoutMs / 1000;
+        Timeout.tv_usec = (TimeoutMs % 1000) * 1000;
+
+        fd_set ReadFds;
+        FD_ZERO(&ReadFds);
+        FD_SET(ConnectionFd, &ReadFds);
+        select(ConnectionFd + 1, &ReadFds, nullptr, nullptr, &Timeout);
     }
 }
 
 void RenderWindow::SetTitle(const char* Title)
 {
     XStoreName(Context->display, Context->window, Title);
+    XFlush(Context->display);
 }
 
 void RenderWindow::PresentRenderBuffer()
 {
-    Context->pixmap = XCreatePixmapFromBitmapData(
-        Context->display, Context->window,
-        Context->Pixels, Context->Width, Context->Height,
-        0, 0, 1);
-
-    if (Context->pixmap == 0)
-    {
-        std::cout << "XCreatePixmapFromBitmapData encounted an error" << std::endl;
-    }
-
-    int RetCode = XCopyArea(
-        Context->display, Context->pixmap, Context->window, Context->gc,
-        0, 0, Context->Width, Context->Height,
-        0, 0);
-
-    if (RetCode != Success)
-    {
-        std::cout << "XCopyArea encounted an error with code " << RetCode << std::endl;
-    }
-
-    usleep(50);
+    Context->PresentDirtyTiles();
 }
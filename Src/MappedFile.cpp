@@ -0,0 +1,153 @@
+//=============================================================================
+// MappedFile.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "MappedFile.h"
+
+#if !PLATFORM_WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+RMappedFile::RMappedFile()
+	: Data(nullptr)
+	, Size(0)
+	, bIsOpen(false)
+#if PLATFORM_WIN32
+	, FileHandle(INVALID_HANDLE_VALUE)
+	, MappingHandle(nullptr)
+#endif
+{
+}
+
+RMappedFile::~RMappedFile()
+{
+	Close();
+}
+
+#if PLATFORM_WIN32
+
+bool RMappedFile::Open(const std::string& Filename)
+{
+	Close();
+
+	FileHandle = CreateFileA(Filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (FileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(FileHandle, &FileSize))
+	{
+		Close();
+		return false;
+	}
+
+	Size = (size_t)FileSize.QuadPart;
+
+	// Empty files can't be mapped
+	if (Size > 0)
+	{
+		MappingHandle = CreateFileMappingA(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (MappingHandle)
+		{
+			Data = (const char*)MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
+		}
+
+		if (!Data)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	bIsOpen = true;
+	return true;
+}
+
+void RMappedFile::Close()
+{
+	if (Data)
+	{
+		UnmapViewOfFile(Data);
+	}
+
+	if (MappingHandle)
+	{
+		CloseHandle(MappingHandle);
+	}
+
+	if (FileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(FileHandle);
+	}
+
+	Data = nullptr;
+	Size = 0;
+	bIsOpen = false;
+	FileHandle = INVALID_HANDLE_VALUE;
+	MappingHandle = nullptr;
+}
+
+#else
+
+bool RMappedFile::Open(const std::string& Filename)
+{
+	Close();
+
+	int FileDesc = open(Filename.c_str(), O_RDONLY);
+	if (FileDesc == -1)
+	{
+		return false;
+	}
+
+	struct stat FileStat;
+	if (fstat(FileDesc, &FileStat) != 0 || !S_ISREG(FileStat.st_mode))
+	{
+		close(FileDesc);
+		return false;
+	}
+
+	Size = (size_t)FileStat.st_size;
+
+	// Empty files can't be mapped
+	if (Size > 0)
+	{
+		void* MappedData = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, FileDesc, 0);
+		if (MappedData == MAP_FAILED)
+		{
+			close(FileDesc);
+			Size = 0;
+			return false;
+		}
+
+		// File will be read from begin to end
+		madvise(MappedData, Size, MADV_SEQUENTIAL);
+		Data = (const char*)MappedData;
+	}
+
+	// Mapping stays valid after the descriptor is closed
+	close(FileDesc);
+
+	bIsOpen = true;
+	return true;
+}
+
+void RMappedFile::Close()
+{
+	if (Data)
+	{
+		munmap((void*)Data, Size);
+	}
+
+	Data = nullptr;
+	Size = 0;
+	bIsOpen = false;
+}
+
+#endif	// PLATFORM_WIN32
@@ -0,0 +1,45 @@
+//=============================================================================
+// MappedFile.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "Platform.h"
+
+#include <stddef.h>
+#include <string>
+
+// Read-only view of a whole file mapped into memory
+class RMappedFile
+{
+public:
+	RMappedFile();
+	~RMappedFile();
+
+	RMappedFile(const RMappedFile&) = delete;
+	RMappedFile& operator=(const RMappedFile&) = delete;
+
+	// Map a file into memory. Returns false if the file can't be opened.
+	bool Open(const std::string& Filename);
+
+	void Close();
+
+	bool IsOpen() const { return bIsOpen; }
+
+	// Content of the file. Not null terminated.
+	const char* GetData() const { return Data; }
+
+	size_t GetSize() const { return Size; }
+
+private:
+	const char* Data;
+	size_t Size;
+	bool bIsOpen;
+
+#if PLATFORM_WIN32
+	HANDLE FileHandle;
+	HANDLE MappingHandle;
+#endif
+};
@@ -80,4 +80,88 @@ namespace RMath
 		}
 #endif	// DEBUG_CHECK_NAN
 	}
+
+	UINT32 EncodeOctahedralNormal(const RVec3& Normal)
+	{
+		const float L1Norm = fabsf(Normal.x) + fabsf(Normal.y) + fabsf(Normal.z);
+		if (FLT_EQUAL_ZERO(L1Norm))
+		{
+			return 0;
+		}
+
+		// Project to the octahedron
+		float x = Normal.x / L1Norm;
+		float y = Normal.y / L1Norm;
+
+		// Fold the lower hemisphere over the diagonals
+		if (Normal.z < 0.0f)
+		{
+			const float FoldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			const float FoldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = FoldedX;
+			y = FoldedY;
+		}
+
+		const int16_t EncodedX = (int16_t)lroundf(Math::Min(Math::Max(x, -1.0f), 1.0f) * 32767.0f);
+		const int16_t EncodedY = (int16_t)lroundf(Math::Min(Math::Max(y, -1.0f), 1.0f) * 32767.0f);
+
+		return (UINT32)(uint16_t)EncodedX | ((UINT32)(uint16_t)EncodedY << 16);
+	}
+
+	uint16_t FloatToHalf(float Value)
+	{
+		UINT32 Bits;
+		memcpy(&Bits, &Value, sizeof(Bits));
+
+		const UINT32 Sign = (Bits >> 16) & 0x8000;
+		const int FloatExponent = (Bits >> 23) & 0xFF;
+		const int Exponent = FloatExponent - 127 + 15;
+		UINT32 Mantissa = Bits & 0x7FFFFF;
+
+		if (FloatExponent == 0xFF)
+		{
+			// Infinity or nan
+			return (uint16_t)(Sign | 0x7C00 | (Mantissa ? 0x200 : 0));
+		}
+
+		if (Exponent >= 0x1F)
+		{
+			// Too large, becomes infinity
+			return (uint16_t)(Sign | 0x7C00);
+		}
+
+		if (Exponent <= 0)
+		{
+			// Too small even for a denormal half
+			if (Exponent < -10)
+			{
+				return (uint16_t)Sign;
+			}
+
+			Mantissa |= 0x800000;
+
+			const UINT32 Shift = 14 - Exponent;
+			UINT32 HalfMantissa = Mantissa >> Shift;
+			const UINT32 Remainder = Mantissa & ((1u << Shift) - 1);
+			const UINT32 Halfway = 1u << (Shift - 1);
+
+			if (Remainder > Halfway || (Remainder == Halfway && (HalfMantissa & 1)))
+			{
+				HalfMantissa++;
+			}
+
+			return (uint16_t)(Sign | HalfMantissa);
+		}
+
+		UINT32 Half = Sign | ((UINT32)Exponent << 10) | (Mantissa >> 13);
+		const UINT32 Remainder = Mantissa & 0x1FFF;
+
+		// Carry may overflow into exponent, which correctly rounds up to next power of two or infinity
+		if (Remainder > 0x1000 || (Remainder == 0x1000 && (Half & 1)))
+		{
+			Half++;
+		}
+
+		return (uint16_t)Half;
+	}
 }
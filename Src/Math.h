@@ -5,7 +5,10 @@
 //=============================================================================
 #pragma once
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include "Platform.h"
 #include "RVector.h"
 
 // Enable debug breakpoints for detecting nan values
@@ -48,4 +51,53 @@ namespace RMath
 	// Compute barycentric coordinates (u, v, w) for
 	// point p with respect to triangle (a, b, c)
 	void Barycentric(const RVec3& p, const RVec3& a, const RVec3& b, const RVec3& c, float& u, float& v, float &w);
+
+	// Encode a unit vector with octahedral mapping, 16 bits for each component
+	UINT32 EncodeOctahedralNormal(const RVec3& Normal);
+
+	// Decode a normal encoded by EncodeOctahedralNormal
+	inline RVec3 DecodeOctahedralNormal(UINT32 Encoded)
+	{
+		float x = (float)(int16_t)(Encoded & 0xFFFF) / 32767.0f;
+		float y = (float)(int16_t)(Encoded >> 16) / 32767.0f;
+		float z = 1.0f - fabsf(x) - fabsf(y);
+
+		// Unfold the lower hemisphere
+		float t = Math::Max(-z, 0.0f);
+		x += (x >= 0.0f) ? -t : t;
+		y += (y >= 0.0f) ? -t : t;
+
+		return RVec3(x, y, z).GetNormalizedVec3();
+	}
+
+	// Convert float to half precision float with rounding to nearest even
+	uint16_t FloatToHalf(float Value);
+
+	inline float HalfToFloat(uint16_t Half)
+	{
+		const UINT32 Sign = (UINT32)(Half & 0x8000) << 16;
+		const UINT32 Exponent = (Half >> 10) & 0x1F;
+		const UINT32 Mantissa = Half & 0x3FF;
+
+		UINT32 Bits;
+		if (Exponent == 0x1F)
+		{
+			// Infinity or nan
+			Bits = Sign | 0x7F800000 | (Mantissa << 13);
+		}
+		else if (Exponent != 0)
+		{
+			Bits = Sign | ((Exponent + 112) << 23) | (Mantissa << 13);
+		}
+		else
+		{
+			// Zero or denormal, value is Mantissa * 2^-24
+			const float Value = (float)Mantissa * (1.0f / 16777216.0f);
+			return Sign ? -Value : Value;
+		}
+
+		float Value;
+		memcpy(&Value, &Bits, sizeof(Value));
+		return Value;
+	}
 }
@@ -0,0 +1,69 @@
+//=============================================================================
+// MemoryArena.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "MemoryArena.h"
+
+#include <stdint.h>
+
+RMemoryArena::RMemoryArena(size_t InBlockSize /*= 256 * 1024*/)
+	: CurrentBlock(0)
+	, CurrentOffset(0)
+	, BlockSize(InBlockSize)
+{
+}
+
+RMemoryArena::~RMemoryArena()
+{
+	for (const MemoryBlock& Block : Blocks)
+	{
+		delete[] Block.Memory;
+	}
+}
+
+void* RMemoryArena::Allocate(size_t Size, size_t Alignment /*= 16*/)
+{
+	// Find the first block with enough space left, starting from the current one
+	for (; CurrentBlock < Blocks.size(); CurrentBlock++, CurrentOffset = 0)
+	{
+		const MemoryBlock& Block = Blocks[CurrentBlock];
+		const uintptr_t Address = (uintptr_t)(Block.Memory + CurrentOffset);
+		const size_t Padding = (Alignment - Address % Alignment) % Alignment;
+
+		if (CurrentOffset + Padding + Size <= Block.Size)
+		{
+			CurrentOffset += Padding + Size;
+			return Block.Memory + CurrentOffset - Size;
+		}
+	}
+
+	// Allocations larger than the block size get a block of their own
+	MemoryBlock NewBlock;
+	NewBlock.Size = (Size + Alignment > BlockSize) ? Size + Alignment : BlockSize;
+	NewBlock.Memory = new char[NewBlock.Size];
+	Blocks.push_back(NewBlock);
+
+	CurrentBlock = Blocks.size() - 1;
+	CurrentOffset = 0;
+
+	return Allocate(Size, Alignment);
+}
+
+void RMemoryArena::Reset()
+{
+	CurrentBlock = 0;
+	CurrentOffset = 0;
+}
+
+size_t RMemoryArena::GetCapacity() const
+{
+	size_t Capacity = 0;
+	for (const MemoryBlock& Block : Blocks)
+	{
+		Capacity += Block.Size;
+	}
+
+	return Capacity;
+}
@@ -0,0 +1,67 @@
+//=============================================================================
+// MemoryArena.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for transient data of a single thread. Allocations are released all at once by Reset.
+// Memory blocks are kept after reset, so an arena stops allocating from the heap once it has served its largest workload.
+class RMemoryArena
+{
+public:
+	explicit RMemoryArena(size_t InBlockSize = 256 * 1024);
+	~RMemoryArena();
+
+	RMemoryArena(const RMemoryArena&) = delete;
+	RMemoryArena& operator=(const RMemoryArena&) = delete;
+
+	// Allocate uninitialized memory
+	void* Allocate(size_t Size, size_t Alignment = 16);
+
+	// Allocate an array of default constructed elements. Destructors are never called.
+	template<typename T>
+	T* AllocateArray(int Count);
+
+	// Release all allocations, keeping memory blocks for reuse
+	void Reset();
+
+	// Total size of memory blocks owned by the arena
+	size_t GetCapacity() const;
+
+private:
+	struct MemoryBlock
+	{
+		char* Memory;
+		size_t Size;
+	};
+
+	std::vector<MemoryBlock> Blocks;
+
+	// Block allocations are currently made from and offset of the first free byte in it
+	size_t CurrentBlock;
+	size_t CurrentOffset;
+
+	size_t BlockSize;
+};
+
+
+template<typename T>
+T* RMemoryArena::AllocateArray(int Count)
+{
+	static_assert(std::is_trivially_destructible<T>::value, "Arena memory is released without calling destructors");
+
+	T* Elements = static_cast<T*>(Allocate(sizeof(T) * Count, alignof(T) > 16 ? alignof(T) : 16));
+	for (int i = 0; i < Count; i++)
+	{
+		new (&Elements[i]) T();
+	}
+
+	return Elements;
+}
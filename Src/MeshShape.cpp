@@ -6,13 +6,18 @@
 
 #include "MeshShape.h"
 #include "Math.h"
+#include "ObjParser.h"
 #include "Platform.h"
+#include "Profiler.h"
 #include "Texture.h"
 
+#include <chrono>
 #include <fstream>
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <mutex>
+#include <unordered_map>
 
 using namespace std;
 
@@ -33,164 +38,87 @@ namespace
         
         return Line;
     }
-    
-    // Get the nth number from a line
-    int GetNthNumericValue(int n, const string& Line)
-    {
-        stringstream LineStream(Line);
-        int value = -1;
-        char dummy;
-        for (int i = 0; i <= n; i++)
-        {
-            LineStream >> value >> dummy;
-        }
-        return value;
-    }
-    
-    // Split a string by a given delimiter
-    vector<string> Split(const string& Input, char Delimiter)
-    {
-        vector<string> tokens;
-        string token;
-        istringstream tokenStream(Input);
-        while (getline(tokenStream, token, Delimiter))
-        {
-            tokens.push_back(token);
-        }
-        
-        return tokens;
-    }
 }
 
-RMeshShape::RMeshShape(const string& Filename)
+namespace
 {
-	string MeshFilename = Filename;
-	ifstream InputMeshFile(MeshFilename);
-	
-	if (!InputMeshFile.is_open())
+	// Combination of attribute indices which makes a unique vertex
+	struct VertexKey
 	{
-		for (int i = 0; i < 2; i++)
-		{
-			// If file is not found, search an alternative path for it.
-			MeshFilename = std::string("../") + MeshFilename;
-			InputMeshFile = ifstream(MeshFilename.c_str());
+		int Point;
+		int Texcoord;
+		int Normal;
 
-			if (InputMeshFile.is_open())
-			{
-				break;
-			}
+		bool operator==(const VertexKey& rhs) const
+		{
+			return Point == rhs.Point && Texcoord == rhs.Texcoord && Normal == rhs.Normal;
 		}
-	}
+	};
 
-	if (!InputMeshFile.is_open())
+	struct VertexKeyHash
 	{
-		RLog("Error - RMeshShape: Unable to open %s!\n", Filename.c_str());
-		return;
-	}
+		size_t operator()(const VertexKey& Key) const
+		{
+			size_t Hash = (size_t)(unsigned)Key.Point * 73856093u;
+			Hash ^= (size_t)(unsigned)Key.Texcoord * 19349663u;
+			Hash ^= (size_t)(unsigned)Key.Normal * 83492791u;
+			return Hash;
+		}
+	};
 
-	vector<string> MaterialNameList;
-	int CurrentMaterialIdx = -1;
+	// Lower bound of cosine between ray and surface, limits texture blurring at grazing angles
+	const float MinConeCosAngle = 0.1f;
+
+	// Meshes loaded by RMeshShape::LoadShared, released when the last instance is destroyed
+	mutex SharedMeshesMutex;
+	unordered_map<string, weak_ptr<const RMeshShape>> SharedMeshes;
 
-	RLog("Loading mesh from file: %s\n", MeshFilename.c_str());
-	string Line;
-	while (getline(InputMeshFile, Line))
+	float GetElapsedMs(const chrono::steady_clock::time_point& StartTime)
 	{
-		string key = GetLineKeyword(Line);
-		string dummy;
+		return chrono::duration<float, milli>(chrono::steady_clock::now() - StartTime).count();
+	}
+}
 
-		if (key == "v")
-		{
-			stringstream LineStream(Line);
-			float Pos[3];
-			LineStream >> dummy >> Pos[0] >> Pos[1] >> Pos[2];
+RMeshShape::RMeshShape(const string& Filename)
+	: NumSourcePoints(0)
+	, LoadTimeMs(0.0f)
+	, BuildTimeMs(0.0f)
+{
+	PROFILE_SCOPE("LoadMesh");
 
-			RVec3 Vertex(Pos);
-			Points.push_back(Vertex);
-			Aabb.Expand(Vertex);
-		}
-		else if (key == "vt")
-		{
-			stringstream LineStream(Line);
-			float t[3];
-			LineStream >> dummy >> t[0] >> t[1];
-			t[2] = 0.0f;
-			Texcoords.push_back(RVec3(t));
-		}
-		else if (key == "vn")
-		{
-			stringstream LineStream(Line);
-			float n[3];
-			LineStream >> dummy >> n[0] >> n[1] >> n[2];
-			Normals.push_back(RVec3(n));
-		}
-		else if (key == "f")
-		{
-            // Note: the first token will be the key
-            auto Tokens = Split(Line, ' ');
-            int NumPolyVerts = (int)Tokens.size() - 1;
-            const vector<int>* PolyIndexArray = nullptr;
-            
-            if (NumPolyVerts == 3)      // A triangle poly
-            {
-                static const vector<int> TriangleIndex{ 0, 1, 2 };
-                PolyIndexArray = &TriangleIndex;
-            }
-            else if (NumPolyVerts == 4) // A quad poly
-            {
-                // Split a quad into two triangle
-                static const vector<int> QuadIndex{ 0, 1, 2, 0, 2, 3 };
-                PolyIndexArray = &QuadIndex;
-            }
-            
-            if (PolyIndexArray != nullptr)
-            {
-                for (int i = 0; i < (int)PolyIndexArray->size(); i++)
-                {
-                    int Index = (*PolyIndexArray)[i] + 1;
-                    
-                    int PointIndex = GetNthNumericValue(0, Tokens[Index]) - 1;
-                    PointIndices.push_back(PointIndex);
-                    
-					int TexcoordIndex = GetNthNumericValue(1, Tokens[Index]) - 1;
-					TexcoordIndices.push_back(TexcoordIndex);
+	const auto LoadStartTime = chrono::steady_clock::now();
 
-                    int NormalIndex = GetNthNumericValue(2, Tokens[Index]) - 1;
-                    NormalIndices.push_back(NormalIndex);
+	string MeshFilename = Filename;
+	ObjMeshData MeshData;
+	bool bLoaded = ObjParser::ParseObjFile(MeshFilename, MeshData);
 
-					if (i % 3 == 0)
-					{
-						// Store material id of each polygon
-						PolyMaterialId.push_back(CurrentMaterialIdx);
-					}
-                }
-            }
-		}
-		else if (key == "usemtl")
+	if (!bLoaded)
+	{
+		for (int i = 0; i < 2; i++)
 		{
-			auto Tokens = Split(Line, ' ');
-			string MaterialName = Tokens[1];
+			// If file is not found, search an alternative path for it.
+			MeshFilename = std::string("../") + MeshFilename;
+			bLoaded = ObjParser::ParseObjFile(MeshFilename, MeshData);
 
-			auto Iter = find(MaterialNameList.begin(), MaterialNameList.end(), MaterialName);
-			if (Iter == MaterialNameList.end())
-			{
-				MaterialNameList.push_back(MaterialName);
-				CurrentMaterialIdx = (int)MaterialNameList.size() - 1;
-			}
-			else
+			if (bLoaded)
 			{
-				CurrentMaterialIdx = (int)(Iter - MaterialNameList.begin());
+				break;
 			}
 		}
 	}
 
-	InputMeshFile.close();
-	RLog("Mesh loaded from %s. Verts: %d, Triangles: %d\n", Filename.c_str(), (int)Points.size(), (int)PointIndices.size() / 3);
+	if (!bLoaded)
+	{
+		RLog("Error - RMeshShape: Unable to open %s!\n", Filename.c_str());
+		return;
+	}
 
-	for (int i = 0; i < (int)PointIndices.size(); i += 3)
+	// Face normals are used by welding for vertices without normals
+	for (int i = 0; i < (int)MeshData.PointIndices.size(); i += 3)
 	{
-		const RVec3& p0 = Points[PointIndices[i]];
-		const RVec3& p1 = Points[PointIndices[i + 1]];
-		const RVec3& p2 = Points[PointIndices[i + 2]];
+		const RVec3& p0 = MeshData.Points[MeshData.PointIndices[i]];
+		const RVec3& p1 = MeshData.Points[MeshData.PointIndices[i + 1]];
+		const RVec3& p2 = MeshData.Points[MeshData.PointIndices[i + 2]];
 
 		RVec3 p0p1 = p1 - p0;
 		RVec3 p0p2 = p2 - p0;
@@ -199,6 +127,14 @@ RMeshShape::RMeshShape(const string& Filename)
 		FaceNormals.push_back(Normal);
 	}
 
+	WeldVertices(MeshData);
+	UpdateTriangleAttributes();
+
+	const vector<string>& MaterialNameList = MeshData.MaterialNames;
+	int CurrentMaterialIdx = -1;
+
+	RLog("Mesh loaded from %s. Verts: %d, Triangles: %d\n", Filename.c_str(), (int)Points.size(), GetNumTriangles());
+
 	// Load materials from .mtl file
 	string MaterialFilename = MeshFilename;
 	auto Index = MaterialFilename.find(".obj");
@@ -217,9 +153,10 @@ RMeshShape::RMeshShape(const string& Filename)
 				BasePath = MaterialFilename.substr(0, Index + 1);
 			}
 
-			Textures.resize(PolyMaterialId.size());
+			Textures.resize(MaterialNameList.size());
 			CurrentMaterialIdx = -1;
 
+			string Line;
 			while (getline(InputMaterialFile, Line))
 			{
 				string key = GetLineKeyword(Line);
@@ -263,67 +200,241 @@ RMeshShape::RMeshShape(const string& Filename)
                         SlashIdx = TexturePath.find("\\\\");
                     }
 
-					Textures[CurrentMaterialIdx] = RTexture::LoadTexturePNG(TexturePath);
+					Textures[CurrentMaterialIdx] = RTexture::LoadShared(TexturePath);
 				}
 			}
 
 			InputMaterialFile.close();
+
+			// Materials may share textures
+			vector<const RTexture*> UniqueTextures;
+			size_t TextureMemorySize = 0;
+			for (const auto& Texture : Textures)
+			{
+				if (Texture && find(UniqueTextures.begin(), UniqueTextures.end(), Texture.get()) == UniqueTextures.end())
+				{
+					UniqueTextures.push_back(Texture.get());
+					TextureMemorySize += Texture->GetMemorySize();
+				}
+			}
+
+			RLog("Textures found. Materials: %d, Textures: %d, Memory when resident: %d KB\n", (int)Textures.size(), (int)UniqueTextures.size(), (int)(TextureMemorySize / 1024));
 		}
 	}
 
+	LoadTimeMs = GetElapsedMs(LoadStartTime);
+
 	RLog("Generating spatial information for the mesh... ");
-	Spatial = unique_ptr<KdTree>(new KdTree());
-	Spatial->Build(Points.data(), PointIndices.data(), (int)PointIndices.size());
+	RebuildSpatial();
 	RLog("Done\n");
 }
 
-bool RMeshShape::TestRayIntersection(const RRay& InRay, RayHitResult* OutResult /*= nullptr*/) const
+shared_ptr<const RMeshShape> RMeshShape::LoadShared(const string& Filename)
 {
-#if USE_KDTREE
+	// Also held during loading, so concurrent requests of the same file don't load it twice
+	unique_lock<mutex> Lock(SharedMeshesMutex);
+
+	shared_ptr<const RMeshShape> Mesh = SharedMeshes[Filename].lock();
+	if (!Mesh)
+	{
+		Mesh = shared_ptr<const RMeshShape>(new RMeshShape(Filename));
+		SharedMeshes[Filename] = Mesh;
+	}
+
+	return Mesh;
+}
+
+bool RMeshShape::UpdatePoints(const RVec3 InPoints[], int NumPoints, const RVec3 InNormals[] /*= nullptr*/)
+{
+	if (NumPoints != NumSourcePoints)
+	{
+		RLog("Error - RMeshShape: Mesh has %d source positions, unable to update it with %d!\n", NumSourcePoints, NumPoints);
+		return false;
+	}
+
+	for (int i = 0; i < (int)Points.size(); i++)
+	{
+		const int SourceIndex = SourcePointIndices[i];
+		Points[i] = InPoints[SourceIndex];
+
+		if (InNormals)
+		{
+			Vertices[i] = RMeshVertex(InNormals[SourceIndex], Vertices[i].GetTexcoord());
+		}
+	}
+
+	UpdateTriangleAttributes();
+
 	if (Spatial)
 	{
-		int TriangleIndex = -1;
-		if (Spatial->TestRayIntersection(InRay, Points.data(), OutResult, &TriangleIndex))
+		Spatial->Refit(Points.data());
+	}
+
+	return true;
+}
+
+void RMeshShape::RebuildSpatial()
+{
+	const auto BuildStartTime = chrono::steady_clock::now();
+	Spatial = unique_ptr<KdTree>(new KdTree());
+	Spatial->Build(Points.data(), Indices.data(), (int)Indices.size());
+	BuildTimeMs = GetElapsedMs(BuildStartTime);
+}
+
+void RMeshShape::Translate(const RVec3& Offset)
+{
+	for (RVec3& Point : Points)
+	{
+		Point += Offset;
+	}
+
+	// Face normals and uv densities don't change by moving, only bounds need to follow the points
+	RShape::Translate(Offset);
+
+	if (Spatial)
+	{
+		Spatial->Refit(Points.data());
+	}
+}
+
+void RMeshShape::UpdateTriangleAttributes()
+{
+	FaceNormals.resize(GetNumTriangles());
+	UvDensities.resize(GetNumTriangles());
+
+	for (int Triangle = 0; Triangle < GetNumTriangles(); Triangle++)
+	{
+		const int i0 = Indices[Triangle * 3];
+		const int i1 = Indices[Triangle * 3 + 1];
+		const int i2 = Indices[Triangle * 3 + 2];
+
+		const RVec3 p0p1 = Points[i1] - Points[i0];
+		const RVec3 p0p2 = Points[i2] - Points[i0];
+		FaceNormals[Triangle] = RVec3::Cross(p0p1, p0p2).GetNormalizedVec3();
+
+		// Texture coordinate change per unit of world space length, used for choosing texture mip levels
+		const float WorldArea = RVec3::Cross(p0p1, p0p2).Magnitude();
+
+		const RVec2 t0t1 = Vertices[i1].GetTexcoord() - Vertices[i0].GetTexcoord();
+		const RVec2 t0t2 = Vertices[i2].GetTexcoord() - Vertices[i0].GetTexcoord();
+		const float UvArea = fabsf(t0t1.x * t0t2.y - t0t1.y * t0t2.x);
+
+		UvDensities[Triangle] = (WorldArea > 0.0f) ? sqrtf(UvArea / WorldArea) : 0.0f;
+	}
+
+	Aabb = RAabb();
+	for (const RVec3& Point : Points)
+	{
+		Aabb.Expand(Point);
+	}
+}
+
+void RMeshShape::WeldVertices(const ObjMeshData& MeshData)
+{
+	const int NumIndices = (int)MeshData.PointIndices.size();
+
+	unordered_map<VertexKey, int, VertexKeyHash> VertexMap;
+	VertexMap.reserve(MeshData.Points.size());
+
+	Indices.resize(NumIndices);
+	PolyMaterialId = MeshData.PolyMaterialId;
+	NumSourcePoints = (int)MeshData.Points.size();
+
+	for (int i = 0; i < NumIndices; i++)
+	{
+		const int Triangle = i / 3;
+
+		VertexKey Key;
+		Key.Point = MeshData.PointIndices[i];
+		Key.Texcoord = MeshData.TexcoordIndices[i];
+		Key.Normal = MeshData.NormalIndices[i];
+
+		// Corners without normals use the face normal, so they can't be shared with other triangles
+		const bool bUseFaceNormal = (Key.Normal == -1);
+		if (bUseFaceNormal)
 		{
-			if (OutResult)
-			{
-				const RVec3& p = OutResult->HitPosition;
+			Key.Normal = -2 - Triangle;
+		}
 
-				int v0 = TriangleIndex * 3;
-				int v1 = TriangleIndex * 3 + 1;
-				int v2 = TriangleIndex * 3 + 2;
+		// Triangles without texture coordinates can't be textured
+		if (Key.Texcoord == -1)
+		{
+			PolyMaterialId[Triangle] = -1;
+		}
+
+		auto Result = VertexMap.insert(make_pair(Key, (int)Points.size()));
+		if (Result.second)
+		{
+			const RVec3& Normal = bUseFaceNormal ? FaceNormals[Triangle] : MeshData.Normals[Key.Normal];
+			const RVec2 Texcoord = (Key.Texcoord != -1) ? RVec2(MeshData.Texcoords[Key.Texcoord].x, MeshData.Texcoords[Key.Texcoord].y) : RVec2::Zero();
+
+			Points.push_back(MeshData.Points[Key.Point]);
+			SourcePointIndices.push_back(Key.Point);
+			Vertices.push_back(RMeshVertex(Normal, Texcoord));
+		}
+
+		Indices[i] = Result.first->second;
+	}
+}
 
-				const RVec3& a = Points[PointIndices[v0]];
-				const RVec3& b = Points[PointIndices[v1]];
-				const RVec3& c = Points[PointIndices[v2]];
+void RMeshShape::GetHitAttributes(const RRay& InRay, int TriangleIndex, RayHitResult* OutResult) const
+{
+	const RVec3& p = OutResult->HitPosition;
 
-				float u, v, w;
-				RMath::Barycentric(p, a, b, c, u, v, w);
+	int v0 = TriangleIndex * 3;
+	int v1 = TriangleIndex * 3 + 1;
+	int v2 = TriangleIndex * 3 + 2;
 
-				const RVec3& n0 = Normals[NormalIndices[v0]];
-				const RVec3& n1 = Normals[NormalIndices[v1]];
-				const RVec3& n2 = Normals[NormalIndices[v2]];
+	const RVec3& a = Points[Indices[v0]];
+	const RVec3& b = Points[Indices[v1]];
+	const RVec3& c = Points[Indices[v2]];
 
-                // Use fast inverse square root for approximating normal direction
-				OutResult->HitNormal = (n0 * u + n1 * v + n2 * w).GetNormalizedVec3_Fast();
+	float u, v, w;
+	RMath::Barycentric(p, a, b, c, u, v, w);
 
-				int MaterialId = PolyMaterialId[TriangleIndex];
-				if (MaterialId != -1 && MaterialId < (int)Textures.size())
-				{
-					RTexture* Texture = Textures[MaterialId].get();
-					if (Texture)
-					{
-						const RVec3& t0 = Texcoords[TexcoordIndices[v0]];
-						const RVec3& t1 = Texcoords[TexcoordIndices[v1]];
-						const RVec3& t2 = Texcoords[TexcoordIndices[v2]];
+	const RMeshVertex& Vert0 = Vertices[Indices[v0]];
+	const RMeshVertex& Vert1 = Vertices[Indices[v1]];
+	const RMeshVertex& Vert2 = Vertices[Indices[v2]];
 
-						RVec3 texcoord = t0 * u + t1 * v + t2 * w;
+	// Use fast inverse square root for approximating normal direction
+	OutResult->HitNormal = (Vert0.GetNormal() * u + Vert1.GetNormal() * v + Vert2.GetNormal() * w).GetNormalizedVec3_Fast();
 
-						RVec4 SampledColor = Texture->Sample(texcoord.x, 1.0f - texcoord.y);
-						OutResult->SampledColor = SampledColor.ToVec3();
-						OutResult->SampledAlpha = SampledColor.w;
-					}
-				}
+	int MaterialId = PolyMaterialId[TriangleIndex];
+	if (MaterialId != -1 && MaterialId < (int)Textures.size())
+	{
+		const RTexture* Texture = Textures[MaterialId].get();
+		if (Texture)
+		{
+			RVec2 texcoord = Vert0.GetTexcoord() * u + Vert1.GetTexcoord() * v + Vert2.GetTexcoord() * w;
+
+			// Footprint of ray cone on the triangle in texture space
+			float Lod = 0.0f;
+			if (InRay.ConeWidth > 0.0f || InRay.ConeSpreadAngle > 0.0f)
+			{
+				const float HitConeWidth = InRay.ConeWidth + InRay.ConeSpreadAngle * OutResult->Distance;
+				const float CosAngle = Math::Max(fabsf(RVec3::Dot(InRay.Direction, FaceNormals[TriangleIndex])), MinConeCosAngle);
+				Lod = Texture->GetLodForFootprint(HitConeWidth / CosAngle * UvDensities[TriangleIndex]);
+			}
+
+			// Texture is sampled when the hit is shaded
+			OutResult->Texture = Texture;
+			OutResult->Texcoord = RVec2(texcoord.x, 1.0f - texcoord.y);
+			OutResult->TextureLod = Lod;
+		}
+	}
+}
+
+bool RMeshShape::TestRayIntersection(const RRay& InRay, RayHitResult* OutResult /*= nullptr*/) const
+{
+#if USE_KDTREE
+	if (Spatial)
+	{
+		int TriangleIndex = -1;
+		if (Spatial->TestRayIntersection(InRay, Points.data(), OutResult, &TriangleIndex))
+		{
+			if (OutResult)
+			{
+				GetHitAttributes(InRay, TriangleIndex, OutResult);
 			}
 
 			return true;
@@ -334,12 +445,12 @@ bool RMeshShape::TestRayIntersection(const RRay& InRay, RayHitResult* OutResult
 	RRay TestRay = InRay;
 	bool bResult = false;
 
-	for (int i = 0; i < (int)PointIndices.size(); i += 3)
+	for (int i = 0; i < (int)Indices.size(); i += 3)
 	{
 		const RVec3 TriPoints[] = {
-			Points[PointIndices[i]],
-			Points[PointIndices[i + 1]],
-			Points[PointIndices[i + 2]],
+			Points[Indices[i]],
+			Points[Indices[i + 1]],
+			Points[Indices[i + 2]],
 		};
 
 		const RVec3& Normal = FaceNormals[i / 3];
@@ -355,3 +466,127 @@ bool RMeshShape::TestRayIntersection(const RRay& InRay, RayHitResult* OutResult
 	return bResult;
 #endif  // if USE_KDTREE
 }
+
+int RMeshShape::TestPacketIntersection(RRayPacket& Packet, int LaneMask, RayHitResult OutResults[]) const
+{
+#if USE_KDTREE
+	if (Spatial)
+	{
+		int TriangleIndices[RayPacketSize];
+		const int HitMask = Spatial->TestPacketIntersection(Packet, LaneMask, Points.data(), OutResults, TriangleIndices);
+
+		for (int Lane = 0; Lane < Packet.GetNumRays(); Lane++)
+		{
+			if (HitMask & (1 << Lane))
+			{
+				GetHitAttributes(Packet.GetRay(Lane), TriangleIndices[Lane], &OutResults[Lane]);
+			}
+		}
+
+		return HitMask;
+	}
+	return 0;
+#else
+	return RShape::TestPacketIntersection(Packet, LaneMask, OutResults);
+#endif  // if USE_KDTREE
+}
+
+RMeshInstance::RMeshInstance(shared_ptr<const RMeshShape> InMesh, const RTransform& InTransform)
+	: Mesh(InMesh)
+{
+	SetTransform(InTransform);
+}
+
+void RMeshInstance::SetTransform(const RTransform& InTransform)
+{
+	Transform = InTransform;
+	InverseTransform = InTransform.GetInverse();
+	bIsIdentity = InTransform.IsIdentity();
+	UpdateBounds();
+}
+
+void RMeshInstance::UpdateBounds()
+{
+	Aabb = Transform.TransformAabb(Mesh->GetBounds());
+}
+
+void RMeshInstance::Translate(const RVec3& Offset)
+{
+	SetTransform(RTransform::MakeTranslation(Offset) * Transform);
+}
+
+bool RMeshInstance::TestRayIntersection(const RRay& InRay, RayHitResult* OutResult /*= nullptr*/) const
+{
+	if (bIsIdentity)
+	{
+		return Mesh->TestRayIntersection(InRay, OutResult);
+	}
+
+	float DirectionScale;
+	const RRay ObjectRay = GetObjectRay(InRay, DirectionScale);
+
+	if (!Mesh->TestRayIntersection(ObjectRay, OutResult))
+	{
+		return false;
+	}
+
+	if (OutResult)
+	{
+		TransformHitToWorld(OutResult, DirectionScale);
+	}
+
+	return true;
+}
+
+int RMeshInstance::TestPacketIntersection(RRayPacket& Packet, int LaneMask, RayHitResult OutResults[]) const
+{
+	if (bIsIdentity)
+	{
+		return Mesh->TestPacketIntersection(Packet, LaneMask, OutResults);
+	}
+
+	RRay ObjectRays[RayPacketSize];
+	float DirectionScales[RayPacketSize];
+
+	for (int Lane = 0; Lane < Packet.GetNumRays(); Lane++)
+	{
+		ObjectRays[Lane] = GetObjectRay(Packet.GetRay(Lane), DirectionScales[Lane]);
+	}
+
+	RRayPacket ObjectPacket(ObjectRays, Packet.GetNumRays());
+	const int HitMask = Mesh->TestPacketIntersection(ObjectPacket, LaneMask, OutResults);
+
+	for (int Lane = 0; Lane < Packet.GetNumRays(); Lane++)
+	{
+		if (HitMask & (1 << Lane))
+		{
+			TransformHitToWorld(&OutResults[Lane], DirectionScales[Lane]);
+			Packet.SetDistance(Lane, OutResults[Lane].Distance);
+		}
+	}
+
+	return HitMask;
+}
+
+RRay RMeshInstance::GetObjectRay(const RRay& InRay, float& OutDirectionScale) const
+{
+	// Direction is normalized in object space, distance is scaled to cover the same segment
+	RVec3 ObjectDirection = InverseTransform.TransformVector(InRay.Direction);
+	OutDirectionScale = ObjectDirection.Magnitude();
+	ObjectDirection /= OutDirectionScale;
+
+	RRay ObjectRay(InverseTransform.TransformPoint(InRay.Origin), ObjectDirection, InRay.Distance * OutDirectionScale);
+	ObjectRay.ConeWidth = InRay.ConeWidth * OutDirectionScale;
+	ObjectRay.ConeSpreadAngle = InRay.ConeSpreadAngle;
+
+	return ObjectRay;
+}
+
+void RMeshInstance::TransformHitToWorld(RayHitResult* HitResult, float DirectionScale) const
+{
+	HitResult->HitPosition = Transform.TransformPoint(HitResult->HitPosition);
+	HitResult->Distance /= DirectionScale;
+
+	// Normals are transformed by inverse transpose
+	HitResult->HitNormal = InverseTransform.TransformVectorTransposed(HitResult->HitNormal).GetNormalizedVec3();
+}
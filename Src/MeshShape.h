@@ -8,10 +8,41 @@
 
 #include "Shapes.h"
 #include "KdTree.h"
+#include "Math.h"
+#include "RTransform.h"
 #include "Texture.h"
 
+#include <memory>
 #include <vector>
 
+struct ObjMeshData;
+
+// Store vertex normals in 32-bit octahedral encoding and texture coordinates as half floats.
+// Saves 12 bytes per vertex, positions are always kept in full precision.
+#define USE_COMPACT_MESH_VERTEX 0
+
+// Shading attributes of a mesh vertex
+struct RMeshVertex
+{
+	RMeshVertex(const RVec3& InNormal, const RVec2& InTexcoord);
+
+#if USE_COMPACT_MESH_VERTEX
+	RVec3 GetNormal() const;
+	RVec2 GetTexcoord() const;
+
+private:
+	UINT32		PackedNormal;
+	uint16_t	PackedTexcoord[2];
+#else
+	const RVec3& GetNormal() const;
+	const RVec2& GetTexcoord() const;
+
+private:
+	RVec3	Normal;
+	RVec2	Texcoord;
+#endif	// USE_COMPACT_MESH_VERTEX
+};
+
 class RMeshShape : public RShape
 {
 public:
@@ -19,20 +50,154 @@ public:
 
 	virtual bool TestRayIntersection(const RRay& InRay, RayHitResult* OutResult = nullptr) const override;
 
+	virtual int TestPacketIntersection(RRayPacket& Packet, int LaneMask, RayHitResult OutResults[]) const override;
+
 	static unique_ptr<RMeshShape> Create(const std::string& Filename) { return std::unique_ptr<RMeshShape>(new RMeshShape(Filename)); }
 
+	// Get a mesh shared by all users of the same file. The file is only loaded if no one holds the mesh.
+	static std::shared_ptr<const RMeshShape> LoadShared(const std::string& Filename);
+
+	int GetNumTriangles() const { return (int)Indices.size() / 3; }
+
+	// Number of welded vertices. Positions of the source file are split into several vertices along uv and normal seams.
+	int GetNumPoints() const { return (int)Points.size(); }
+
+	// Positions of welded vertices
+	const RVec3* GetPoints() const { return Points.data(); }
+
+	// Number of positions in the source file
+	int GetNumSourcePoints() const { return NumSourcePoints; }
+
+	// Move vertices of the mesh for animation, optionally with new normals. Triangles stay the same.
+	// Positions and normals are given in order of the source file positions, GetNumSourcePoints of them. Each one is copied
+	// to all welded vertices made from that position, so seams stay closed. New normals replace normals of all those vertices.
+	// The spatial structure is refitted instead of built again. Meshes from LoadShared are const, deformed meshes need their own copy.
+	bool UpdatePoints(const RVec3 InPoints[], int NumPoints, const RVec3 InNormals[] = nullptr);
+
+	// Build the spatial structure again from current vertex positions. Slower than the refit done by UpdatePoints,
+	// but gives the best tree for the new shape.
+	void RebuildSpatial();
+
+	// Move all vertices of the mesh. The spatial structure is refitted.
+	virtual void Translate(const RVec3& Offset) override;
+
+	// Time spent on loading the mesh and its textures, in milliseconds
+	float GetLoadTimeMs() const { return LoadTimeMs; }
+
+	// Time spent on building the spatial structure, in milliseconds
+	float GetBuildTimeMs() const { return BuildTimeMs; }
+
 private:
+	// Merge identical position/texcoord/normal combinations of loaded mesh into indexed vertices
+	void WeldVertices(const ObjMeshData& MeshData);
+
+	// Calculate bounds, face normals and uv densities from vertex positions
+	void UpdateTriangleAttributes();
+
+	// Fill interpolated normal and texture color of a hit on a triangle
+	void GetHitAttributes(const RRay& InRay, int TriangleIndex, RayHitResult* OutResult) const;
+
+	// Vertex positions are kept apart from other attributes, they're the only data read during traversal
 	std::vector<RVec3>		Points;
-	std::vector<RVec3>		Texcoords;
-	std::vector<RVec3>		Normals;
+	std::vector<RMeshVertex>	Vertices;
+
+	// Index of the source file position each welded vertex is made from
+	std::vector<int>		SourcePointIndices;
+	int						NumSourcePoints;
+	std::vector<int>		Indices;
 	std::vector<RVec3>		FaceNormals;
-	std::vector<int>		PointIndices;
-	std::vector<int>		TexcoordIndices;
-	std::vector<int>		NormalIndices;
+	std::vector<float>		UvDensities;
 
 	// Per-polygon material id
 	std::vector<int>		PolyMaterialId;
-	std::vector<std::unique_ptr<RTexture>>	Textures;
+	std::vector<std::shared_ptr<const RTexture>>	Textures;
 
 	unique_ptr<KdTree>		Spatial;
+
+	float					LoadTimeMs;
+	float					BuildTimeMs;
 };
+
+
+// Placement of a shared mesh in the scene
+class RMeshInstance : public RShape
+{
+public:
+	RMeshInstance(std::shared_ptr<const RMeshShape> InMesh, const RTransform& InTransform);
+
+	static unique_ptr<RMeshInstance> Create(const std::string& Filename, const RTransform& InTransform = RTransform())
+	{
+		return std::unique_ptr<RMeshInstance>(new RMeshInstance(RMeshShape::LoadShared(Filename), InTransform));
+	}
+
+	virtual bool TestRayIntersection(const RRay& InRay, RayHitResult* OutResult = nullptr) const override;
+
+	virtual int TestPacketIntersection(RRayPacket& Packet, int LaneMask, RayHitResult OutResults[]) const override;
+
+	const RMeshShape* GetMesh() const { return Mesh.get(); }
+
+	const RTransform& GetTransform() const { return Transform; }
+
+	// Place the instance with a new transform. Geometry and its tree are shared and kept as they are.
+	void SetTransform(const RTransform& InTransform);
+
+	// Update world bounds after vertices of the mesh have been moved
+	void UpdateBounds();
+
+	virtual void Translate(const RVec3& Offset) override;
+
+private:
+	// Transform a world space ray into object space. Outputs the scale from world to object space distances.
+	RRay GetObjectRay(const RRay& InRay, float& OutDirectionScale) const;
+
+	// Transform a hit found in object space back to world space
+	void TransformHitToWorld(RayHitResult* HitResult, float DirectionScale) const;
+
+	std::shared_ptr<const RMeshShape> Mesh;
+
+	// Object to world transform and its inverse
+	RTransform Transform;
+	RTransform InverseTransform;
+
+	// Rays are tested against the mesh directly without transform
+	bool bIsIdentity;
+};
+
+#if USE_COMPACT_MESH_VERTEX
+
+FORCEINLINE RMeshVertex::RMeshVertex(const RVec3& InNormal, const RVec2& InTexcoord)
+	: PackedNormal(RMath::EncodeOctahedralNormal(InNormal))
+{
+	PackedTexcoord[0] = RMath::FloatToHalf(InTexcoord.x);
+	PackedTexcoord[1] = RMath::FloatToHalf(InTexcoord.y);
+}
+
+FORCEINLINE RVec3 RMeshVertex::GetNormal() const
+{
+	return RMath::DecodeOctahedralNormal(PackedNormal);
+}
+
+FORCEINLINE RVec2 RMeshVertex::GetTexcoord() const
+{
+	return RVec2(RMath::HalfToFloat(PackedTexcoord[0]), RMath::HalfToFloat(PackedTexcoord[1]));
+}
+
+#else
+
+FORCEINLINE RMeshVertex::RMeshVertex(const RVec3& InNormal, const RVec2& InTexcoord)
+	: Normal(InNormal)
+	, Texcoord(InTexcoord)
+{
+}
+
+FORCEINLINE const RVec3& RMeshVertex::GetNormal() const
+{
+	return Normal;
+}
+
+FORCEINLINE const RVec2& RMeshVertex::GetTexcoord() const
+{
+	return Texcoord;
+}
+
+#endif	// USE_COMPACT_MESH_VERTEX
@@ -0,0 +1,640 @@
+//=============================================================================
+// ObjParser.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "MathHelper.h"
+#include "ThreadUtils.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+
+namespace
+{
+	// Files are only split into chunks of at least this size
+	const size_t MinChunkSize = 1 << 20;
+
+	// Material id of faces before the first 'usemtl' of a chunk, resolved once previous chunks are known
+	const int InheritMaterialId = -2;
+
+	enum EFaceIndexFlag
+	{
+		RelativePoint		= 1 << 0,
+		RelativeTexcoord	= 1 << 1,
+		RelativeNormal		= 1 << 2,
+	};
+
+	struct FaceVertex
+	{
+		int Point;
+		int Texcoord;
+		int Normal;
+
+		// Indices counted backward from the end of the chunk, combination of EFaceIndexFlag
+		int RelativeFlags;
+	};
+
+	// Number of elements in chunks, or offsets of a chunk in final arrays
+	struct ObjElementCounts
+	{
+		ObjElementCounts()
+			: Points(0), Texcoords(0), Normals(0), Indices(0), Triangles(0)
+		{
+		}
+
+		int Points;
+		int Texcoords;
+		int Normals;
+		int Indices;
+		int Triangles;
+	};
+
+	// Geometry of a range of lines, with indices local to the chunk
+	struct ObjChunkData
+	{
+		ObjChunkData()
+			: LastMaterialId(InheritMaterialId)
+		{
+		}
+
+		ObjMeshData Mesh;
+
+		// Positions in index arrays that need offsets of previous chunks added
+		std::vector<int> RelativePointSlots;
+		std::vector<int> RelativeTexcoordSlots;
+		std::vector<int> RelativeNormalSlots;
+
+		// Material in use at the end of the chunk
+		int LastMaterialId;
+	};
+
+	// Powers of ten which are exactly representable in double
+	const double PowersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+
+	FORCEINLINE bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	FORCEINLINE bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	FORCEINLINE const char* SkipSpaces(const char* p, const char* End)
+	{
+		while (p < End && IsSpace(*p))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	// Whether a line starts with a keyword followed by a space
+	FORCEINLINE bool MatchKeyword(const char* p, const char* End, const char* Keyword, int Length)
+	{
+		return End - p > Length && memcmp(p, Keyword, Length) == 0 && IsSpace(p[Length]);
+	}
+
+	double PowerOfTen(int Exponent)
+	{
+		return Exponent < 23 ? PowersOfTen[Exponent] : pow(10.0, Exponent);
+	}
+
+	bool ParseInt(const char*& p, const char* End, int& OutValue)
+	{
+		const char* Start = p;
+
+		bool bNegative = false;
+		if (p < End && (*p == '-' || *p == '+'))
+		{
+			bNegative = (*p == '-');
+			p++;
+		}
+
+		if (p == End || !IsDigit(*p))
+		{
+			p = Start;
+			return false;
+		}
+
+		int Value = 0;
+		while (p < End && IsDigit(*p))
+		{
+			Value = Value * 10 + (*p - '0');
+			p++;
+		}
+
+		OutValue = bNegative ? -Value : Value;
+		return true;
+	}
+
+	bool ParseFloat(const char*& p, const char* End, float& OutValue)
+	{
+		const char* Start = p;
+
+		bool bNegative = false;
+		if (p < End && (*p == '-' || *p == '+'))
+		{
+			bNegative = (*p == '-');
+			p++;
+		}
+
+		// Keep up to 17 significant digits in the mantissa, the rest only affect exponent
+		const uint64_t MaxMantissa = 10000000000000000ULL;
+		uint64_t Mantissa = 0;
+		int Exponent = 0;
+		int NumDigits = 0;
+
+		while (p < End && IsDigit(*p))
+		{
+			if (Mantissa < MaxMantissa)
+			{
+				Mantissa = Mantissa * 10 + (*p - '0');
+			}
+			else
+			{
+				Exponent++;
+			}
+			NumDigits++;
+			p++;
+		}
+
+		if (p < End && *p == '.')
+		{
+			p++;
+			while (p < End && IsDigit(*p))
+			{
+				if (Mantissa < MaxMantissa)
+				{
+					Mantissa = Mantissa * 10 + (*p - '0');
+					Exponent--;
+				}
+				NumDigits++;
+				p++;
+			}
+		}
+
+		if (NumDigits == 0)
+		{
+			p = Start;
+			return false;
+		}
+
+		if (p < End && (*p == 'e' || *p == 'E'))
+		{
+			const char* ExponentStart = p;
+			p++;
+
+			int ExponentValue;
+			if (ParseInt(p, End, ExponentValue))
+			{
+				Exponent += ExponentValue;
+			}
+			else
+			{
+				p = ExponentStart;
+			}
+		}
+
+		double Value = (double)Mantissa;
+		if (Exponent < 0)
+		{
+			Value /= PowerOfTen(-Exponent);
+		}
+		else if (Exponent > 0)
+		{
+			Value *= PowerOfTen(Exponent);
+		}
+
+		OutValue = (float)(bNegative ? -Value : Value);
+		return true;
+	}
+
+	// Read up to three floats of a line, missing values are zero
+	RVec3 ParseVector(const char* p, const char* LineEnd, int NumComponents)
+	{
+		float Values[3] = { 0.0f, 0.0f, 0.0f };
+
+		for (int i = 0; i < NumComponents; i++)
+		{
+			p = SkipSpaces(p, LineEnd);
+			if (!ParseFloat(p, LineEnd, Values[i]))
+			{
+				break;
+			}
+		}
+
+		return RVec3(Values);
+	}
+
+	// Convert an OBJ index to zero-based index. Negative indices count backward from the last element
+	// of current chunk, and are flagged so elements of previous chunks can be added later.
+	FORCEINLINE int ResolveIndex(int Index, int NumChunkElements, int RelativeFlag, int& OutRelativeFlags)
+	{
+		if (Index > 0)
+		{
+			return Index - 1;
+		}
+
+		OutRelativeFlags |= RelativeFlag;
+		return NumChunkElements + Index;
+	}
+
+	// Parse a face vertex in form of 'v', 'v/vt', 'v//vn' or 'v/vt/vn'
+	bool ParseFaceVertex(const char*& p, const char* End, const ObjMeshData& Data, FaceVertex& OutVertex)
+	{
+		int Index;
+		if (!ParseInt(p, End, Index) || Index == 0)
+		{
+			return false;
+		}
+
+		OutVertex.RelativeFlags = 0;
+		OutVertex.Point = ResolveIndex(Index, (int)Data.Points.size(), RelativePoint, OutVertex.RelativeFlags);
+		OutVertex.Texcoord = -1;
+		OutVertex.Normal = -1;
+
+		if (p < End && *p == '/')
+		{
+			p++;
+			if (ParseInt(p, End, Index) && Index != 0)
+			{
+				OutVertex.Texcoord = ResolveIndex(Index, (int)Data.Texcoords.size(), RelativeTexcoord, OutVertex.RelativeFlags);
+			}
+
+			if (p < End && *p == '/')
+			{
+				p++;
+				if (ParseInt(p, End, Index) && Index != 0)
+				{
+					OutVertex.Normal = ResolveIndex(Index, (int)Data.Normals.size(), RelativeNormal, OutVertex.RelativeFlags);
+				}
+			}
+		}
+
+		// Anything else attached to the vertex makes the face malformed
+		return p == End || IsSpace(*p);
+	}
+
+	void AddTriangle(const FaceVertex& v0, const FaceVertex& v1, const FaceVertex& v2, int MaterialId, ObjChunkData& Chunk)
+	{
+		ObjMeshData& Data = Chunk.Mesh;
+
+		const FaceVertex* Corners[] = { &v0, &v1, &v2 };
+		for (const FaceVertex* Corner : Corners)
+		{
+			if (Corner->RelativeFlags)
+			{
+				const int Slot = (int)Data.PointIndices.size();
+
+				if (Corner->RelativeFlags & RelativePoint)
+				{
+					Chunk.RelativePointSlots.push_back(Slot);
+				}
+
+				if (Corner->RelativeFlags & RelativeTexcoord)
+				{
+					Chunk.RelativeTexcoordSlots.push_back(Slot);
+				}
+
+				if (Corner->RelativeFlags & RelativeNormal)
+				{
+					Chunk.RelativeNormalSlots.push_back(Slot);
+				}
+			}
+
+			Data.PointIndices.push_back(Corner->Point);
+			Data.TexcoordIndices.push_back(Corner->Texcoord);
+			Data.NormalIndices.push_back(Corner->Normal);
+		}
+
+		Data.PolyMaterialId.push_back(MaterialId);
+	}
+
+	void ParseFace(const char* p, const char* LineEnd, int MaterialId, ObjChunkData& Chunk)
+	{
+		const ObjMeshData& Data = Chunk.Mesh;
+		FaceVertex FirstVertex, PrevVertex, Vertex;
+		int NumFaceVerts = 0;
+
+		while (1)
+		{
+			p = SkipSpaces(p, LineEnd);
+			if (p == LineEnd)
+			{
+				break;
+			}
+
+			if (!ParseFaceVertex(p, LineEnd, Data, Vertex))
+			{
+				RLog("Warning - ObjParser: Ignoring malformed face vertex\n");
+				break;
+			}
+
+			// Triangulate polygons as a fan around the first vertex
+			if (NumFaceVerts == 0)
+			{
+				FirstVertex = Vertex;
+			}
+			else if (NumFaceVerts >= 2)
+			{
+				AddTriangle(FirstVertex, PrevVertex, Vertex, MaterialId, Chunk);
+			}
+
+			PrevVertex = Vertex;
+			NumFaceVerts++;
+		}
+	}
+
+	int FindOrAddMaterial(const char* Name, const char* NameEnd, std::vector<std::string>& MaterialNames)
+	{
+		const size_t Length = NameEnd - Name;
+
+		for (int i = 0; i < (int)MaterialNames.size(); i++)
+		{
+			const std::string& MaterialName = MaterialNames[i];
+			if (MaterialName.size() == Length && memcmp(MaterialName.data(), Name, Length) == 0)
+			{
+				return i;
+			}
+		}
+
+		MaterialNames.push_back(std::string(Name, Length));
+		return (int)MaterialNames.size() - 1;
+	}
+
+	// Parse lines in range [Begin, End) into chunk local arrays
+	void ParseObjChunk(const char* Begin, const char* End, ObjChunkData& OutChunk)
+	{
+		ObjMeshData& Data = OutChunk.Mesh;
+		int CurrentMaterialIdx = InheritMaterialId;
+		const char* p = Begin;
+
+		while (p < End)
+		{
+			const char* LineEnd = (const char*)memchr(p, '\n', End - p);
+			if (!LineEnd)
+			{
+				LineEnd = End;
+			}
+
+			p = SkipSpaces(p, LineEnd);
+
+			if (MatchKeyword(p, LineEnd, "v", 1))
+			{
+				RVec3 Point = ParseVector(p + 2, LineEnd, 3);
+				Data.Points.push_back(Point);
+			}
+			else if (MatchKeyword(p, LineEnd, "vt", 2))
+			{
+				RVec3 Texcoord = ParseVector(p + 3, LineEnd, 2);
+				Data.Texcoords.push_back(Texcoord);
+			}
+			else if (MatchKeyword(p, LineEnd, "vn", 2))
+			{
+				RVec3 Normal = ParseVector(p + 3, LineEnd, 3);
+				Data.Normals.push_back(Normal);
+			}
+			else if (MatchKeyword(p, LineEnd, "f", 1))
+			{
+				ParseFace(p + 2, LineEnd, CurrentMaterialIdx, OutChunk);
+			}
+			else if (MatchKeyword(p, LineEnd, "usemtl", 6))
+			{
+				const char* Name = SkipSpaces(p + 7, LineEnd);
+				const char* NameEnd = Name;
+				while (NameEnd < LineEnd && !IsSpace(*NameEnd))
+				{
+					NameEnd++;
+				}
+
+				CurrentMaterialIdx = FindOrAddMaterial(Name, NameEnd, Data.MaterialNames);
+			}
+
+			// Other statements such as comments, groups and smoothing groups are ignored
+			p = (LineEnd < End) ? LineEnd + 1 : End;
+		}
+
+		OutChunk.LastMaterialId = CurrentMaterialIdx;
+	}
+
+	// Split range [Begin, End) into chunks starting at line boundaries
+	std::vector<const char*> SplitIntoChunks(const char* Begin, const char* End, int MaxChunks)
+	{
+		const size_t Size = End - Begin;
+		const int NumChunks = (int)Math::Max((size_t)1, Math::Min((size_t)MaxChunks, Size / MinChunkSize));
+
+		std::vector<const char*> ChunkBegins;
+		ChunkBegins.push_back(Begin);
+
+		for (int i = 1; i < NumChunks; i++)
+		{
+			const char* p = Math::Max(Begin + Size / NumChunks * i, ChunkBegins.back());
+			const char* LineEnd = (const char*)memchr(p, '\n', End - p);
+
+			if (!LineEnd)
+			{
+				break;
+			}
+
+			if (LineEnd + 1 < End)
+			{
+				ChunkBegins.push_back(LineEnd + 1);
+			}
+		}
+
+		ChunkBegins.push_back(End);
+		return ChunkBegins;
+	}
+
+	// Copy a chunk into the final arrays at its offsets
+	void StitchChunk(const ObjChunkData& Chunk, const ObjElementCounts& Offsets, const std::vector<int>& MaterialRemap, int InheritedMaterialId, ObjMeshData& OutData)
+	{
+		const ObjMeshData& Data = Chunk.Mesh;
+
+		const int PointOffset = Offsets.Points;
+		const int TexcoordOffset = Offsets.Texcoords;
+		const int NormalOffset = Offsets.Normals;
+		const int IndexOffset = Offsets.Indices;
+		const int TriangleOffset = Offsets.Triangles;
+
+		std::copy(Data.Points.begin(), Data.Points.end(), OutData.Points.begin() + PointOffset);
+		std::copy(Data.Texcoords.begin(), Data.Texcoords.end(), OutData.Texcoords.begin() + TexcoordOffset);
+		std::copy(Data.Normals.begin(), Data.Normals.end(), OutData.Normals.begin() + NormalOffset);
+		std::copy(Data.PointIndices.begin(), Data.PointIndices.end(), OutData.PointIndices.begin() + IndexOffset);
+		std::copy(Data.TexcoordIndices.begin(), Data.TexcoordIndices.end(), OutData.TexcoordIndices.begin() + IndexOffset);
+		std::copy(Data.NormalIndices.begin(), Data.NormalIndices.end(), OutData.NormalIndices.begin() + IndexOffset);
+
+		// Relative indices also count elements of all previous chunks
+		for (int Slot : Chunk.RelativePointSlots)
+		{
+			OutData.PointIndices[IndexOffset + Slot] += PointOffset;
+		}
+
+		for (int Slot : Chunk.RelativeTexcoordSlots)
+		{
+			OutData.TexcoordIndices[IndexOffset + Slot] += TexcoordOffset;
+		}
+
+		for (int Slot : Chunk.RelativeNormalSlots)
+		{
+			OutData.NormalIndices[IndexOffset + Slot] += NormalOffset;
+		}
+
+		for (int i = 0; i < (int)Data.PolyMaterialId.size(); i++)
+		{
+			const int MaterialId = Data.PolyMaterialId[i];
+			OutData.PolyMaterialId[TriangleOffset + i] = (MaterialId == InheritMaterialId) ? InheritedMaterialId : MaterialRemap[MaterialId];
+		}
+	}
+
+	// Remove triangles referencing points which don't exist and clear invalid attribute indices
+	void ValidateIndices(ObjMeshData& Data)
+	{
+		const int NumPoints = (int)Data.Points.size();
+		const int NumTexcoords = (int)Data.Texcoords.size();
+		const int NumNormals = (int)Data.Normals.size();
+		const int NumTriangles = (int)Data.PolyMaterialId.size();
+		int NumValidTriangles = 0;
+
+		for (int Triangle = 0; Triangle < NumTriangles; Triangle++)
+		{
+			bool bValid = true;
+			for (int i = Triangle * 3; i < Triangle * 3 + 3; i++)
+			{
+				bValid &= (Data.PointIndices[i] >= 0 && Data.PointIndices[i] < NumPoints);
+			}
+
+			if (!bValid)
+			{
+				continue;
+			}
+
+			for (int i = 0; i < 3; i++)
+			{
+				const int Src = Triangle * 3 + i;
+				const int Dest = NumValidTriangles * 3 + i;
+
+				int TexcoordIndex = Data.TexcoordIndices[Src];
+				int NormalIndex = Data.NormalIndices[Src];
+
+				Data.PointIndices[Dest] = Data.PointIndices[Src];
+				Data.TexcoordIndices[Dest] = (TexcoordIndex >= 0 && TexcoordIndex < NumTexcoords) ? TexcoordIndex : -1;
+				Data.NormalIndices[Dest] = (NormalIndex >= 0 && NormalIndex < NumNormals) ? NormalIndex : -1;
+			}
+
+			Data.PolyMaterialId[NumValidTriangles] = Data.PolyMaterialId[Triangle];
+			NumValidTriangles++;
+		}
+
+		if (NumValidTriangles != NumTriangles)
+		{
+			RLog("Warning - ObjParser: Removed %d triangles with invalid vertex indices\n", NumTriangles - NumValidTriangles);
+
+			Data.PointIndices.resize(NumValidTriangles * 3);
+			Data.TexcoordIndices.resize(NumValidTriangles * 3);
+			Data.NormalIndices.resize(NumValidTriangles * 3);
+			Data.PolyMaterialId.resize(NumValidTriangles);
+		}
+	}
+}
+
+namespace ObjParser
+{
+	bool ParseObjFile(const std::string& Filename, ObjMeshData& OutData)
+	{
+		RMappedFile File;
+		if (!File.Open(Filename))
+		{
+			return false;
+		}
+
+		ParseObjBuffer(File.GetData(), File.GetData() + File.GetSize(), OutData, ThreadUtils::DetectWorkerThreadsNum());
+		return true;
+	}
+
+	void ParseObjBuffer(const char* Begin, const char* End, ObjMeshData& OutData, int MaxThreads /*= 1*/)
+	{
+		const std::vector<const char*> ChunkBegins = SplitIntoChunks(Begin, End, MaxThreads);
+		const int NumChunks = (int)ChunkBegins.size() - 1;
+
+		std::vector<ObjChunkData> Chunks(NumChunks);
+
+		// Parse all chunks in parallel. The first chunk is parsed on calling thread.
+		{
+			ScopeAutoJoinedThreads ParseThreads;
+			for (int i = 1; i < NumChunks; i++)
+			{
+				std::thread ParseThread(ParseObjChunk, ChunkBegins[i], ChunkBegins[i + 1], std::ref(Chunks[i]));
+				ParseThreads.AddThread(ParseThread);
+			}
+
+			ParseObjChunk(ChunkBegins[0], ChunkBegins[1], Chunks[0]);
+		}
+
+		// Prefix sums of element counts and material in use at the beginning of each chunk
+		std::vector<ObjElementCounts> Offsets(NumChunks + 1);
+		std::vector<std::vector<int>> MaterialRemaps(NumChunks);
+		std::vector<int> InheritedMaterialIds(NumChunks);
+
+		OutData.MaterialNames.clear();
+		int CurrentMaterialIdx = -1;
+
+		for (int i = 0; i < NumChunks; i++)
+		{
+			const ObjMeshData& Data = Chunks[i].Mesh;
+
+			Offsets[i + 1].Points = Offsets[i].Points + (int)Data.Points.size();
+			Offsets[i + 1].Texcoords = Offsets[i].Texcoords + (int)Data.Texcoords.size();
+			Offsets[i + 1].Normals = Offsets[i].Normals + (int)Data.Normals.size();
+			Offsets[i + 1].Indices = Offsets[i].Indices + (int)Data.PointIndices.size();
+			Offsets[i + 1].Triangles = Offsets[i].Triangles + (int)Data.PolyMaterialId.size();
+
+			for (const std::string& MaterialName : Data.MaterialNames)
+			{
+				const char* Name = MaterialName.data();
+				MaterialRemaps[i].push_back(FindOrAddMaterial(Name, Name + MaterialName.size(), OutData.MaterialNames));
+			}
+
+			InheritedMaterialIds[i] = CurrentMaterialIdx;
+			if (Chunks[i].LastMaterialId != InheritMaterialId)
+			{
+				CurrentMaterialIdx = MaterialRemaps[i][Chunks[i].LastMaterialId];
+			}
+		}
+
+		const ObjElementCounts& Totals = Offsets[NumChunks];
+		OutData.Points.resize(Totals.Points);
+		OutData.Texcoords.resize(Totals.Texcoords);
+		OutData.Normals.resize(Totals.Normals);
+		OutData.PointIndices.resize(Totals.Indices);
+		OutData.TexcoordIndices.resize(Totals.Indices);
+		OutData.NormalIndices.resize(Totals.Indices);
+		OutData.PolyMaterialId.resize(Totals.Triangles);
+
+		// Copy chunks to final arrays in parallel
+		{
+			ScopeAutoJoinedThreads StitchThreads;
+			for (int i = 1; i < NumChunks; i++)
+			{
+				std::thread StitchThread(StitchChunk, std::cref(Chunks[i]), std::cref(Offsets[i]), std::cref(MaterialRemaps[i]), InheritedMaterialIds[i], std::ref(OutData));
+				StitchThreads.AddThread(StitchThread);
+			}
+
+			StitchChunk(Chunks[0], Offsets[0], MaterialRemaps[0], InheritedMaterialIds[0], OutData);
+		}
+
+		ValidateIndices(OutData);
+	}
+}
@@ -0,0 +1,39 @@
+//=============================================================================
+// ObjParser.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "RVector.h"
+
+#include <string>
+#include <vector>
+
+// Geometry read from a Wavefront OBJ file
+struct ObjMeshData
+{
+	std::vector<RVec3>			Points;
+	std::vector<RVec3>			Texcoords;
+	std::vector<RVec3>			Normals;
+
+	// Zero-based indices of each triangle corner. Texcoord and normal indices are -1 if missing.
+	std::vector<int>			PointIndices;
+	std::vector<int>			TexcoordIndices;
+	std::vector<int>			NormalIndices;
+
+	// Material id of each triangle, -1 if no material is used
+	std::vector<int>			PolyMaterialId;
+	std::vector<std::string>	MaterialNames;
+};
+
+namespace ObjParser
+{
+	// Parse an OBJ file mapped into memory on all worker threads. Returns false if the file can't be opened.
+	bool ParseObjFile(const std::string& Filename, ObjMeshData& OutData);
+
+	// Parse OBJ content in range [Begin, End). Polygons are triangulated as fans.
+	// Large buffers are split at line boundaries and parsed on up to MaxThreads threads.
+	void ParseObjBuffer(const char* Begin, const char* End, ObjMeshData& OutData, int MaxThreads = 1);
+}
@@ -0,0 +1,163 @@
+//=============================================================================
+// Profiler.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "Profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+namespace
+{
+	// Max number of events kept for each thread, older events are overwritten. Must be power of two.
+	const int MaxThreadEvents = 1 << 16;
+
+	const auto ProfilerStartTime = std::chrono::steady_clock::now();
+
+	struct ProfileEvent
+	{
+		const char* Name;
+		long long StartTimeUs;
+		long long DurationUs;
+		int Arg;
+	};
+
+	// Events recorded by a single thread. Only the owning thread writes to it.
+	struct ThreadEventBuffer
+	{
+		ThreadEventBuffer(int InThreadId)
+			: ThreadId(InThreadId)
+			, Events(MaxThreadEvents)
+			, NumEvents(0)
+		{
+		}
+
+		int ThreadId;
+		std::string ThreadName;
+		std::vector<ProfileEvent> Events;
+
+		// Total number of events added, published after the event is written
+		std::atomic<long long> NumEvents;
+	};
+
+	// Buffers of all threads. Kept until exit so events of finished threads can still be written.
+	std::mutex ThreadBuffersMutex;
+	std::vector<std::unique_ptr<ThreadEventBuffer>> ThreadBuffers;
+
+	thread_local ThreadEventBuffer* CurrentThreadBuffer = nullptr;
+
+	ThreadEventBuffer* GetThreadBuffer()
+	{
+		if (!CurrentThreadBuffer)
+		{
+			// Registration only happens once per thread
+			std::unique_lock<std::mutex> Lock(ThreadBuffersMutex);
+
+			ThreadBuffers.push_back(std::unique_ptr<ThreadEventBuffer>(new ThreadEventBuffer((int)ThreadBuffers.size())));
+			CurrentThreadBuffer = ThreadBuffers.back().get();
+		}
+
+		return CurrentThreadBuffer;
+	}
+
+	// Write a string with JSON escaping
+	void WriteJsonString(FILE* File, const std::string& String)
+	{
+		fputc('"', File);
+		for (char c : String)
+		{
+			if (c == '"' || c == '\\')
+			{
+				fputc('\\', File);
+			}
+			fputc(c, File);
+		}
+		fputc('"', File);
+	}
+}
+
+namespace Profiler
+{
+	long long GetTimeInMicroseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ProfilerStartTime).count();
+	}
+
+	void AddEvent(const char* Name, long long StartTimeUs, long long EndTimeUs, int Arg)
+	{
+		ThreadEventBuffer* Buffer = GetThreadBuffer();
+
+		const long long Index = Buffer->NumEvents.load(std::memory_order_relaxed);
+		ProfileEvent& Event = Buffer->Events[Index & (MaxThreadEvents - 1)];
+		Event.Name = Name;
+		Event.StartTimeUs = StartTimeUs;
+		Event.DurationUs = EndTimeUs - StartTimeUs;
+		Event.Arg = Arg;
+
+		Buffer->NumEvents.store(Index + 1, std::memory_order_release);
+	}
+
+	void SetThreadName(const std::string& Name)
+	{
+		GetThreadBuffer()->ThreadName = Name;
+	}
+
+	bool WriteChromeTrace(const std::string& Filename)
+	{
+		FILE* File = fopen(Filename.c_str(), "w");
+		if (!File)
+		{
+			RLog("Unable to write profiler trace %s\n", Filename.c_str());
+			return false;
+		}
+
+		std::unique_lock<std::mutex> Lock(ThreadBuffersMutex);
+
+		fprintf(File, "{\"traceEvents\":[\n");
+		bool bFirstEvent = true;
+
+		for (auto& Buffer : ThreadBuffers)
+		{
+			if (!Buffer->ThreadName.empty())
+			{
+				fprintf(File, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":", bFirstEvent ? "" : ",\n", Buffer->ThreadId);
+				WriteJsonString(File, Buffer->ThreadName);
+				fprintf(File, "}}");
+				bFirstEvent = false;
+			}
+
+			// Oldest events were overwritten if the ring buffer is full
+			const long long NumEvents = Buffer->NumEvents.load(std::memory_order_acquire);
+			const long long FirstEvent = NumEvents > MaxThreadEvents ? NumEvents - MaxThreadEvents : 0;
+
+			for (long long i = FirstEvent; i < NumEvents; i++)
+			{
+				const ProfileEvent& Event = Buffer->Events[i & (MaxThreadEvents - 1)];
+
+				fprintf(File, "%s{\"name\":", bFirstEvent ? "" : ",\n");
+				WriteJsonString(File, Event.Name);
+				fprintf(File, ",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%lld,\"dur\":%lld", Buffer->ThreadId, Event.StartTimeUs, Event.DurationUs);
+
+				if (Event.Arg != -1)
+				{
+					fprintf(File, ",\"args\":{\"value\":%d}", Event.Arg);
+				}
+
+				fprintf(File, "}");
+				bFirstEvent = false;
+			}
+		}
+
+		fprintf(File, "\n]}\n");
+		fclose(File);
+
+		RLog("Profiler trace saved as %s\n", Filename.c_str());
+		return true;
+	}
+}
@@ -0,0 +1,70 @@
+//=============================================================================
+// Profiler.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "Platform.h"
+
+#include <string>
+
+// Record timeline events of render phases and worker threads.
+// Profiling code is compiled out when disabled.
+#define ENABLE_PROFILER 0
+
+namespace Profiler
+{
+	// Current time in microseconds since program start
+	long long GetTimeInMicroseconds();
+
+	// Add a finished event to the ring buffer of calling thread. Name must be a string literal.
+	void AddEvent(const char* Name, long long StartTimeUs, long long EndTimeUs, int Arg);
+
+	// Set the name of calling thread shown in the timeline
+	void SetThreadName(const std::string& Name);
+
+	// Write recorded events of all threads as Chrome trace_event JSON.
+	// Should be called after worker threads are stopped.
+	bool WriteChromeTrace(const std::string& Filename);
+}
+
+// Record an event from construction to the end of the scope
+class ScopedProfileEvent
+{
+public:
+	ScopedProfileEvent(const char* InName, int InArg = -1)
+		: Name(InName)
+		, Arg(InArg)
+		, StartTimeUs(Profiler::GetTimeInMicroseconds())
+	{
+	}
+
+	~ScopedProfileEvent()
+	{
+		Profiler::AddEvent(Name, StartTimeUs, Profiler::GetTimeInMicroseconds(), Arg);
+	}
+
+private:
+	const char* Name;
+	int Arg;
+	long long StartTimeUs;
+};
+
+#if ENABLE_PROFILER
+
+#define PROFILE_CONCAT_INNER(a, b)		a##b
+#define PROFILE_CONCAT(a, b)			PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(Name)				ScopedProfileEvent PROFILE_CONCAT(ProfileEvent_, __LINE__)(Name)
+#define PROFILE_SCOPE_ARG(Name, Arg)	ScopedProfileEvent PROFILE_CONCAT(ProfileEvent_, __LINE__)(Name, Arg)
+#define PROFILE_THREAD_NAME(Name)		Profiler::SetThreadName(Name)
+
+#else
+
+#define PROFILE_SCOPE(Name)
+#define PROFILE_SCOPE_ARG(Name, Arg)
+#define PROFILE_THREAD_NAME(Name)
+
+#endif	// ENABLE_PROFILER
@@ -8,6 +8,7 @@
 
 #include "Platform.h"
 #include "RVector.h"
+#include "RVec3A.h"
 
 class RAabb
 {
@@ -26,17 +27,6 @@ public:
         if (p.z > pMax.z) pMax.z = p.z;
     }
     
-    RAabb& operator=(const RAabb& rhs)
-    {
-        if (this != &rhs)
-        {
-            this->pMin = rhs.pMin;
-            this->pMax = rhs.pMax;
-        }
-        
-        return *this;
-    }
-    
     inline void Expand(const RAabb& aabb)
     {
         Expand(aabb.pMin);
@@ -66,3 +56,29 @@ FORCEINLINE bool RAabb::IsValid() const
 	return pMax.x >= pMin.x && pMax.y >= pMin.y && pMax.z >= pMin.z;
 }
 
+
+// Aabb with aligned bounds for SIMD intersection tests
+class RAabbA
+{
+public:
+	RVec3A pMin;
+	RVec3A pMax;
+
+	RAabbA() {}
+	explicit RAabbA(const RAabb& aabb);
+
+	RAabb ToAabb() const;
+};
+
+FORCEINLINE RAabbA::RAabbA(const RAabb& aabb)
+	: pMin(aabb.pMin), pMax(aabb.pMax)
+{
+}
+
+FORCEINLINE RAabb RAabbA::ToAabb() const
+{
+	RAabb aabb;
+	aabb.pMin = pMin.ToVec3();
+	aabb.pMax = pMax.ToVec3();
+	return aabb;
+}
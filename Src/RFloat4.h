@@ -0,0 +1,373 @@
+//=============================================================================
+// RFloat4.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+// Shares the SIMD backend selection of RVec3A
+#include "RVec3A.h"
+
+#include <string.h>
+
+// Four independent floats in a 16-byte aligned register, used for operating on SoA data.
+// Comparisons return masks with all bits of a lane set when true.
+class alignas(16) RFloat4
+{
+public:
+	RFloat4();
+
+	// All lanes set to the same value
+	static RFloat4 Replicate(float Value);
+
+	// Load from and store to 16-byte aligned memory
+	static RFloat4 Load(const float* Data);
+	void Store(float* Data) const;
+
+	RFloat4 operator+(const RFloat4& rhs) const;
+	RFloat4 operator-(const RFloat4& rhs) const;
+	RFloat4 operator*(const RFloat4& rhs) const;
+	RFloat4 operator/(const RFloat4& rhs) const;
+	RFloat4 operator-() const;
+
+	// Per lane min and max. Same as Math::Min and Math::Max, b is returned when either lane is NaN.
+	static RFloat4 Min(const RFloat4& a, const RFloat4& b);
+	static RFloat4 Max(const RFloat4& a, const RFloat4& b);
+
+	static RFloat4 Abs(const RFloat4& a);
+	static RFloat4 Sqrt(const RFloat4& a);
+
+	static RFloat4 CompareLess(const RFloat4& a, const RFloat4& b);
+	static RFloat4 CompareGreater(const RFloat4& a, const RFloat4& b);
+
+	// Pick lanes from a where mask is set and from b elsewhere
+	static RFloat4 Select(const RFloat4& Mask, const RFloat4& a, const RFloat4& b);
+
+	// Sign bits of all lanes packed in bit 0 to 3. Gives lanes set in a comparison mask.
+	int GetMask() const;
+
+private:
+#if RVEC3A_SSE
+	explicit RFloat4(__m128 InV) : v(InV) {}
+
+	__m128 v;
+#elif RVEC3A_NEON
+	explicit RFloat4(float32x4_t InV) : v(InV) {}
+
+	float32x4_t v;
+#else
+	RFloat4(float x, float y, float z, float w);
+
+	// Lane value of a comparison mask
+	static float MaskLane(bool bSet);
+
+	float v[4];
+#endif
+};
+
+#if RVEC3A_SSE
+
+FORCEINLINE RFloat4::RFloat4()
+	: v(_mm_setzero_ps())
+{
+}
+
+FORCEINLINE RFloat4 RFloat4::Replicate(float Value)
+{
+	return RFloat4(_mm_set1_ps(Value));
+}
+
+FORCEINLINE RFloat4 RFloat4::Load(const float* Data)
+{
+	return RFloat4(_mm_load_ps(Data));
+}
+
+FORCEINLINE void RFloat4::Store(float* Data) const
+{
+	_mm_store_ps(Data, v);
+}
+
+FORCEINLINE RFloat4 RFloat4::operator+(const RFloat4& rhs) const
+{
+	return RFloat4(_mm_add_ps(v, rhs.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::operator-(const RFloat4& rhs) const
+{
+	return RFloat4(_mm_sub_ps(v, rhs.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::operator*(const RFloat4& rhs) const
+{
+	return RFloat4(_mm_mul_ps(v, rhs.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::operator/(const RFloat4& rhs) const
+{
+	return RFloat4(_mm_div_ps(v, rhs.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::operator-() const
+{
+	return RFloat4(_mm_xor_ps(v, _mm_set1_ps(-0.0f)));
+}
+
+FORCEINLINE RFloat4 RFloat4::Min(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(_mm_min_ps(a.v, b.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::Max(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(_mm_max_ps(a.v, b.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::Abs(const RFloat4& a)
+{
+	return RFloat4(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::Sqrt(const RFloat4& a)
+{
+	return RFloat4(_mm_sqrt_ps(a.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::CompareLess(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(_mm_cmplt_ps(a.v, b.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::CompareGreater(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(_mm_cmpgt_ps(a.v, b.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::Select(const RFloat4& Mask, const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(_mm_or_ps(_mm_and_ps(Mask.v, a.v), _mm_andnot_ps(Mask.v, b.v)));
+}
+
+FORCEINLINE int RFloat4::GetMask() const
+{
+	return _mm_movemask_ps(v);
+}
+
+#elif RVEC3A_NEON
+
+FORCEINLINE RFloat4::RFloat4()
+	: v(vdupq_n_f32(0.0f))
+{
+}
+
+FORCEINLINE RFloat4 RFloat4::Replicate(float Value)
+{
+	return RFloat4(vdupq_n_f32(Value));
+}
+
+FORCEINLINE RFloat4 RFloat4::Load(const float* Data)
+{
+	return RFloat4(vld1q_f32(Data));
+}
+
+FORCEINLINE void RFloat4::Store(float* Data) const
+{
+	vst1q_f32(Data, v);
+}
+
+FORCEINLINE RFloat4 RFloat4::operator+(const RFloat4& rhs) const
+{
+	return RFloat4(vaddq_f32(v, rhs.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::operator-(const RFloat4& rhs) const
+{
+	return RFloat4(vsubq_f32(v, rhs.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::operator*(const RFloat4& rhs) const
+{
+	return RFloat4(vmulq_f32(v, rhs.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::operator/(const RFloat4& rhs) const
+{
+#if defined(__aarch64__)
+	return RFloat4(vdivq_f32(v, rhs.v));
+#else
+	float a[4], b[4];
+	vst1q_f32(a, v);
+	vst1q_f32(b, rhs.v);
+	for (int i = 0; i < 4; i++)
+	{
+		a[i] /= b[i];
+	}
+	return RFloat4(vld1q_f32(a));
+#endif
+}
+
+FORCEINLINE RFloat4 RFloat4::operator-() const
+{
+	return RFloat4(vnegq_f32(v));
+}
+
+FORCEINLINE RFloat4 RFloat4::Min(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(vbslq_f32(vcltq_f32(a.v, b.v), a.v, b.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::Max(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(vbslq_f32(vcgtq_f32(a.v, b.v), a.v, b.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::Abs(const RFloat4& a)
+{
+	return RFloat4(vabsq_f32(a.v));
+}
+
+FORCEINLINE RFloat4 RFloat4::Sqrt(const RFloat4& a)
+{
+#if defined(__aarch64__)
+	return RFloat4(vsqrtq_f32(a.v));
+#else
+	float Values[4];
+	vst1q_f32(Values, a.v);
+	for (int i = 0; i < 4; i++)
+	{
+		Values[i] = sqrtf(Values[i]);
+	}
+	return RFloat4(vld1q_f32(Values));
+#endif
+}
+
+FORCEINLINE RFloat4 RFloat4::CompareLess(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)));
+}
+
+FORCEINLINE RFloat4 RFloat4::CompareGreater(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v)));
+}
+
+FORCEINLINE RFloat4 RFloat4::Select(const RFloat4& Mask, const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(vbslq_f32(vreinterpretq_u32_f32(Mask.v), a.v, b.v));
+}
+
+FORCEINLINE int RFloat4::GetMask() const
+{
+	const uint32x4_t Signs = vshrq_n_u32(vreinterpretq_u32_f32(v), 31);
+	return vgetq_lane_u32(Signs, 0) | (vgetq_lane_u32(Signs, 1) << 1) | (vgetq_lane_u32(Signs, 2) << 2) | (vgetq_lane_u32(Signs, 3) << 3);
+}
+
+#else
+
+FORCEINLINE RFloat4::RFloat4()
+{
+	v[0] = v[1] = v[2] = v[3] = 0.0f;
+}
+
+FORCEINLINE RFloat4::RFloat4(float x, float y, float z, float w)
+{
+	v[0] = x; v[1] = y; v[2] = z; v[3] = w;
+}
+
+FORCEINLINE float RFloat4::MaskLane(bool bSet)
+{
+	const UINT32 Bits = bSet ? 0xFFFFFFFF : 0;
+	float Lane;
+	memcpy(&Lane, &Bits, sizeof(Lane));
+	return Lane;
+}
+
+FORCEINLINE RFloat4 RFloat4::Replicate(float Value)
+{
+	return RFloat4(Value, Value, Value, Value);
+}
+
+FORCEINLINE RFloat4 RFloat4::Load(const float* Data)
+{
+	return RFloat4(Data[0], Data[1], Data[2], Data[3]);
+}
+
+FORCEINLINE void RFloat4::Store(float* Data) const
+{
+	memcpy(Data, v, sizeof(v));
+}
+
+FORCEINLINE RFloat4 RFloat4::operator+(const RFloat4& rhs) const
+{
+	return RFloat4(v[0] + rhs.v[0], v[1] + rhs.v[1], v[2] + rhs.v[2], v[3] + rhs.v[3]);
+}
+
+FORCEINLINE RFloat4 RFloat4::operator-(const RFloat4& rhs) const
+{
+	return RFloat4(v[0] - rhs.v[0], v[1] - rhs.v[1], v[2] - rhs.v[2], v[3] - rhs.v[3]);
+}
+
+FORCEINLINE RFloat4 RFloat4::operator*(const RFloat4& rhs) const
+{
+	return RFloat4(v[0] * rhs.v[0], v[1] * rhs.v[1], v[2] * rhs.v[2], v[3] * rhs.v[3]);
+}
+
+FORCEINLINE RFloat4 RFloat4::operator/(const RFloat4& rhs) const
+{
+	return RFloat4(v[0] / rhs.v[0], v[1] / rhs.v[1], v[2] / rhs.v[2], v[3] / rhs.v[3]);
+}
+
+FORCEINLINE RFloat4 RFloat4::operator-() const
+{
+	return RFloat4(-v[0], -v[1], -v[2], -v[3]);
+}
+
+FORCEINLINE RFloat4 RFloat4::Min(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(Math::Min(a.v[0], b.v[0]), Math::Min(a.v[1], b.v[1]), Math::Min(a.v[2], b.v[2]), Math::Min(a.v[3], b.v[3]));
+}
+
+FORCEINLINE RFloat4 RFloat4::Max(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(Math::Max(a.v[0], b.v[0]), Math::Max(a.v[1], b.v[1]), Math::Max(a.v[2], b.v[2]), Math::Max(a.v[3], b.v[3]));
+}
+
+FORCEINLINE RFloat4 RFloat4::Abs(const RFloat4& a)
+{
+	return RFloat4(fabsf(a.v[0]), fabsf(a.v[1]), fabsf(a.v[2]), fabsf(a.v[3]));
+}
+
+FORCEINLINE RFloat4 RFloat4::Sqrt(const RFloat4& a)
+{
+	return RFloat4(sqrtf(a.v[0]), sqrtf(a.v[1]), sqrtf(a.v[2]), sqrtf(a.v[3]));
+}
+
+FORCEINLINE RFloat4 RFloat4::CompareLess(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(MaskLane(a.v[0] < b.v[0]), MaskLane(a.v[1] < b.v[1]), MaskLane(a.v[2] < b.v[2]), MaskLane(a.v[3] < b.v[3]));
+}
+
+FORCEINLINE RFloat4 RFloat4::CompareGreater(const RFloat4& a, const RFloat4& b)
+{
+	return RFloat4(MaskLane(a.v[0] > b.v[0]), MaskLane(a.v[1] > b.v[1]), MaskLane(a.v[2] > b.v[2]), MaskLane(a.v[3] > b.v[3]));
+}
+
+FORCEINLINE RFloat4 RFloat4::Select(const RFloat4& Mask, const RFloat4& a, const RFloat4& b)
+{
+	const int Bits = Mask.GetMask();
+	return RFloat4((Bits & 1) ? a.v[0] : b.v[0], (Bits & 2) ? a.v[1] : b.v[1], (Bits & 4) ? a.v[2] : b.v[2], (Bits & 8) ? a.v[3] : b.v[3]);
+}
+
+FORCEINLINE int RFloat4::GetMask() const
+{
+	int Mask = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		UINT32 Bits;
+		memcpy(&Bits, &v[i], sizeof(Bits));
+		Mask |= (Bits >> 31) << i;
+	}
+	return Mask;
+}
+
+#endif	// RVEC3A_SSE
@@ -8,18 +8,101 @@
 #include <assert.h>
 #include "Math.h"
 
+namespace
+{
+	// Ray-triangle intersection test with aligned vectors
+	bool TestIntersectionWithTriangleA(const RRay& Ray, const RVec3A TriPoints[3], const RVec3A& Normal, RayHitResult* result)
+	{
+		const RVec3A Origin(Ray.Origin);
+		const RVec3A EndPoint = Origin + RVec3A(Ray.Direction) * Ray.Distance;
+
+		float d0 = RVec3A::Dot(Normal, Origin);
+		float d1 = RVec3A::Dot(Normal, TriPoints[0]);
+		float d2 = d0 - d1;
+
+		if (d2 < 0)
+		{
+			return false;
+		}
+
+		if (RVec3A::Dot(EndPoint, Normal) - d1 > 0)
+		{
+			return false;
+		}
+
+		const RVec3A l = EndPoint - Origin;
+		float d3 = RVec3A::Dot(Normal, l);
+
+		// Ray is coplanar with the triangle, no intersections
+		if (FLT_EQUAL_ZERO(d3))
+		{
+			return false;
+		}
+
+		float df = -(d2 / d3);
+
+		const RVec3A cp = Origin + l * df;
+
+#if DEBUG_CHECK_NAN
+		if (cp.ToVec3().IsNan())
+		{
+			RLog("RRay::TestIntersectionWithTriangleAndFaceNormal() - Detected NaN in results:\n");
+			RLog("cp:%s, df:%f, d2:%f, d3: %f\n",
+				cp.ToVec3().ToString().c_str(), df, d2, d3);
+			RLog("p0:%s, p1:%s, p2:%s\n",
+				TriPoints[0].ToVec3().ToString().c_str(),
+				TriPoints[1].ToVec3().ToString().c_str(),
+				TriPoints[2].ToVec3().ToString().c_str());
+
+			DebugBreak();
+		}
+#endif	// DEBUG_CHECK_NAN
+
+		for (int i = 0; i < 3; i++)
+		{
+			const RVec3A edge = TriPoints[(i + 1) % 3] - TriPoints[i];
+			const RVec3A edge_normal = RVec3A::Cross(edge, Normal);
+
+			if (RVec3A::Dot(edge_normal, cp - TriPoints[i]) > 0)
+			{
+				return false;
+			}
+		}
+
+		if (result)
+		{
+			result->HitPosition = cp.ToVec3();
+			result->HitNormal = Normal.ToVec3();
+			result->Distance = (l * df).Magnitude();
+		}
+
+		return true;
+	}
+}
+
 RRay::RRay()
+	: ConeWidth(0.0f), ConeSpreadAngle(0.0f), DirectionSignMask(0)
 {
 }
 
 RRay::RRay(const RVec3& _origin, const RVec3& _dir, float _dist)
-	: Origin(_origin), Direction(_dir), Distance(_dist)
+	: Origin(_origin), Direction(_dir), Distance(_dist), ConeWidth(0.0f), ConeSpreadAngle(0.0f)
 {
+	PrecomputeDirectionData();
 }
 
 RRay::RRay(const RVec3& _start, const RVec3& _end)
-	: Origin(_start), Direction((_end - _start).GetNormalizedVec3()), Distance((_end - _start).Magnitude())
+	: Origin(_start), Direction((_end - _start).GetNormalizedVec3()), Distance((_end - _start).Magnitude()), ConeWidth(0.0f), ConeSpreadAngle(0.0f)
 {
+	PrecomputeDirectionData();
+}
+
+void RRay::PrecomputeDirectionData()
+{
+	// Zero components give infinities with the sign of zero, the slab test handles them without branches
+	InvDirection = RVec3A::Replicate(1.0f) / RVec3A(Direction);
+	DirectionSignMask = InvDirection.GetSignMask();
+	NegativeDirectionMask = RVec3A::CompareLess(InvDirection, RVec3A());
 }
 
 bool RRay::TestIntersectionWithSphere(const RVec3& SphereCenter, float SphereRadius, RayHitResult* result /*= nullptr*/) const
@@ -86,129 +169,42 @@ bool RRay::TestIntersectionWithPlane(const RVec3& PlaneNormal, const RVec3& Poin
 	return false;
 }
 
-bool RRay::TestIntersectionWithAabb(const RAabb& aabb, float* t/*=nullptr*/) const
+bool RRay::TestIntersectionWithAabb(const RAabb& aabb, float* OutEnter/*=nullptr*/, float* OutExit/*=nullptr*/) const
 {
 	assert(aabb.IsValid());
 
-    float tmin = -FLT_MAX, tmax = FLT_MAX;
-
-    if (!FLT_EQUAL_ZERO(Direction.x))
-    {
-		float inv_x = 1.0f / Direction.x;
-        float tx1 = (aabb.pMin.x - Origin.x) * inv_x;
-        float tx2 = (aabb.pMax.x - Origin.x) * inv_x;
-
-        tmin = Math::Max(tmin, Math::Min(tx1, tx2));
-        tmax = Math::Min(tmax, Math::Max(tx1, tx2));
-    }
-
-    if (!FLT_EQUAL_ZERO(Direction.y))
-    {
-		float inv_y = 1.0f / Direction.y;
-		float ty1 = (aabb.pMin.y - Origin.y) * inv_y;
-        float ty2 = (aabb.pMax.y - Origin.y) * inv_y;
-
-        tmin = Math::Max(tmin, Math::Min(ty1, ty2));
-        tmax = Math::Min(tmax, Math::Max(ty1, ty2));
-    }
-
-    if (!FLT_EQUAL_ZERO(Direction.z))
-    {
-		float inv_z = 1.0f / Direction.z;
-        float tz1 = (aabb.pMin.z - Origin.z) * inv_z;
-        float tz2 = (aabb.pMax.z - Origin.z) * inv_z;
-
-        tmin = Math::Max(tmin, Math::Min(tz1, tz2));
-        tmax = Math::Min(tmax, Math::Max(tz1, tz2));
-    }
-
-    if (tmax > tmin)
-    {
-		if (t)
-		{
-			*t = tmin;
-		}
-
-        return true;
-    }
-
-    return false;
+	return TestIntersectionWithAabb(RAabbA(aabb), OutEnter, OutExit);
 }
 
-bool RRay::TestIntersectionWithTriangle(const RVec3 TriPoints[3], RayHitResult* result /*= nullptr*/) const
+bool RRay::TestIntersectionWithAabb(const RAabbA& aabb, float* OutEnter/*=nullptr*/, float* OutExit/*=nullptr*/) const
 {
-	RVec3 p0p1 = TriPoints[1] - TriPoints[0];
-	RVec3 p0p2 = TriPoints[2] - TriPoints[0];
-	const RVec3 Normal = RVec3::Cross(p0p1, p0p2).GetNormalizedVec3();
-
-	return TestIntersectionWithTriangleAndFaceNormal(TriPoints, Normal, result);
-}
+	float tEnter, tExit;
+	const bool bIntersected = RVec3A::SlabTest(RVec3A(Origin), InvDirection, NegativeDirectionMask, aabb.pMin, aabb.pMax, 0.0f, Distance, tEnter, tExit);
 
-bool RRay::TestIntersectionWithTriangleAndFaceNormal(const RVec3 TriPoints[3], const RVec3& Normal, RayHitResult* result /*= nullptr*/) const
-{
-	RVec3 EndPoint = Origin + Direction * Distance;
-	const RVec3& Point = TriPoints[0];
-
-	float d0 = RVec3::Dot(Normal, Origin);
-	float d1 = RVec3::Dot(Normal, Point);
-	float d2 = d0 - d1;
-
-	if (d2 < 0)
+	if (OutEnter)
 	{
-		return false;
+		*OutEnter = tEnter;
 	}
 
-	if (RVec3::Dot(EndPoint, Normal) - d1 > 0)
+	if (OutExit)
 	{
-		return false;
+		*OutExit = tExit;
 	}
 
-	RVec3 l = EndPoint - Origin;
-	float d3 = RVec3::Dot(Normal, l);
-
-	// Ray is coplanar with the triangle, no intersections
-	if (FLT_EQUAL_ZERO(d3))
-	{
-		return false;
-	}
-
-	float df = -(d2 / d3);
-
-	RVec3 cp = Origin + l * df;
-
-#if DEBUG_CHECK_NAN
-	if (cp.IsNan())
-	{
-		RLog("RRay::TestIntersectionWithTriangleAndFaceNormal() - Detected NaN in results:\n");
-		RLog("cp:%s, df:%f, d2:%f, d3: %f\n",
-			cp.ToString().c_str(), df, d2, d3);
-		RLog("p0:%s, p1:%s, p2:%s\n",
-			TriPoints[0].ToString().c_str(),
-			TriPoints[1].ToString().c_str(),
-			TriPoints[2].ToString().c_str());
-
-		DebugBreak();
-	}
-#endif	// DEBUG_CHECK_NAN
+	return bIntersected;
+}
 
-	for (int i = 0; i < 3; i++)
-	{
-		RVec3 edge = TriPoints[(i + 1) % 3] - TriPoints[i];
-		RVec3 edge_normal = RVec3::Cross(edge, Normal);
+bool RRay::TestIntersectionWithTriangle(const RVec3 TriPoints[3], RayHitResult* result /*= nullptr*/) const
+{
+	const RVec3A Points[3] = { RVec3A(TriPoints[0]), RVec3A(TriPoints[1]), RVec3A(TriPoints[2]) };
+	const RVec3A Normal = RVec3A::Cross(Points[1] - Points[0], Points[2] - Points[0]).GetNormalized();
 
-		if (RVec3::Dot(edge_normal, cp - TriPoints[i]) > 0)
-		{
-			return false;
-		}
-	}
+	return TestIntersectionWithTriangleA(*this, Points, Normal, result);
+}
 
-	if (result)
-	{
-		result->HitPosition = cp;
-		result->HitNormal = Normal;
-		result->Distance = (l * df).Magnitude();
-	}
+bool RRay::TestIntersectionWithTriangleAndFaceNormal(const RVec3 TriPoints[3], const RVec3& Normal, RayHitResult* result /*= nullptr*/) const
+{
+	const RVec3A Points[3] = { RVec3A(TriPoints[0]), RVec3A(TriPoints[1]), RVec3A(TriPoints[2]) };
 
-	return true;
+	return TestIntersectionWithTriangleA(*this, Points, RVec3A(Normal), result);
 }
-
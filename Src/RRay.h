@@ -8,6 +8,9 @@
 
 #include "RVector.h"
 #include "RAabb.h"
+#include "RVec3A.h"
+
+class RTexture;
 
 // Ray hitting information
 struct RayHitResult
@@ -16,6 +19,8 @@ struct RayHitResult
 		: Distance(0.0f)
 		, SampledColor(1.0f, 1.0f, 1.0f)
 		, SampledAlpha(1.0f)
+		, Texture(nullptr)
+		, TextureLod(0.0f)
 	{
 	}
 
@@ -26,6 +31,12 @@ struct RayHitResult
 	// Color from texture
 	RVec3 SampledColor;
 	float SampledAlpha;
+
+	// Texture lookup of the hit, done when the hit is shaded so only nearest hits are sampled.
+	// Texture is null if the hit is not textured.
+	const RTexture* Texture;
+	RVec2 Texcoord;
+	float TextureLod;
 };
 
 class RRay
@@ -35,18 +46,33 @@ public:
 	RVec3 Direction;
 	float Distance;
 
+	// Ray cone for choosing texture mip levels. Width at origin and spread angle in radians, both zero if ray has no footprint.
+	float ConeWidth;
+	float ConeSpreadAngle;
+
+	// Reciprocal of direction and a mask of axes with negative direction, precomputed for box tests
+	RVec3A InvDirection;
+	RVec3A NegativeDirectionMask;
+
+	// Sign bits of direction packed in bit 0, 1 and 2 for x, y and z
+	int DirectionSignMask;
+
 	RRay();
 	RRay(const RVec3& _origin, const RVec3& _dir, float _dist);
 	RRay(const RVec3& _start, const RVec3& _end);
 
+	// Update precomputed direction data. Must be called after Direction is modified.
+	void PrecomputeDirectionData();
+
 	// Ray-sphere intersection test
 	bool TestIntersectionWithSphere(const RVec3& SphereCenter, float SphereRadius, RayHitResult* result = nullptr) const;
 
 	// Ray-plane intersection test
 	bool TestIntersectionWithPlane(const RVec3& PlaneNormal, const RVec3& PointOnPlane, RayHitResult* result = nullptr) const;
 
-	// Ray-aabb intersection test
-	bool TestIntersectionWithAabb(const RAabb& aabb, float* t = nullptr) const;
+	// Ray-aabb intersection test within [0, Distance]. Optionally outputs distances at which the ray enters and leaves the box.
+	bool TestIntersectionWithAabb(const RAabb& aabb, float* OutEnter = nullptr, float* OutExit = nullptr) const;
+	bool TestIntersectionWithAabb(const RAabbA& aabb, float* OutEnter = nullptr, float* OutExit = nullptr) const;
 
 	// Ray-triangle intersection test
 	bool TestIntersectionWithTriangle(const RVec3 TriPoints[3], RayHitResult* result = nullptr) const;
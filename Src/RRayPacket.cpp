@@ -0,0 +1,238 @@
+//=============================================================================
+// RRayPacket.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "RRayPacket.h"
+
+#include <assert.h>
+
+static_assert(RayPacketSize % 4 == 0, "Ray packets are processed four rays at a time");
+
+RRayPacket::RRayPacket(const RRay InRays[], int InNumRays)
+	: NumRays(InNumRays)
+	, bIntervalCulling(true)
+{
+	assert(NumRays > 0 && NumRays <= RayPacketSize);
+
+	for (int i = 0; i < RayPacketSize; i++)
+	{
+		// Unused lanes repeat the first ray, they are never selected by lane masks
+		const RRay& Ray = InRays[i < NumRays ? i : 0];
+		const RVec3 InvDirection = Ray.InvDirection.ToVec3();
+
+		Rays[i] = Ray;
+		OriginX[i] = Ray.Origin.x;
+		OriginY[i] = Ray.Origin.y;
+		OriginZ[i] = Ray.Origin.z;
+		DirectionX[i] = Ray.Direction.x;
+		DirectionY[i] = Ray.Direction.y;
+		DirectionZ[i] = Ray.Direction.z;
+		InvDirectionX[i] = InvDirection.x;
+		InvDirectionY[i] = InvDirection.y;
+		InvDirectionZ[i] = InvDirection.z;
+		Distance[i] = Ray.Distance;
+
+		if (i < NumRays)
+		{
+			// Interval bounds become NaN with infinite reciprocals
+			bIntervalCulling = bIntervalCulling &&
+				Ray.Origin == InRays[0].Origin &&
+				Ray.DirectionSignMask == InRays[0].DirectionSignMask &&
+				fabsf(InvDirection.x) < FLT_MAX && fabsf(InvDirection.y) < FLT_MAX && fabsf(InvDirection.z) < FLT_MAX;
+		}
+	}
+
+	CommonOrigin = RVec3A(Rays[0].Origin);
+	InvDirectionMin = Rays[0].InvDirection;
+	InvDirectionMax = Rays[0].InvDirection;
+	MaxDistance = Rays[0].Distance;
+
+	for (int i = 1; i < NumRays; i++)
+	{
+		InvDirectionMin = RVec3A::Min(InvDirectionMin, Rays[i].InvDirection);
+		InvDirectionMax = RVec3A::Max(InvDirectionMax, Rays[i].InvDirection);
+		MaxDistance = Math::Max(MaxDistance, Rays[i].Distance);
+	}
+}
+
+bool RRayPacket::IntervalMissesAabb(const RAabbA& aabb) const
+{
+	const RVec3A& NegativeMask = Rays[0].NegativeDirectionMask;
+	const RVec3A NearFaces = RVec3A::Select(NegativeMask, aabb.pMax, aabb.pMin);
+	const RVec3A FarFaces = RVec3A::Select(NegativeMask, aabb.pMin, aabb.pMax);
+
+	// Distances to a face are monotonic in reciprocal direction, so the bounds of all rays
+	// are found at the ends of the reciprocal direction interval
+	const RVec3A NearOffset = NearFaces - CommonOrigin;
+	const RVec3A FarOffset = FarFaces - CommonOrigin;
+	const RVec3A tNearMin = RVec3A::Min(NearOffset * InvDirectionMin, NearOffset * InvDirectionMax);
+	const RVec3A tFarMax = RVec3A::Max(FarOffset * InvDirectionMin, FarOffset * InvDirectionMax);
+
+	const float EnterMin = Math::Max(tNearMin.GetMaxComponent(), 0.0f);
+	const float ExitMax = Math::Min(tFarMax.GetMinComponent(), MaxDistance);
+
+	// No ray can leave the box later than it enters
+	return ExitMax <= EnterMin;
+}
+
+int RRayPacket::TestIntersectionWithAabb(const RAabbA& aabb, int LaneMask) const
+{
+	if (bIntervalCulling && IntervalMissesAabb(aabb))
+	{
+		return 0;
+	}
+
+	const RVec3 BoxMin = aabb.pMin.ToVec3();
+	const RVec3 BoxMax = aabb.pMax.ToVec3();
+	const RFloat4 Zero;
+
+	int HitMask = 0;
+
+	for (int Group = 0; Group < RayPacketSize; Group += 4)
+	{
+		if (((LaneMask >> Group) & 0xF) == 0)
+		{
+			continue;
+		}
+
+		const RFloat4 InvX = RFloat4::Load(&InvDirectionX[Group]);
+		const RFloat4 InvY = RFloat4::Load(&InvDirectionY[Group]);
+		const RFloat4 InvZ = RFloat4::Load(&InvDirectionZ[Group]);
+
+		const RFloat4 NegativeX = RFloat4::CompareLess(InvX, Zero);
+		const RFloat4 NegativeY = RFloat4::CompareLess(InvY, Zero);
+		const RFloat4 NegativeZ = RFloat4::CompareLess(InvZ, Zero);
+
+		const RFloat4 NearX = RFloat4::Select(NegativeX, RFloat4::Replicate(BoxMax.x), RFloat4::Replicate(BoxMin.x));
+		const RFloat4 NearY = RFloat4::Select(NegativeY, RFloat4::Replicate(BoxMax.y), RFloat4::Replicate(BoxMin.y));
+		const RFloat4 NearZ = RFloat4::Select(NegativeZ, RFloat4::Replicate(BoxMax.z), RFloat4::Replicate(BoxMin.z));
+		const RFloat4 FarX = RFloat4::Select(NegativeX, RFloat4::Replicate(BoxMin.x), RFloat4::Replicate(BoxMax.x));
+		const RFloat4 FarY = RFloat4::Select(NegativeY, RFloat4::Replicate(BoxMin.y), RFloat4::Replicate(BoxMax.y));
+		const RFloat4 FarZ = RFloat4::Select(NegativeZ, RFloat4::Replicate(BoxMin.z), RFloat4::Replicate(BoxMax.z));
+
+		const RFloat4 OriginXs = RFloat4::Load(&OriginX[Group]);
+		const RFloat4 OriginYs = RFloat4::Load(&OriginY[Group]);
+		const RFloat4 OriginZs = RFloat4::Load(&OriginZ[Group]);
+		const RFloat4 RangeMax = RFloat4::Load(&Distance[Group]);
+
+		// Same operations and order as RVec3A::SlabTest
+		const RFloat4 tNearX = RFloat4::Max((NearX - OriginXs) * InvX, Zero);
+		const RFloat4 tNearY = RFloat4::Max((NearY - OriginYs) * InvY, Zero);
+		const RFloat4 tNearZ = RFloat4::Max((NearZ - OriginZs) * InvZ, Zero);
+		const RFloat4 tFarX = RFloat4::Min((FarX - OriginXs) * InvX, RangeMax);
+		const RFloat4 tFarY = RFloat4::Min((FarY - OriginYs) * InvY, RangeMax);
+		const RFloat4 tFarZ = RFloat4::Min((FarZ - OriginZs) * InvZ, RangeMax);
+
+		const RFloat4 tEnter = RFloat4::Max(RFloat4::Max(tNearX, tNearY), tNearZ);
+		const RFloat4 tExit = RFloat4::Min(RFloat4::Min(tFarX, tFarY), tFarZ);
+
+		HitMask |= RFloat4::CompareGreater(tExit, tEnter).GetMask() << Group;
+	}
+
+	return HitMask & LaneMask;
+}
+
+int RRayPacket::TestIntersectionWithTriangle(const RVec3 TriPoints[3], int LaneMask, RayHitResult OutResults[]) const
+{
+	// Values shared by all rays are computed the same way as the single ray test
+	const RVec3A Points[3] = { RVec3A(TriPoints[0]), RVec3A(TriPoints[1]), RVec3A(TriPoints[2]) };
+	const RVec3A NormalA = RVec3A::Cross(Points[1] - Points[0], Points[2] - Points[0]).GetNormalized();
+	const RVec3 Normal = NormalA.ToVec3();
+	const RFloat4 d1 = RFloat4::Replicate(RVec3A::Dot(NormalA, Points[0]));
+
+	RVec3 EdgeNormals[3];
+	for (int i = 0; i < 3; i++)
+	{
+		EdgeNormals[i] = RVec3A::Cross(Points[(i + 1) % 3] - Points[i], NormalA).ToVec3();
+	}
+
+	const RFloat4 Nx = RFloat4::Replicate(Normal.x);
+	const RFloat4 Ny = RFloat4::Replicate(Normal.y);
+	const RFloat4 Nz = RFloat4::Replicate(Normal.z);
+	const RFloat4 Zero;
+
+	int HitMask = 0;
+
+	for (int Group = 0; Group < RayPacketSize; Group += 4)
+	{
+		const int GroupMask = (LaneMask >> Group) & 0xF;
+		if (GroupMask == 0)
+		{
+			continue;
+		}
+
+		const RFloat4 Ox = RFloat4::Load(&OriginX[Group]);
+		const RFloat4 Oy = RFloat4::Load(&OriginY[Group]);
+		const RFloat4 Oz = RFloat4::Load(&OriginZ[Group]);
+		const RFloat4 Dist = RFloat4::Load(&Distance[Group]);
+
+		const RFloat4 Ex = Ox + RFloat4::Load(&DirectionX[Group]) * Dist;
+		const RFloat4 Ey = Oy + RFloat4::Load(&DirectionY[Group]) * Dist;
+		const RFloat4 Ez = Oz + RFloat4::Load(&DirectionZ[Group]) * Dist;
+
+		// Ray starts behind the triangle or ends before reaching it
+		const RFloat4 d2 = ((Nx * Ox + Ny * Oy) + Nz * Oz) - d1;
+		int ValidMask = GroupMask & ~RFloat4::CompareLess(d2, Zero).GetMask();
+		ValidMask &= ~RFloat4::CompareGreater(((Ex * Nx + Ey * Ny) + Ez * Nz) - d1, Zero).GetMask();
+
+		const RFloat4 Lx = Ex - Ox;
+		const RFloat4 Ly = Ey - Oy;
+		const RFloat4 Lz = Ez - Oz;
+
+		// Ray is coplanar with the triangle, no intersections
+		const RFloat4 d3 = (Nx * Lx + Ny * Ly) + Nz * Lz;
+		ValidMask &= ~RFloat4::CompareLess(RFloat4::Abs(d3), RFloat4::Replicate(FLT_EPSILON)).GetMask();
+
+		if (ValidMask == 0)
+		{
+			continue;
+		}
+
+		const RFloat4 df = -(d2 / d3);
+		const RFloat4 Cx = Ox + Lx * df;
+		const RFloat4 Cy = Oy + Ly * df;
+		const RFloat4 Cz = Oz + Lz * df;
+
+		for (int i = 0; i < 3; i++)
+		{
+			const RFloat4 Px = RFloat4::Replicate(TriPoints[i].x);
+			const RFloat4 Py = RFloat4::Replicate(TriPoints[i].y);
+			const RFloat4 Pz = RFloat4::Replicate(TriPoints[i].z);
+			const RFloat4 EdgeDist = (RFloat4::Replicate(EdgeNormals[i].x) * (Cx - Px) + RFloat4::Replicate(EdgeNormals[i].y) * (Cy - Py)) + RFloat4::Replicate(EdgeNormals[i].z) * (Cz - Pz);
+
+			ValidMask &= ~RFloat4::CompareGreater(EdgeDist, Zero).GetMask();
+		}
+
+		if (ValidMask == 0)
+		{
+			continue;
+		}
+
+		const RFloat4 Tx = Lx * df;
+		const RFloat4 Ty = Ly * df;
+		const RFloat4 Tz = Lz * df;
+
+		alignas(16) float HitX[4], HitY[4], HitZ[4], HitDistance[4];
+		Cx.Store(HitX);
+		Cy.Store(HitY);
+		Cz.Store(HitZ);
+		RFloat4::Sqrt((Tx * Tx + Ty * Ty) + Tz * Tz).Store(HitDistance);
+
+		for (int i = 0; i < 4; i++)
+		{
+			if (ValidMask & (1 << i))
+			{
+				RayHitResult& Result = OutResults[Group + i];
+				Result.HitPosition = RVec3(HitX[i], HitY[i], HitZ[i]);
+				Result.HitNormal = Normal;
+				Result.Distance = HitDistance[i];
+			}
+		}
+
+		HitMask |= ValidMask << Group;
+	}
+
+	return HitMask;
+}
@@ -0,0 +1,112 @@
+//=============================================================================
+// RRayPacket.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "RFloat4.h"
+#include "RRay.h"
+
+// Number of rays traced together in a packet. Must be a multiple of 4.
+const int RayPacketSize = 8;
+
+// Mask with a bit set for every ray of a packet
+const int RayPacketFullMask = (1 << RayPacketSize) - 1;
+
+// Number of rays selected by a lane mask
+FORCEINLINE int CountLanes(int LaneMask)
+{
+	int Count = 0;
+	for (; LaneMask != 0; LaneMask &= LaneMask - 1)
+	{
+		Count++;
+	}
+
+	return Count;
+}
+
+// Coherent rays traced together. Rays are kept both as structures for single ray code
+// and as arrays of components for testing four of them at once.
+// Lanes are selected by bit masks, bit i stands for ray i.
+class alignas(16) RRayPacket
+{
+public:
+	// Build a packet from up to RayPacketSize rays
+	RRayPacket(const RRay InRays[], int InNumRays);
+
+	int GetNumRays() const;
+
+	// Mask of all valid lanes
+	int GetLaneMask() const;
+
+	const RRay& GetRay(int Lane) const;
+
+	// Shorten a ray after it hit something
+	void SetDistance(int Lane, float InDistance);
+
+	// Test selected rays against a box, clipped to each ray's [0, Distance]. Returns mask of rays that hit.
+	// Rays get the same results as RRay::TestIntersectionWithAabb.
+	int TestIntersectionWithAabb(const RAabbA& aabb, int LaneMask) const;
+
+	// Test selected rays against a triangle. Returns mask of rays that hit and fills their results.
+	// Rays get the same results as RRay::TestIntersectionWithTriangle.
+	int TestIntersectionWithTriangle(const RVec3 TriPoints[3], int LaneMask, RayHitResult OutResults[]) const;
+
+private:
+	// Whether every ray in the packet misses the box, tested with bounds of all directions at once
+	bool IntervalMissesAabb(const RAabbA& aabb) const;
+
+	RRay Rays[RayPacketSize];
+	int NumRays;
+
+	// Ray components by lane
+	alignas(16) float OriginX[RayPacketSize];
+	alignas(16) float OriginY[RayPacketSize];
+	alignas(16) float OriginZ[RayPacketSize];
+	alignas(16) float DirectionX[RayPacketSize];
+	alignas(16) float DirectionY[RayPacketSize];
+	alignas(16) float DirectionZ[RayPacketSize];
+	alignas(16) float InvDirectionX[RayPacketSize];
+	alignas(16) float InvDirectionY[RayPacketSize];
+	alignas(16) float InvDirectionZ[RayPacketSize];
+	alignas(16) float Distance[RayPacketSize];
+
+	// Rays share origin and direction signs, so the whole packet can be culled with interval bounds of reciprocal directions
+	bool bIntervalCulling;
+	RVec3A CommonOrigin;
+	RVec3A InvDirectionMin;
+	RVec3A InvDirectionMax;
+
+	// Longest distance of all rays
+	float MaxDistance;
+};
+
+
+FORCEINLINE int RRayPacket::GetNumRays() const
+{
+	return NumRays;
+}
+
+FORCEINLINE int RRayPacket::GetLaneMask() const
+{
+	return (1 << NumRays) - 1;
+}
+
+FORCEINLINE const RRay& RRayPacket::GetRay(int Lane) const
+{
+	return Rays[Lane];
+}
+
+FORCEINLINE void RRayPacket::SetDistance(int Lane, float InDistance)
+{
+	Rays[Lane].Distance = InDistance;
+	Distance[Lane] = InDistance;
+
+	MaxDistance = Distance[0];
+	for (int i = 1; i < NumRays; i++)
+	{
+		MaxDistance = Math::Max(MaxDistance, Distance[i]);
+	}
+}
@@ -0,0 +1,139 @@
+//=============================================================================
+// RTransform.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "RTransform.h"
+
+RTransform::RTransform()
+	: RTransform(RVec3(1, 0, 0), RVec3(0, 1, 0), RVec3(0, 0, 1), RVec3(0, 0, 0))
+{
+}
+
+RTransform::RTransform(const RVec3& XAxis, const RVec3& YAxis, const RVec3& ZAxis, const RVec3& Translation)
+{
+	const RVec3* Columns[] = { &XAxis, &YAxis, &ZAxis, &Translation };
+
+	for (int Col = 0; Col < 4; Col++)
+	{
+		m[0][Col] = Columns[Col]->x;
+		m[1][Col] = Columns[Col]->y;
+		m[2][Col] = Columns[Col]->z;
+	}
+}
+
+RTransform RTransform::MakeTranslation(const RVec3& Translation)
+{
+	return RTransform(RVec3(1, 0, 0), RVec3(0, 1, 0), RVec3(0, 0, 1), Translation);
+}
+
+RTransform RTransform::MakeScale(const RVec3& Scale)
+{
+	return RTransform(RVec3(Scale.x, 0, 0), RVec3(0, Scale.y, 0), RVec3(0, 0, Scale.z), RVec3(0, 0, 0));
+}
+
+RTransform RTransform::MakeRotation(const RVec3& Axis, float Angle)
+{
+	const RVec3 a = Axis.GetNormalizedVec3();
+	const float c = cosf(Angle);
+	const float s = sinf(Angle);
+	const float t = 1.0f - c;
+
+	// Rodrigues' rotation formula
+	return RTransform(
+		RVec3(t * a.x * a.x + c,		t * a.x * a.y + s * a.z,	t * a.x * a.z - s * a.y),
+		RVec3(t * a.x * a.y - s * a.z,	t * a.y * a.y + c,			t * a.y * a.z + s * a.x),
+		RVec3(t * a.x * a.z + s * a.y,	t * a.y * a.z - s * a.x,	t * a.z * a.z + c),
+		RVec3(0, 0, 0));
+}
+
+RTransform RTransform::operator*(const RTransform& rhs) const
+{
+	RTransform Result;
+
+	for (int Row = 0; Row < 3; Row++)
+	{
+		for (int Col = 0; Col < 4; Col++)
+		{
+			Result.m[Row][Col] = m[Row][0] * rhs.m[0][Col] + m[Row][1] * rhs.m[1][Col] + m[Row][2] * rhs.m[2][Col];
+		}
+
+		Result.m[Row][3] += m[Row][3];
+	}
+
+	return Result;
+}
+
+RAabb RTransform::TransformAabb(const RAabb& Aabb) const
+{
+	RAabb Result;
+
+	if (!Aabb.IsValid())
+	{
+		return Result;
+	}
+
+	for (int i = 0; i < 8; i++)
+	{
+		RVec3 Corner((i & 1) ? Aabb.pMax.x : Aabb.pMin.x,
+					 (i & 2) ? Aabb.pMax.y : Aabb.pMin.y,
+					 (i & 4) ? Aabb.pMax.z : Aabb.pMin.z);
+
+		Result.Expand(TransformPoint(Corner));
+	}
+
+	return Result;
+}
+
+RTransform RTransform::GetInverse() const
+{
+	// Inverse of the 3x3 part from cofactors
+	const float c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+	const float c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+	const float c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+
+	const float Det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+	if (Det == 0.0f)
+	{
+		RLog("Warning - RTransform: Inverting a singular transform\n");
+		return RTransform();
+	}
+
+	const float InvDet = 1.0f / Det;
+
+	RTransform Result;
+	Result.m[0][0] = c00 * InvDet;
+	Result.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * InvDet;
+	Result.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * InvDet;
+	Result.m[1][0] = c01 * InvDet;
+	Result.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * InvDet;
+	Result.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * InvDet;
+	Result.m[2][0] = c02 * InvDet;
+	Result.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * InvDet;
+	Result.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * InvDet;
+
+	// Translation is -R^-1 * t
+	for (int Row = 0; Row < 3; Row++)
+	{
+		Result.m[Row][3] = -(Result.m[Row][0] * m[0][3] + Result.m[Row][1] * m[1][3] + Result.m[Row][2] * m[2][3]);
+	}
+
+	return Result;
+}
+
+bool RTransform::IsIdentity() const
+{
+	for (int Row = 0; Row < 3; Row++)
+	{
+		for (int Col = 0; Col < 4; Col++)
+		{
+			if (m[Row][Col] != (Row == Col ? 1.0f : 0.0f))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
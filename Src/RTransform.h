@@ -0,0 +1,70 @@
+//=============================================================================
+// RTransform.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "Platform.h"
+#include "RVector.h"
+#include "RAabb.h"
+
+// Affine transform stored as a 3x4 matrix. Columns 0-2 are rotation and scale, column 3 is translation.
+// Points are transformed as column vectors: p' = M * p
+class RTransform
+{
+public:
+	float m[3][4];
+
+	// Identity transform
+	RTransform();
+
+	RTransform(const RVec3& XAxis, const RVec3& YAxis, const RVec3& ZAxis, const RVec3& Translation);
+
+	static RTransform MakeTranslation(const RVec3& Translation);
+	static RTransform MakeScale(const RVec3& Scale);
+
+	// Rotate around an axis by angle in radians
+	static RTransform MakeRotation(const RVec3& Axis, float Angle);
+
+	// Combined transform which applies rhs first
+	RTransform operator*(const RTransform& rhs) const;
+
+	RVec3 TransformPoint(const RVec3& p) const;
+
+	// Transform a direction, ignoring translation
+	RVec3 TransformVector(const RVec3& v) const;
+
+	// Transform a direction with transpose of the 3x3 part. Used with inverse transforms for normals.
+	RVec3 TransformVectorTransposed(const RVec3& v) const;
+
+	// Bounds of all corners of an aabb after transform
+	RAabb TransformAabb(const RAabb& Aabb) const;
+
+	RTransform GetInverse() const;
+
+	bool IsIdentity() const;
+};
+
+
+FORCEINLINE RVec3 RTransform::TransformPoint(const RVec3& p) const
+{
+	return RVec3(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+				 m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+				 m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+}
+
+FORCEINLINE RVec3 RTransform::TransformVector(const RVec3& v) const
+{
+	return RVec3(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+				 m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+				 m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+}
+
+FORCEINLINE RVec3 RTransform::TransformVectorTransposed(const RVec3& v) const
+{
+	return RVec3(m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+				 m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+				 m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z);
+}
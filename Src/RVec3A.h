@@ -0,0 +1,553 @@
+//=============================================================================
+// RVec3A.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "Platform.h"
+#include "RVector.h"
+
+#include <float.h>
+#include <math.h>
+
+// Use SSE or NEON intrinsics for RVec3A. Falls back to scalar code when disabled or neither is available.
+#define USE_SIMD_VECTOR 1
+
+#if USE_SIMD_VECTOR && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RVEC3A_SSE 1
+#include <emmintrin.h>
+#elif USE_SIMD_VECTOR && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define RVEC3A_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifndef RVEC3A_SSE
+#define RVEC3A_SSE 0
+#endif
+
+#ifndef RVEC3A_NEON
+#define RVEC3A_NEON 0
+#endif
+
+// 3d vector stored in a 16-byte aligned register. The fourth lane is padding and ignored by horizontal operations.
+class alignas(16) RVec3A
+{
+public:
+	RVec3A();
+	RVec3A(float x, float y, float z);
+	explicit RVec3A(const RVec3& v);
+
+	// Vector with all components set to the same value
+	static RVec3A Replicate(float Value);
+
+	float GetX() const;
+	float GetY() const;
+	float GetZ() const;
+
+	RVec3 ToVec3() const;
+
+	RVec3A operator-() const;
+
+	RVec3A operator+(const RVec3A& rhs) const;
+	RVec3A operator-(const RVec3A& rhs) const;
+	RVec3A operator*(const RVec3A& rhs) const;
+	RVec3A operator/(const RVec3A& rhs) const;
+	RVec3A operator*(float val) const;
+
+	// Dot product
+	static float Dot(const RVec3A& a, const RVec3A& b);
+
+	// Cross product
+	static RVec3A Cross(const RVec3A& a, const RVec3A& b);
+
+	// Per component min and max. Same as Math::Min and Math::Max, b is returned when either component is NaN.
+	static RVec3A Min(const RVec3A& a, const RVec3A& b);
+	static RVec3A Max(const RVec3A& a, const RVec3A& b);
+
+	// Per component absolute value
+	static RVec3A Abs(const RVec3A& a);
+
+	// Approximate reciprocal square root of each component, refined with a Newton-Raphson step
+	static RVec3A Rsqrt(const RVec3A& a);
+
+	// Per component a < b, components of the result are all bits set when true
+	static RVec3A CompareLess(const RVec3A& a, const RVec3A& b);
+
+	// Pick components from a where mask is set and from b elsewhere
+	static RVec3A Select(const RVec3A& Mask, const RVec3A& a, const RVec3A& b);
+
+	// Sign bits of x, y and z packed in bit 0, 1 and 2
+	int GetSignMask() const;
+
+	// Largest and smallest of x, y and z
+	float GetMaxComponent() const;
+	float GetMinComponent() const;
+
+	float SquaredMagnitude() const;
+	float Magnitude() const;
+
+	// Same results as RVec3::GetNormalizedVec3
+	RVec3A GetNormalized() const;
+
+	// Branchless test of a ray against the slabs of a box, clipped to range [RangeMin, RangeMax].
+	// NegativeMask selects axes the ray points to negative direction. Slabs giving NaN distances don't limit the range.
+	// Outputs distances at which the ray enters and leaves the box.
+	static bool SlabTest(const RVec3A& Origin, const RVec3A& InvDirection, const RVec3A& NegativeMask, const RVec3A& BoxMin, const RVec3A& BoxMax,
+						 float RangeMin, float RangeMax, float& OutEnter, float& OutExit);
+
+private:
+#if RVEC3A_SSE
+	explicit RVec3A(__m128 InV) : v(InV) {}
+
+	__m128 v;
+#elif RVEC3A_NEON
+	explicit RVec3A(float32x4_t InV) : v(InV) {}
+
+	float32x4_t v;
+#else
+	float x, y, z, w;
+#endif
+};
+
+#if RVEC3A_SSE
+
+FORCEINLINE RVec3A::RVec3A()
+	: v(_mm_setzero_ps())
+{
+}
+
+FORCEINLINE RVec3A::RVec3A(float x, float y, float z)
+	: v(_mm_setr_ps(x, y, z, 0.0f))
+{
+}
+
+FORCEINLINE RVec3A::RVec3A(const RVec3& v)
+	: v(_mm_setr_ps(v.x, v.y, v.z, 0.0f))
+{
+}
+
+FORCEINLINE RVec3A RVec3A::Replicate(float Value)
+{
+	return RVec3A(_mm_set1_ps(Value));
+}
+
+FORCEINLINE float RVec3A::GetX() const
+{
+	return _mm_cvtss_f32(v);
+}
+
+FORCEINLINE float RVec3A::GetY() const
+{
+	return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+}
+
+FORCEINLINE float RVec3A::GetZ() const
+{
+	return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)));
+}
+
+FORCEINLINE RVec3A RVec3A::operator-() const
+{
+	return RVec3A(_mm_xor_ps(v, _mm_set1_ps(-0.0f)));
+}
+
+FORCEINLINE RVec3A RVec3A::operator+(const RVec3A& rhs) const
+{
+	return RVec3A(_mm_add_ps(v, rhs.v));
+}
+
+FORCEINLINE RVec3A RVec3A::operator-(const RVec3A& rhs) const
+{
+	return RVec3A(_mm_sub_ps(v, rhs.v));
+}
+
+FORCEINLINE RVec3A RVec3A::operator*(const RVec3A& rhs) const
+{
+	return RVec3A(_mm_mul_ps(v, rhs.v));
+}
+
+FORCEINLINE RVec3A RVec3A::operator/(const RVec3A& rhs) const
+{
+	return RVec3A(_mm_div_ps(v, rhs.v));
+}
+
+FORCEINLINE RVec3A RVec3A::operator*(float val) const
+{
+	return RVec3A(_mm_mul_ps(v, _mm_set1_ps(val)));
+}
+
+FORCEINLINE float RVec3A::Dot(const RVec3A& a, const RVec3A& b)
+{
+	// Summed in the same order as RVec3::Dot
+	const __m128 m = _mm_mul_ps(a.v, b.v);
+	const __m128 xy = _mm_add_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(_mm_add_ss(xy, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+FORCEINLINE RVec3A RVec3A::Cross(const RVec3A& a, const RVec3A& b)
+{
+	const __m128 a_yzx = _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 b_yzx = _mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 a_zxy = _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 1, 0, 2));
+	const __m128 b_zxy = _mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(3, 1, 0, 2));
+	return RVec3A(_mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy), _mm_mul_ps(a_zxy, b_yzx)));
+}
+
+FORCEINLINE RVec3A RVec3A::Min(const RVec3A& a, const RVec3A& b)
+{
+	return RVec3A(_mm_min_ps(a.v, b.v));
+}
+
+FORCEINLINE RVec3A RVec3A::Max(const RVec3A& a, const RVec3A& b)
+{
+	return RVec3A(_mm_max_ps(a.v, b.v));
+}
+
+FORCEINLINE RVec3A RVec3A::Abs(const RVec3A& a)
+{
+	return RVec3A(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v));
+}
+
+FORCEINLINE RVec3A RVec3A::Rsqrt(const RVec3A& a)
+{
+	const __m128 r = _mm_rsqrt_ps(a.v);
+	const __m128 HalfA_rr = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), a.v), _mm_mul_ps(r, r));
+	return RVec3A(_mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), HalfA_rr)));
+}
+
+FORCEINLINE RVec3A RVec3A::CompareLess(const RVec3A& a, const RVec3A& b)
+{
+	return RVec3A(_mm_cmplt_ps(a.v, b.v));
+}
+
+FORCEINLINE RVec3A RVec3A::Select(const RVec3A& Mask, const RVec3A& a, const RVec3A& b)
+{
+	return RVec3A(_mm_or_ps(_mm_and_ps(Mask.v, a.v), _mm_andnot_ps(Mask.v, b.v)));
+}
+
+FORCEINLINE int RVec3A::GetSignMask() const
+{
+	return _mm_movemask_ps(v) & 7;
+}
+
+FORCEINLINE float RVec3A::GetMaxComponent() const
+{
+	const __m128 xy = _mm_max_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(_mm_max_ss(xy, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+FORCEINLINE float RVec3A::GetMinComponent() const
+{
+	const __m128 xy = _mm_min_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(_mm_min_ss(xy, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+#elif RVEC3A_NEON
+
+FORCEINLINE RVec3A::RVec3A()
+	: v(vdupq_n_f32(0.0f))
+{
+}
+
+FORCEINLINE RVec3A::RVec3A(float x, float y, float z)
+{
+	const float Values[4] = { x, y, z, 0.0f };
+	v = vld1q_f32(Values);
+}
+
+FORCEINLINE RVec3A::RVec3A(const RVec3& InV)
+{
+	const float Values[4] = { InV.x, InV.y, InV.z, 0.0f };
+	v = vld1q_f32(Values);
+}
+
+FORCEINLINE RVec3A RVec3A::Replicate(float Value)
+{
+	return RVec3A(vdupq_n_f32(Value));
+}
+
+FORCEINLINE float RVec3A::GetX() const
+{
+	return vgetq_lane_f32(v, 0);
+}
+
+FORCEINLINE float RVec3A::GetY() const
+{
+	return vgetq_lane_f32(v, 1);
+}
+
+FORCEINLINE float RVec3A::GetZ() const
+{
+	return vgetq_lane_f32(v, 2);
+}
+
+FORCEINLINE RVec3A RVec3A::operator-() const
+{
+	return RVec3A(vnegq_f32(v));
+}
+
+FORCEINLINE RVec3A RVec3A::operator+(const RVec3A& rhs) const
+{
+	return RVec3A(vaddq_f32(v, rhs.v));
+}
+
+FORCEINLINE RVec3A RVec3A::operator-(const RVec3A& rhs) const
+{
+	return RVec3A(vsubq_f32(v, rhs.v));
+}
+
+FORCEINLINE RVec3A RVec3A::operator*(const RVec3A& rhs) const
+{
+	return RVec3A(vmulq_f32(v, rhs.v));
+}
+
+FORCEINLINE RVec3A RVec3A::operator/(const RVec3A& rhs) const
+{
+#if defined(__aarch64__)
+	return RVec3A(vdivq_f32(v, rhs.v));
+#else
+	return RVec3A(GetX() / rhs.GetX(), GetY() / rhs.GetY(), GetZ() / rhs.GetZ());
+#endif
+}
+
+FORCEINLINE RVec3A RVec3A::operator*(float val) const
+{
+	return RVec3A(vmulq_n_f32(v, val));
+}
+
+FORCEINLINE float RVec3A::Dot(const RVec3A& a, const RVec3A& b)
+{
+	// Summed in the same order as RVec3::Dot
+	const float32x4_t m = vmulq_f32(a.v, b.v);
+	return (vgetq_lane_f32(m, 0) + vgetq_lane_f32(m, 1)) + vgetq_lane_f32(m, 2);
+}
+
+FORCEINLINE RVec3A RVec3A::Cross(const RVec3A& a, const RVec3A& b)
+{
+	// Rotate x, y and z lanes, the padding lane is don't care
+	const float32x4_t a_yzx = vsetq_lane_f32(vgetq_lane_f32(a.v, 0), vextq_f32(a.v, a.v, 1), 2);
+	const float32x4_t b_yzx = vsetq_lane_f32(vgetq_lane_f32(b.v, 0), vextq_f32(b.v, b.v, 1), 2);
+	const float32x4_t a_zxy = vsetq_lane_f32(vgetq_lane_f32(a_yzx, 0), vextq_f32(a_yzx, a_yzx, 1), 2);
+	const float32x4_t b_zxy = vsetq_lane_f32(vgetq_lane_f32(b_yzx, 0), vextq_f32(b_yzx, b_yzx, 1), 2);
+	return RVec3A(vsubq_f32(vmulq_f32(a_yzx, b_zxy), vmulq_f32(a_zxy, b_yzx)));
+}
+
+FORCEINLINE RVec3A RVec3A::Min(const RVec3A& a, const RVec3A& b)
+{
+	// vminq_f32 propagates NaN, compare and select to match SSE
+	return RVec3A(vbslq_f32(vcltq_f32(a.v, b.v), a.v, b.v));
+}
+
+FORCEINLINE RVec3A RVec3A::Max(const RVec3A& a, const RVec3A& b)
+{
+	return RVec3A(vbslq_f32(vcgtq_f32(a.v, b.v), a.v, b.v));
+}
+
+FORCEINLINE RVec3A RVec3A::Abs(const RVec3A& a)
+{
+	return RVec3A(vabsq_f32(a.v));
+}
+
+FORCEINLINE RVec3A RVec3A::Rsqrt(const RVec3A& a)
+{
+	const float32x4_t r = vrsqrteq_f32(a.v);
+	return RVec3A(vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r)));
+}
+
+FORCEINLINE RVec3A RVec3A::CompareLess(const RVec3A& a, const RVec3A& b)
+{
+	return RVec3A(vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)));
+}
+
+FORCEINLINE RVec3A RVec3A::Select(const RVec3A& Mask, const RVec3A& a, const RVec3A& b)
+{
+	return RVec3A(vbslq_f32(vreinterpretq_u32_f32(Mask.v), a.v, b.v));
+}
+
+FORCEINLINE int RVec3A::GetSignMask() const
+{
+	const uint32x4_t Signs = vshrq_n_u32(vreinterpretq_u32_f32(v), 31);
+	return vgetq_lane_u32(Signs, 0) | (vgetq_lane_u32(Signs, 1) << 1) | (vgetq_lane_u32(Signs, 2) << 2);
+}
+
+FORCEINLINE float RVec3A::GetMaxComponent() const
+{
+	const float xy = Math::Max(vgetq_lane_f32(v, 0), vgetq_lane_f32(v, 1));
+	return Math::Max(xy, vgetq_lane_f32(v, 2));
+}
+
+FORCEINLINE float RVec3A::GetMinComponent() const
+{
+	const float xy = Math::Min(vgetq_lane_f32(v, 0), vgetq_lane_f32(v, 1));
+	return Math::Min(xy, vgetq_lane_f32(v, 2));
+}
+
+#else
+
+FORCEINLINE RVec3A::RVec3A()
+	: x(0.0f), y(0.0f), z(0.0f), w(0.0f)
+{
+}
+
+FORCEINLINE RVec3A::RVec3A(float _x, float _y, float _z)
+	: x(_x), y(_y), z(_z), w(0.0f)
+{
+}
+
+FORCEINLINE RVec3A::RVec3A(const RVec3& v)
+	: x(v.x), y(v.y), z(v.z), w(0.0f)
+{
+}
+
+FORCEINLINE RVec3A RVec3A::Replicate(float Value)
+{
+	return RVec3A(Value, Value, Value);
+}
+
+FORCEINLINE float RVec3A::GetX() const
+{
+	return x;
+}
+
+FORCEINLINE float RVec3A::GetY() const
+{
+	return y;
+}
+
+FORCEINLINE float RVec3A::GetZ() const
+{
+	return z;
+}
+
+FORCEINLINE RVec3A RVec3A::operator-() const
+{
+	return RVec3A(-x, -y, -z);
+}
+
+FORCEINLINE RVec3A RVec3A::operator+(const RVec3A& rhs) const
+{
+	return RVec3A(x + rhs.x, y + rhs.y, z + rhs.z);
+}
+
+FORCEINLINE RVec3A RVec3A::operator-(const RVec3A& rhs) const
+{
+	return RVec3A(x - rhs.x, y - rhs.y, z - rhs.z);
+}
+
+FORCEINLINE RVec3A RVec3A::operator*(const RVec3A& rhs) const
+{
+	return RVec3A(x * rhs.x, y * rhs.y, z * rhs.z);
+}
+
+FORCEINLINE RVec3A RVec3A::operator/(const RVec3A& rhs) const
+{
+	return RVec3A(x / rhs.x, y / rhs.y, z / rhs.z);
+}
+
+FORCEINLINE RVec3A RVec3A::operator*(float val) const
+{
+	return RVec3A(x * val, y * val, z * val);
+}
+
+FORCEINLINE float RVec3A::Dot(const RVec3A& a, const RVec3A& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+FORCEINLINE RVec3A RVec3A::Cross(const RVec3A& a, const RVec3A& b)
+{
+	return RVec3A(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+FORCEINLINE RVec3A RVec3A::Min(const RVec3A& a, const RVec3A& b)
+{
+	return RVec3A(Math::Min(a.x, b.x), Math::Min(a.y, b.y), Math::Min(a.z, b.z));
+}
+
+FORCEINLINE RVec3A RVec3A::Max(const RVec3A& a, const RVec3A& b)
+{
+	return RVec3A(Math::Max(a.x, b.x), Math::Max(a.y, b.y), Math::Max(a.z, b.z));
+}
+
+FORCEINLINE RVec3A RVec3A::Abs(const RVec3A& a)
+{
+	return RVec3A(fabsf(a.x), fabsf(a.y), fabsf(a.z));
+}
+
+FORCEINLINE RVec3A RVec3A::Rsqrt(const RVec3A& a)
+{
+	return RVec3A(1.0f / sqrtf(a.x), 1.0f / sqrtf(a.y), 1.0f / sqrtf(a.z));
+}
+
+FORCEINLINE RVec3A RVec3A::CompareLess(const RVec3A& a, const RVec3A& b)
+{
+	// Any non-zero value works as a mask for the scalar Select
+	return RVec3A(a.x < b.x ? 1.0f : 0.0f, a.y < b.y ? 1.0f : 0.0f, a.z < b.z ? 1.0f : 0.0f);
+}
+
+FORCEINLINE RVec3A RVec3A::Select(const RVec3A& Mask, const RVec3A& a, const RVec3A& b)
+{
+	return RVec3A(Mask.x != 0.0f ? a.x : b.x, Mask.y != 0.0f ? a.y : b.y, Mask.z != 0.0f ? a.z : b.z);
+}
+
+FORCEINLINE int RVec3A::GetSignMask() const
+{
+	return (signbit(x) ? 1 : 0) | (signbit(y) ? 2 : 0) | (signbit(z) ? 4 : 0);
+}
+
+FORCEINLINE float RVec3A::GetMaxComponent() const
+{
+	return Math::Max(Math::Max(x, y), z);
+}
+
+FORCEINLINE float RVec3A::GetMinComponent() const
+{
+	return Math::Min(Math::Min(x, y), z);
+}
+
+#endif	// RVEC3A_SSE
+
+FORCEINLINE RVec3 RVec3A::ToVec3() const
+{
+	return RVec3(GetX(), GetY(), GetZ());
+}
+
+FORCEINLINE float RVec3A::SquaredMagnitude() const
+{
+	return Dot(*this, *this);
+}
+
+FORCEINLINE float RVec3A::Magnitude() const
+{
+	return sqrtf(SquaredMagnitude());
+}
+
+FORCEINLINE RVec3A RVec3A::GetNormalized() const
+{
+	const float SquaredMag = SquaredMagnitude();
+	if (!FLT_EQUAL_ZERO(SquaredMag))
+	{
+		return *this * (1.0f / sqrtf(SquaredMag));
+	}
+
+	return *this;
+}
+
+FORCEINLINE bool RVec3A::SlabTest(const RVec3A& Origin, const RVec3A& InvDirection, const RVec3A& NegativeMask, const RVec3A& BoxMin, const RVec3A& BoxMax,
+									 float RangeMin, float RangeMax, float& OutEnter, float& OutExit)
+{
+	// Pick near and far faces by direction sign instead of sorting distances
+	const RVec3A NearFaces = Select(NegativeMask, BoxMax, BoxMin);
+	const RVec3A FarFaces = Select(NegativeMask, BoxMin, BoxMax);
+
+	// Max and Min return the range limit for NaN distances, which come from rays parallel to and lying on a slab plane
+	const RVec3A tNear = Max((NearFaces - Origin) * InvDirection, Replicate(RangeMin));
+	const RVec3A tFar = Min((FarFaces - Origin) * InvDirection, Replicate(RangeMax));
+
+	OutEnter = tNear.GetMaxComponent();
+	OutExit = tFar.GetMinComponent();
+
+	return OutExit > OutEnter;
+}
@@ -30,16 +30,6 @@ public:
 		: x(v[0]), y(v[1])
 	{}
 
-	RVec2(const RVec2& rhs)
-		: x(rhs.x), y(rhs.y)
-	{}
-
-	RVec2& operator=(const RVec2& rhs)
-	{
-		x = rhs.x; y = rhs.y;
-		return *this;
-	}
-
 	RVec2 operator-() const											{ return RVec2(-x, -y); }
 
 	RVec2 operator+(const RVec2& rhs) const							{ return RVec2(x + rhs.x, y + rhs.y); }
@@ -111,16 +101,6 @@ public:
 		: x(v[0]), y(v[1]), z(v[2])
 	{}
 
-	RVec3(const RVec3& rhs)
-		: x(rhs.x), y(rhs.y), z(rhs.z)
-	{}
-
-	RVec3& operator=(const RVec3& rhs)
-	{
-		x = rhs.x; y = rhs.y; z = rhs.z;
-		return *this;
-	}
-
 	RVec3 operator-() const											{ return RVec3(-x, -y, -z); }
 
 	RVec3 operator+(const RVec3& rhs) const							{ return RVec3(x + rhs.x, y + rhs.y, z + rhs.z); }
@@ -249,20 +229,11 @@ public:
 		: x(v[0]), y(v[1]), z(v[2]), w(v[3])
 	{}
 
-	RVec4(const RVec4& rhs)
-		: x(rhs.x), y(rhs.y), z(rhs.z), w(rhs.w)
-	{}
-
 	RVec4(const RVec3 v, float _w = 1.0f)
 		: x(v.x), y(v.y), z(v.z), w(_w)
 	{}
 
-	RVec4& operator=(const RVec4& rhs)
-	{
-		x = rhs.x; y = rhs.y; z = rhs.z; w = rhs.w;
-		return *this;
-	}
-
+	RVec4 operator+(const RVec4& rhs) const							{ return RVec4(x + rhs.x, y + rhs.y, z + rhs.z, w + rhs.w); }
 	RVec4 operator*(float val) const								{ return RVec4(x * val, y * val, z * val, w * val); }
 	RVec4 operator/(float val) const								{ return RVec4(x / val, y / val, z / val, w / val); }
 
@@ -12,11 +12,9 @@
 
 #include "Math.h"
 #include "ColorBuffer.h"
-#include "Shapes.h"
-#include "MeshShape.h"
-#include "RayTracerScene.h"
+#include "Profiler.h"
+#include "SceneSetup.h"
 
-#include "ThreadTaskQueue.h"
 #include "ThreadUtils.h"
 
 #include <vector>
@@ -32,212 +30,13 @@
 #define GetCurrentDir getcwd
 #endif
 
-template<typename T, typename ...Args>
-std::unique_ptr<T> MakeUnique(Args&&... args)
-{
-    return std::move(std::unique_ptr<T>(new T(std::forward<Args>(args)...)));
-}
-
 RayTracerProgram* RayTracerProgram::CurrentInstance = nullptr;
 
-// Whether to enable 2x2 antialiasing for pixel sampling
-#define ENABLE_ANTIALIASING 1
-
 // Number of times each pixel is sampled
 static const int TotalSamplesNum = 500;
 
-Pixel bitcolor[bitmapWidth * bitmapHeight];
-
-struct AccumulatePixel
-{
-	AccumulatePixel()
-		: AccumulatedColor(0, 0, 0), Num(0)
-	{}
-
-	void AddPixel(RVec3 Color)
-	{
-		AccumulatedColor += Color;
-		Num++;
-	}
-
-	Pixel GetPixel() const
-	{
-		return MakePixelColor(AccumulatedColor / (float)Num);
-	}
-
-	Pixel GetGammaSpacePixel() const
-	{
-		return MakePixelColor(LinearToGamma(AccumulatedColor / (float)Num));
-	}
-
-	RVec3 AccumulatedColor;
-	int Num;
-};
-
-AccumulatePixel accuBuffer[bitmapWidth * bitmapHeight];
-
-struct RenderThreadTask
-{
-	RenderThreadTask()
-	{
-	}
-
-	RenderThreadTask(int InStart, int InEnd, const RenderOption& InOption)
-		: Start(InStart)
-		, End(InEnd)
-		, Option(InOption)
-	{
-	}
-
-	int Start;
-	int End;
-	RenderOption Option;
-};
-
-typedef ThreadTaskQueue<RenderThreadTask> RenderThreadTaskQueue;
-
-//////////////////////////////////////////////////////////////////////////
-// Log thread - Begin
-//////////////////////////////////////////////////////////////////////////
-
-const auto ProgramStartTime = std::chrono::system_clock::now();
-
-int GetTimeInMillisecond()
-{
-	auto CurrentTime = std::chrono::system_clock::now();
-	return (int)std::chrono::duration_cast<std::chrono::milliseconds>(CurrentTime - ProgramStartTime).count();
-}
-
-void DisplayThreadAndTime()
-{
-	std::thread::id this_id = std::this_thread::get_id();
-	std::stringstream ss;
-	ss << this_id;
-	const std::string ThreadName = ss.str();
-
-	RLog("[Thread: %s][%d] ", ThreadName.c_str(), GetTimeInMillisecond());
-}
-
-#if 0
-#define RLogThread(...)			{ DisplayThreadAndTime(); RLog(__VA_ARGS__); }
-#else
-#define RLogThread(...)
-#endif
-
-//////////////////////////////////////////////////////////////////////////
-// Log thread - End
-//////////////////////////////////////////////////////////////////////////
-
-void ThreadWorker_Render(int begin, int end, int MaxBounceCount, const RenderOption& InOption = RenderOption())
-{
-	const RVec3 ViewPoint(0, 0, 7.0f);
-	const RayTracerScene* Scene = RayTracerProgram::GetActiveInstance().GetScene();
-	const float Aspect = (float)bitmapWidth / (float)bitmapHeight;
-
-	for (int PixelIndex = begin; PixelIndex <= end; PixelIndex++)
-	{
-		int x, y;
-		BufferIndexToCoord(PixelIndex, x, y);
-		float dx = -(float)(x - bitmapWidth / 2) / (bitmapWidth * 2) * Aspect;
-		float dy = -(float)(y - bitmapHeight / 2) / (bitmapHeight * 2);
-
-		RVec3 c = RVec3::Zero();
-
-#if ENABLE_ANTIALIASING
-		static const float inv_pixel_radius = 1.0f / (bitmapWidth * 4);
-
-		static const float ox[4] = { 0.0f, inv_pixel_radius, 0.0f, inv_pixel_radius };
-		static const float oy[4] = { 0.0f, 0.0f, inv_pixel_radius, inv_pixel_radius };
-
-		static const float offset_radius = inv_pixel_radius * 0.5f;
-
-		// Randomly sample 2x2 nearby pixels for antialiasing
-		for (int i = 0; i < 4; i++)
-		{
-			float offset_x = ox[i];
-			float offset_y = oy[i];
-
-			// Randomize sampling point
-			offset_x += (RMath::Random() - 0.5f) * offset_radius;
-			offset_y += (RMath::Random() - 0.5f) * offset_radius;
-
-			RVec3 Dir(dx + offset_x, dy + offset_y, -0.5f);
-			RRay ray(ViewPoint, Dir.GetNormalizedVec3(), 1000.0f);
-			c += Scene->RayTrace(ray, MaxBounceCount, InOption);
-		}
-
-		c /= 4.0f;
-#else
-		RVec3 Dir(dx, dy, 0.5f);
-		RRay ray(ViewPoint, Dir.GetNormalizedVec3(), 1000.0f);
-		c = Scene->RayTrace(ray, MaxBounceCount, InOption);
-#endif  // ENABLE_ANTIALIASING
-
-		if (InOption.UseBaseColor)
-		{
-			// ARGB
-			Pixel color = MakePixelColor(LinearToGamma(c));
-			*(bitcolor + PixelIndex) = color;
-		}
-		else
-		{
-			accuBuffer[PixelIndex].AddPixel(c);
-			*(bitcolor + PixelIndex) = accuBuffer[PixelIndex].GetGammaSpacePixel();
-		}
-	}
-}
-
-void ThreadTaskWorker()
-{
-	std::thread::id this_id = std::this_thread::get_id();
-	std::stringstream ss;
-	ss << this_id;
-	const std::string ThreadName = ss.str();
-
-	RLogThread("Start worker thread [%s]\n", ThreadName.c_str());
-
-	RenderThreadTaskQueue& TaskQueue = RenderThreadTaskQueue::Get();
-
-	while (1)
-	{
-		RenderThreadTask Task;
-		{
-			std::unique_lock<std::mutex> ThreadLock(TaskQueue.GetMutex());
-
-			RLogThread("Thread [%s] is waiting\n", ThreadName.c_str());
-
-			// If the task queue is empty, wait until a new task is queued.
-			TaskQueue.GetWorkerThreadCondition().wait(ThreadLock, [] {
-				return RenderThreadTaskQueue::Get().GetNumTasks() > 0 || RayTracerProgram::GetActiveInstance().IsTerminating();
-			});
-
-			// Mutex is locked now
-
-			// Handle program terminating
-			if (RayTracerProgram::GetActiveInstance().IsTerminating())
-			{
-				RLogThread("Terminating thread [%s]\n", ThreadName.c_str());
-				return;
-			}
-
-			// Get a task from task queue
-			TaskQueue.PopTask(&Task);
-
-			RLogThread("Remaining tasks in queue: %d\n", TaskQueue.GetNumTasks());
-
-			// Mutex will be unlocked when leaving the scope. Other worker threads will then get tasks afterwards.
-		}
-
-		// The max times ray can bounce between surfaces
-		static const int MaxBounceTimes = 10;
-
-		RLogThread("Executing render task on thread [%s]...\n", ThreadName.c_str());
-		ThreadWorker_Render(Task.Start, Task.End, MaxBounceTimes, Task.Option);
-		RLogThread("Render task is done on thread [%s]!\n", ThreadName.c_str());
-
-		TaskQueue.NotifySingleTaskDone();
-	}
-}
+// Minimal interval between two resolves of the accumulation buffer for display
+static const int DisplayResolveIntervalMs = 100;
 
 // Convert milliseconds to h:m:s format
 void FormatTimeString(char* Buffer, int BufferSize, int Milliseconds)
@@ -269,42 +68,23 @@ void FormatTimeString(char* Buffer, int BufferSize, int Milliseconds)
 
 void UpdateBitmapPixels()
 {
-	// Total number of worker threads
-	const int ThreadCount = ThreadUtils::DetectWorkerThreadsNum();
+	RayTracerProgram& ActiveProgram = RayTracerProgram::GetActiveInstance();
+	RayTracerRenderer* Renderer = ActiveProgram.GetRenderer();
+	RenderSession* Session = ActiveProgram.GetSession();
 
-	RLog("Starting rendering tasks on %d threads...\n", ThreadCount);
-	ScopeAutoJoinedThreads WorkerThreads;
-	RenderThreadTaskQueue& TaskQueue = RenderThreadTaskQueue::Get();
+	PROFILE_THREAD_NAME("Render main");
 
-	RenderOption BaseColorOption;
-	BaseColorOption.UseBaseColor = true;
-	const int MaxBufferIdx = bitmapHeight * bitmapWidth - 1;
-	const int NumTaskRows = 10;
+	// Total number of worker threads
+	const int ThreadCount = ThreadUtils::DetectWorkerThreadsNum();
 
-	// Start all worker threads
-	for (int i = 0; i < ThreadCount; i++)
-	{
-		std::thread Worker(ThreadTaskWorker);
-		WorkerThreads.AddThread(Worker);
-	}
+	Renderer->StartWorkers(ActiveProgram.GetScene(), ThreadCount);
 
 	// Draw base color for preview
 	{
-		// Split rendering area to tasks
-		for (int i = 0; i < bitmapHeight; i += NumTaskRows)
-		{
-			//RLog("Creating task [%d/%d]...\n", i + 1, bitmapHeight);
-
-			int Start = i * bitmapWidth;
-			int End = Math::Min((i + NumTaskRows) * bitmapWidth - 1, MaxBufferIdx);
-
-			TaskQueue.PushTask(RenderThreadTask(Start, End, BaseColorOption));
-		}
-
-		RLog("Done pushing all tasks.\n");
+		RenderOption BaseColorOption;
+		BaseColorOption.UseBaseColor = true;
 
-		// Wait until all threads finish their work of current sample
-		TaskQueue.WaitForAllTasksDone();
+		Renderer->RenderPass(BaseColorOption);
 
 #if 0
 		return;
@@ -313,23 +93,29 @@ void UpdateBitmapPixels()
 
 	auto StartTime = std::chrono::system_clock::now();
 	auto LastFrameTime = StartTime;
+	auto LastResolveTime = StartTime;
 
-	for (int Sample = 0; Sample < TotalSamplesNum; Sample++)
+	while (Session->GetNumAccumulatedPasses() < TotalSamplesNum)
 	{
-		// Split rendering area to tasks
-		for (int i = 0; i < bitmapHeight; i += NumTaskRows)
+		// Edits of the scene restart the image with a quick preview
+		if (Session->RenderNextPass())
 		{
-			// One task covers rendering a single line from left to right
-			int Start = i * bitmapWidth;
-			int End = Math::Min((i + NumTaskRows) * bitmapWidth - 1, MaxBufferIdx);
-
-			TaskQueue.PushTask(RenderThreadTask(Start, End, RenderOption()));
+			StartTime = std::chrono::system_clock::now();
+			LastFrameTime = StartTime;
+			continue;
 		}
 
-		// Wait until all threads finish their work of current sample
-		TaskQueue.WaitForAllTasksDone();
+		const int Sample = Session->GetNumAccumulatedPasses() - 1;
 
 		auto CurrentTime = std::chrono::system_clock::now();
+
+		// Only convert samples to display pixels as often as the window can show them
+		if (std::chrono::duration_cast<std::chrono::milliseconds>(CurrentTime - LastResolveTime).count() >= DisplayResolveIntervalMs)
+		{
+			Renderer->ResolveAccumulationBuffer();
+			LastResolveTime = CurrentTime;
+		}
+
 		auto ElapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(CurrentTime - StartTime);
 		auto RemainingTime = ElapsedTime / (Sample + 1) * (TotalSamplesNum - Sample - 1);
 		int ElapsedTimeMs = (int)ElapsedTime.count();
@@ -350,8 +136,11 @@ void UpdateBitmapPixels()
 		// Log render information
 		RLog("%s\n", TextBuffer);
 
+#if ENABLE_TRAVERSAL_STATS
+		TraversalStats::LogCounters("Traversal", Renderer->GetPassTraversalCounters());
+#endif
+
 		// Update window title with render information
-		RayTracerProgram& ActiveProgram = RayTracerProgram::GetActiveInstance();
 		if (ActiveProgram.IsTerminating())
 		{
 			break;
@@ -360,10 +149,25 @@ void UpdateBitmapPixels()
 		ActiveProgram.GetRenderWindow()->SetTitle(TextBuffer);
 	}
     
+	Renderer->StopWorkers();
+
     RLog("Finished rendering image.\n");
+
+#if ENABLE_TRAVERSAL_STATS
+	TraversalStats::LogCounters("Total traversal", Renderer->GetTotalTraversalCounters());
+#endif
+
+	// Make sure output contains all samples
+	Renderer->ResolveAccumulationBuffer();
     
     // Save result image to file
     {
+		PROFILE_SCOPE("SaveImage");
+
+		// Workers are done, all threads can compress the image
+		ImageEncodeOptions SaveOptions;
+		SaveOptions.MaxThreads = ThreadCount;
+
         time_t rawtime;
         struct tm * timeinfo;
         char buffer[80];
@@ -372,7 +176,10 @@ void UpdateBitmapPixels()
         timeinfo = localtime(&rawtime);
         
         strftime(buffer,sizeof(buffer),"%Y-%m-%d_%H-%M-%S", timeinfo);
-        std::string Filename = std::string("Output_") + std::to_string(TotalSamplesNum) + "spp_" + buffer + ".png";
+        std::string Filename = std::string("Output_") + std::to_string(TotalSamplesNum) + "spp_" + buffer + ImageEncoder::GetFileExtension(SaveOptions.Format);
+#if ENABLE_TRAVERSAL_STATS
+		std::string HeatmapFilename = std::string("TraversalHeatmap_") + buffer + ".png";
+#endif
 
 		char CurrentDir[FILENAME_MAX];
 		GetCurrentDir(CurrentDir, FILENAME_MAX);
@@ -411,8 +218,17 @@ void UpdateBitmapPixels()
         if (bFoundOutputFolder)
         {
             Filename = OutputPath + Filename;
-            RTexture::SaveBufferToPNG(Filename.c_str(), bitcolor, bitmapWidth, bitmapHeight);
-            RLog("Image saved as %s\n", Filename.c_str());
+            // Image is written in the background, window stays responsive while it's compressed
+            ImageWriter* Writer = ActiveProgram.GetImageWriter();
+            Writer->SetEncodeOptions(SaveOptions);
+            Writer->WriteImage(Filename, Renderer->GetPixelBuffer(), bitmapWidth, bitmapHeight);
+            RLog("Saving image as %s\n", Filename.c_str());
+
+#if ENABLE_TRAVERSAL_STATS
+			HeatmapFilename = OutputPath + HeatmapFilename;
+			Renderer->SaveTraversalHeatmap(HeatmapFilename);
+			RLog("Traversal heatmap saved as %s\n", HeatmapFilename.c_str());
+#endif
         }
 		else
 		{
@@ -422,7 +238,8 @@ void UpdateBitmapPixels()
 }
 
 RayTracerProgram::RayTracerProgram()
-	: bQuit(false)
+	: Session(Scene, Renderer)
+	, bQuit(false)
 {
 	assert(CurrentInstance == nullptr);
 	CurrentInstance = this;
@@ -442,8 +259,10 @@ void RayTracerProgram::Run()
 	RMath::InitPseudoRandomUnitVector();
 	RLog("Done\n");
 
+	PROFILE_THREAD_NAME("Main");
+
 	MainRenderWindow.Create(bitmapWidth, bitmapHeight);
-	MainRenderWindow.SetRenderBufferParameters(bitmapWidth, bitmapHeight, bitcolor);
+	MainRenderWindow.SetRenderBufferParameters(bitmapWidth, bitmapHeight, Renderer.GetPixelBuffer());
 
 	SetupScene();
 
@@ -458,95 +277,23 @@ void RayTracerProgram::Run()
 void RayTracerProgram::ExecuteCleanup()
 {
 	bQuit = true;
-	RenderThreadTaskQueue::Get().NotifyQuit();
+	Renderer.RequestStop();
 	RayTracerMainThread.join();
 
+	// Output image may still be written in the background
+	Writer.Flush();
+
+#if ENABLE_PROFILER
+	Profiler::WriteChromeTrace("RayTracerTrace.json");
+#endif
+
 	MainRenderWindow.Destroy();
 }
 
 void RayTracerProgram::SetupScene()
 {
-	Scene.AddShape(RSphere::Create(RVec3(1.5f, 2.5f, -2.0f), 0.9f),
-		MakeUnique<SurfaceMaterial_Blend>(
-			MakeUnique<SurfaceMaterial_Reflective>(),
-			MakeUnique<SurfaceMaterial_Diffuse>(RVec3(1.0f, 0.5f, 0.1f)),
-			0.5f)
-	);
-
-	Scene.AddShape(RSphere::Create(RVec3(-1.5f, -0.5f, -3.0f), 0.5f),
-		MakeUnique<SurfaceMaterial_Diffuse>(RVec3(0.1f, 1.0f, 0.2f))
-	);
-
-	Scene.AddShape(RSphere::Create(RVec3(0.8f, -1.5f, -1.0f), 0.5f),
-		MakeUnique<SurfaceMaterial_Blend>(
-			MakeUnique<SurfaceMaterial_Reflective>(),
-			MakeUnique<SurfaceMaterial_Diffuse>(RVec3(0.5f, 0.0f, 0.2f)),
-			0.5f)
-	);
-
-	Scene.AddShape(RSphere::Create(RVec3(2.8f, -1.2f, -4.0f), 1.5f),
-		MakeUnique<SurfaceMaterial_Combine>(
-			MakeUnique<SurfaceMaterial_Blend>(
-				MakeUnique<SurfaceMaterial_Reflective>(RVec3(0.95f, 0.75f, 0.1f)),
-				MakeUnique<SurfaceMaterial_Diffuse>(RVec3(0.95f, 0.75f, 0.1f)),
-				0.5f),
-			MakeUnique<SurfaceMaterial_Emissive>(RVec3(0.95f, 0.75f, 0.1f) * 0.5f)
-		)
-	);
-
-	//// Ceiling light
-	//Scene.AddShape(RSphere::Create(RVec3(0.0f, 5.0f, 0.0f), 0.5f),
-	//	MakeUnique<SurfaceMaterial_Emissive>(RVec3(5.0f, 2.0f, 6.0f))
-	//);
-
-	Scene.AddShape(RCapsule::Create(RVec3(-1.5f, -1.5f, -1.5f), RVec3(-2.0f, -1.5f, 0.0f), 0.5f),
-        MakeUnique<SurfaceMaterial_Blend>(
-            MakeUnique<SurfaceMaterial_Reflective>(RVec3(0.8f, 0.75f, 0.6f), 0.2f),
-            MakeUnique<SurfaceMaterial_Diffuse>(RVec3(0.25f, 0.75f, 0.6f)),
-            0.2f)
-	);
-
-	// Walls
-	{
-		// Ground
-		Scene.AddShape(RPlane::Create(RVec3(0.0f, 1.0f, 0.0f), RVec3(0.0f, -2.0f, 0.0f)),
-			MakeUnique<SurfaceMaterial_Blend>(
-				MakeUnique<SurfaceMaterial_Reflective>(RVec3(1, 1, 1), 0.1f),
-				MakeUnique<SurfaceMaterial_DiffuseChecker>(),
-				0.5f)
-		);
-
-		//// Ceiling / Sky light plane
-		//Scene.AddShape(RPlane::Create(RVec3(0.0f, -1.0f, 0.0f), RVec3(0.0f, 5.0f, 0.0f)),
-		//	MakeUnique<SurfaceMaterial_Diffuse>(RVec3(1.2f, 1.2f, 1.5f))
-		//);
-
-		//// Back wall
-		//Scene.AddShape(RPlane::Create(RVec3(0.0f, 0.0f, 1.0f), RVec3(0.0f, 0.0f, -5.0f)),
-		//	MakeUnique<SurfaceMaterial_DiffuseChecker>()
-		//);
-
-		//// Front wall (behind the camera)
-		//Scene.AddShape(RPlane::Create(RVec3(0.0f, 0.0f, -1.0f), RVec3(0.0f, 0.0f, 10.0f)),
-		//	MakeUnique<SurfaceMaterial_DiffuseChecker>()
-		//);
-
-		//// Right wall
-		//Scene.AddShape(RPlane::Create(RVec3(1.0f, 0.0f, 0.0f), RVec3(-5.0f, 0.0f, 0.0f)),
-		//	MakeUnique<SurfaceMaterial_DiffuseChecker>()
-		//);
-
-		//// Left wall
-		//Scene.AddShape(RPlane::Create(RVec3(-1.0f, 0.0f, 0.0f), RVec3(5.0f, 0.0f, 0.0f)),
-		//	MakeUnique<SurfaceMaterial_DiffuseChecker>()
-		//);
-	}
+	SceneSetup::AddPrimitiveShapes(Scene);
 
 	// Meshes
-	Scene.AddShape(RMeshShape::Create("Data/unitychan.obj"),
-		MakeUnique<SurfaceMaterial_Blend>(
-			MakeUnique<SurfaceMaterial_Reflective>(RVec3(1, 1, 1), 0.2f),
-			MakeUnique<SurfaceMaterial_Diffuse>(RVec3(1.0f, 1.0f, 1.0f)),
-			1.0f)
-	);
+	SceneSetup::AddMesh(Scene, "Data/unitychan.obj");
 }
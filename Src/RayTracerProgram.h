@@ -16,7 +16,10 @@
 #include "Linux/RenderWindow_X11.h"
 #endif
 
+#include "ImageWriter.h"
 #include "RayTracerScene.h"
+#include "RayTracerRenderer.h"
+#include "RenderSession.h"
 
 #include <thread>
 #include <assert.h>
@@ -42,6 +45,15 @@ public:
 	// Get the scene of program
 	RayTracerScene* GetScene();
 
+	// Get the renderer of program
+	RayTracerRenderer* GetRenderer();
+
+	// Get the session applying edits of the scene between render passes
+	RenderSession* GetSession();
+
+	// Get the writer saving output images in the background
+	ImageWriter* GetImageWriter();
+
 	// Has program requested to quit
 	bool IsTerminating() const;
 
@@ -56,6 +68,12 @@ private:
 
 	RayTracerScene Scene;
 
+	RayTracerRenderer Renderer;
+
+	RenderSession Session;
+
+	ImageWriter Writer;
+
 	std::thread RayTracerMainThread;
 
 	bool bQuit;
@@ -78,6 +96,21 @@ FORCEINLINE RayTracerScene* RayTracerProgram::GetScene()
 	return &Scene;
 }
 
+FORCEINLINE RayTracerRenderer* RayTracerProgram::GetRenderer()
+{
+	return &Renderer;
+}
+
+FORCEINLINE RenderSession* RayTracerProgram::GetSession()
+{
+	return &Session;
+}
+
+FORCEINLINE ImageWriter* RayTracerProgram::GetImageWriter()
+{
+	return &Writer;
+}
+
 FORCEINLINE bool RayTracerProgram::IsTerminating() const
 {
 	return bQuit;
@@ -0,0 +1,439 @@
+//=============================================================================
+// RayTracerRenderer.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "RayTracerRenderer.h"
+
+#include "Math.h"
+#include "MemoryArena.h"
+#include "Profiler.h"
+#include "RRay.h"
+#include "RRayPacket.h"
+#include "WavefrontPathTracer.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <string>
+
+// Whether to enable 2x2 antialiasing for pixel sampling
+#define ENABLE_ANTIALIASING 1
+
+// Trace camera rays of neighbouring pixels together in ray packets
+#define USE_RAY_PACKETS 1
+
+// Trace batches of pixels with a wavefront path tracer instead of following paths one by one
+#define USE_WAVEFRONT 1
+
+namespace
+{
+	// The max times ray can bounce between surfaces
+	const int MaxBounceTimes = 10;
+
+	// Number of image rows rendered by a single task
+	const int NumTaskRows = 10;
+
+#if ENABLE_ANTIALIASING
+	const int SamplesPerPixel = 4;
+#else
+	const int SamplesPerPixel = 1;
+#endif  // ENABLE_ANTIALIASING
+
+	// Pixels sharing a ray packet
+	const int PixelsPerPacket = RayPacketSize / SamplesPerPixel;
+
+	static_assert(RayPacketSize % SamplesPerPixel == 0, "Camera rays of a pixel must fit in a single packet");
+
+	// Pixels traced together by the wavefront path tracer
+	const int WavefrontBatchPixels = 1024;
+
+	// Width of the image rendered by a pass. Preview passes render one pixel for each block of display pixels.
+	int GetPassImageWidth(const RenderOption& InOption)
+	{
+		return (bitmapWidth + InOption.PreviewPixelSize - 1) / InOption.PreviewPixelSize;
+	}
+
+	// Height of the image rendered by a pass
+	int GetPassImageHeight(const RenderOption& InOption)
+	{
+		return (bitmapHeight + InOption.PreviewPixelSize - 1) / InOption.PreviewPixelSize;
+	}
+
+	// Index of the first display pixel covered by a pixel of the pass image
+	int GetDisplayPixelIndex(int PixelIndex, const RenderOption& InOption)
+	{
+		const int ImageWidth = GetPassImageWidth(InOption);
+		const int x = PixelIndex % ImageWidth * InOption.PreviewPixelSize;
+		const int y = PixelIndex / ImageWidth * InOption.PreviewPixelSize;
+		return y * bitmapWidth + x;
+	}
+
+	// Generate camera rays for all samples of a pixel of the pass image
+	void GenerateCameraRays(const RCamera& Camera, int PixelIndex, const RenderOption& InOption, RRay OutRays[])
+	{
+		const int ImageWidth = GetPassImageWidth(InOption);
+		const int ImageHeight = GetPassImageHeight(InOption);
+		const float Aspect = (float)bitmapWidth / (float)bitmapHeight;
+
+		// Angle covered by a pixel, camera rays step 1 / (2 * ImageHeight) vertically on the image plane at distance 0.5
+		const float PixelSpreadAngle = 1.0f / ImageHeight;
+
+		const int x = PixelIndex % ImageWidth;
+		const int y = PixelIndex / ImageWidth;
+		float dx = -(float)(x - ImageWidth / 2) / (ImageWidth * 2) * Aspect;
+		float dy = -(float)(y - ImageHeight / 2) / (ImageHeight * 2);
+
+#if ENABLE_ANTIALIASING
+		const float inv_pixel_radius = 1.0f / (ImageWidth * 4);
+
+		const float ox[4] = { 0.0f, inv_pixel_radius, 0.0f, inv_pixel_radius };
+		const float oy[4] = { 0.0f, 0.0f, inv_pixel_radius, inv_pixel_radius };
+
+		const float offset_radius = inv_pixel_radius * 0.5f;
+
+		// Randomly sample 2x2 nearby pixels for antialiasing
+		for (int i = 0; i < 4; i++)
+		{
+			float offset_x = ox[i];
+			float offset_y = oy[i];
+
+			// Randomize sampling point
+			offset_x += (RMath::Random() - 0.5f) * offset_radius;
+			offset_y += (RMath::Random() - 0.5f) * offset_radius;
+
+			RVec3 Dir = Camera.GetImagePlaneDirection(dx + offset_x, dy + offset_y);
+			OutRays[i] = RRay(Camera.GetPosition(), Dir.GetNormalizedVec3(), 1000.0f);
+			OutRays[i].ConeSpreadAngle = PixelSpreadAngle;
+		}
+#else
+		RVec3 Dir = Camera.GetImagePlaneDirection(dx, dy);
+		OutRays[0] = RRay(Camera.GetPosition(), Dir.GetNormalizedVec3(), 1000.0f);
+		OutRays[0].ConeSpreadAngle = PixelSpreadAngle;
+#endif  // ENABLE_ANTIALIASING
+	}
+}
+
+RayTracerRenderer::RayTracerRenderer()
+	: Scene(nullptr)
+	, PixelBuffer(bitmapWidth * bitmapHeight)
+	, AccumulationBuffer(bitmapWidth * bitmapHeight)
+	, bStopping(false)
+	, NumTracedRays(0)
+	, NumPrimaryRays(0)
+#if ENABLE_TRAVERSAL_STATS
+	, PixelTraversalCosts(bitmapWidth * bitmapHeight)
+	, PixelTraversalSamples(bitmapWidth * bitmapHeight)
+#endif
+{
+}
+
+RayTracerRenderer::~RayTracerRenderer()
+{
+	StopWorkers();
+}
+
+void RayTracerRenderer::StartWorkers(const RayTracerScene* InScene, int ThreadCount)
+{
+	assert(WorkerThreads.empty());
+
+	Scene = InScene;
+
+#if ENABLE_TRAVERSAL_STATS
+	WorkerTraversalCounters.assign(ThreadCount, TraversalCounters());
+#endif
+
+	RLog("Starting rendering tasks on %d threads...\n", ThreadCount);
+	for (int i = 0; i < ThreadCount; i++)
+	{
+		WorkerThreads.push_back(std::thread(&RayTracerRenderer::WorkerThreadMain, this, i));
+	}
+}
+
+void RayTracerRenderer::RequestStop()
+{
+	bStopping = true;
+	TaskQueue.NotifyQuit();
+}
+
+void RayTracerRenderer::StopWorkers()
+{
+	RequestStop();
+
+	for (auto& Thread : WorkerThreads)
+	{
+		Thread.join();
+	}
+
+	WorkerThreads.clear();
+}
+
+void RayTracerRenderer::SetCamera(const RCamera& InCamera)
+{
+	Camera = InCamera;
+}
+
+void RayTracerRenderer::ResetAccumulation()
+{
+	std::fill(AccumulationBuffer.begin(), AccumulationBuffer.end(), AccumulatePixel());
+}
+
+void RayTracerRenderer::RenderPass(const RenderOption& InOption /*= RenderOption()*/)
+{
+	PROFILE_SCOPE(InOption.UseBaseColor ? "BaseColorPass" : (InOption.PreviewPixelSize > 1 ? "PreviewPass" : "SamplePass"));
+
+	const int ImageWidth = GetPassImageWidth(InOption);
+	const int ImageHeight = GetPassImageHeight(InOption);
+	const int MaxBufferIdx = ImageHeight * ImageWidth - 1;
+
+	// Split rendering area to tasks
+	for (int i = 0; i < ImageHeight; i += NumTaskRows)
+	{
+		int Start = i * ImageWidth;
+		int End = Math::Min((i + NumTaskRows) * ImageWidth - 1, MaxBufferIdx);
+
+		TaskQueue.PushTask(RenderThreadTask(Start, End, InOption));
+	}
+
+	// Wait until all threads finish their work of current pass
+	TaskQueue.WaitForAllTasksDone();
+
+#if ENABLE_TRAVERSAL_STATS
+	// Workers may still be running an aborted task
+	if (!IsStopping())
+	{
+		PassTraversalCounters.Reset();
+		for (auto& Counters : WorkerTraversalCounters)
+		{
+			PassTraversalCounters += Counters;
+			Counters.Reset();
+		}
+
+		TotalTraversalCounters += PassTraversalCounters;
+	}
+#endif
+}
+
+void RayTracerRenderer::ResolveAccumulationBuffer()
+{
+	PROFILE_SCOPE("ResolveAccumulationBuffer");
+
+	for (int PixelIndex = 0; PixelIndex < bitmapWidth * bitmapHeight; PixelIndex++)
+	{
+		const AccumulatePixel& Accumulated = AccumulationBuffer[PixelIndex];
+
+		// Keep the preview color for pixels that have not been sampled yet
+		if (Accumulated.Num > 0)
+		{
+			PixelBuffer[PixelIndex] = Accumulated.GetGammaSpacePixel();
+		}
+	}
+}
+
+#if ENABLE_TRAVERSAL_STATS
+bool RayTracerRenderer::SaveTraversalHeatmap(const std::string& Filename) const
+{
+	return TraversalStats::SaveHeatmapPNG(Filename, PixelTraversalCosts.data(), PixelTraversalSamples.data(), bitmapWidth, bitmapHeight);
+}
+#endif
+
+void RayTracerRenderer::WorkerThreadMain(int WorkerIndex)
+{
+	PROFILE_THREAD_NAME(std::string("Worker ") + std::to_string(WorkerIndex));
+
+	// Transient data of a task, released after the task is done
+	RMemoryArena TaskArena;
+
+#if USE_WAVEFRONT
+	// Path queues are kept between tasks to reuse their memory
+	WavefrontPathTracer PathTracer;
+#endif
+
+	while (1)
+	{
+		RenderThreadTask Task;
+		{
+			std::unique_lock<std::mutex> ThreadLock(TaskQueue.GetMutex());
+
+			// If the task queue is empty, wait until a new task is queued.
+			TaskQueue.GetWorkerThreadCondition().wait(ThreadLock, [this] {
+				return TaskQueue.GetNumTasks() > 0 || TaskQueue.IsQuitting();
+			});
+
+			// Mutex is locked now
+
+			// Handle renderer stopping
+			if (TaskQueue.IsQuitting())
+			{
+				return;
+			}
+
+			// Get a task from task queue
+			TaskQueue.PopTask(&Task);
+
+			// Mutex will be unlocked when leaving the scope. Other worker threads will then get tasks afterwards.
+		}
+
+		const long long RayCountBefore = RayTracerScene::GetThreadTracedRayCount();
+
+		{
+			// First image row of the task is recorded with the event
+			PROFILE_SCOPE_ARG("RenderTask", Task.Start / GetPassImageWidth(Task.Option));
+#if USE_WAVEFRONT
+			RenderPixelsWavefront(Task.Start, Task.End, MaxBounceTimes, Task.Option, PathTracer, TaskArena);
+#else
+			RenderPixels(Task.Start, Task.End, MaxBounceTimes, Task.Option);
+#endif
+		}
+
+		TaskArena.Reset();
+
+		NumTracedRays += RayTracerScene::GetThreadTracedRayCount() - RayCountBefore;
+
+#if ENABLE_TRAVERSAL_STATS
+		// Published to the renderer when the task is marked as done
+		WorkerTraversalCounters[WorkerIndex] += GThreadTraversalCounters;
+		GThreadTraversalCounters.Reset();
+#endif
+
+		TaskQueue.NotifySingleTaskDone();
+	}
+}
+
+void RayTracerRenderer::RenderPixels(int Begin, int End, int MaxBounceCount, const RenderOption& InOption)
+{
+	int NumCameraRays = 0;
+
+	for (int FirstPixel = Begin; FirstPixel <= End; FirstPixel += PixelsPerPacket)
+	{
+		// Stop rendering as soon as possible when program is exiting
+		if (IsStopping())
+		{
+			break;
+		}
+
+		const int NumPixels = Math::Min(PixelsPerPacket, End - FirstPixel + 1);
+		const int NumRays = NumPixels * SamplesPerPixel;
+
+		RRay CameraRays[RayPacketSize];
+		for (int i = 0; i < NumPixels; i++)
+		{
+			GenerateCameraRays(Camera, FirstPixel + i, InOption, &CameraRays[i * SamplesPerPixel]);
+		}
+
+#if ENABLE_TRAVERSAL_STATS
+		const long long CostBefore = GThreadTraversalCounters.GetCost();
+#endif
+
+		RVec3 Colors[RayPacketSize];
+
+#if USE_RAY_PACKETS
+		Scene->RayTracePacket(RRayPacket(CameraRays, NumRays), MaxBounceCount, Colors, InOption);
+#else
+		for (int i = 0; i < NumRays; i++)
+		{
+			Colors[i] = Scene->RayTrace(CameraRays[i], MaxBounceCount, InOption);
+		}
+#endif  // USE_RAY_PACKETS
+
+		NumCameraRays += NumRays;
+
+#if ENABLE_TRAVERSAL_STATS
+		// Pixels of a packet share its traversal cost. The remainder goes to the first pixels, so the packet's total is kept.
+		const long long PacketCost = GThreadTraversalCounters.GetCost() - CostBefore;
+#endif
+
+		for (int i = 0; i < NumPixels; i++)
+		{
+#if ENABLE_TRAVERSAL_STATS
+			const int DisplayPixelIndex = GetDisplayPixelIndex(FirstPixel + i, InOption);
+			PixelTraversalCosts[DisplayPixelIndex] += PacketCost / NumPixels + (i < PacketCost % NumPixels ? 1 : 0);
+			PixelTraversalSamples[DisplayPixelIndex]++;
+#endif
+
+			OutputPixel(FirstPixel + i, &Colors[i * SamplesPerPixel], InOption);
+		}
+	}
+
+	NumPrimaryRays += NumCameraRays;
+}
+
+void RayTracerRenderer::RenderPixelsWavefront(int Begin, int End, int MaxBounceCount, const RenderOption& InOption, WavefrontPathTracer& PathTracer, RMemoryArena& Arena)
+{
+	int NumCameraRays = 0;
+
+	RRay* CameraRays = Arena.AllocateArray<RRay>(WavefrontBatchPixels * SamplesPerPixel);
+	RVec3* Colors = Arena.AllocateArray<RVec3>(WavefrontBatchPixels * SamplesPerPixel);
+
+	for (int FirstPixel = Begin; FirstPixel <= End; FirstPixel += WavefrontBatchPixels)
+	{
+		// Stop rendering as soon as possible when program is exiting
+		if (IsStopping())
+		{
+			break;
+		}
+
+		const int NumPixels = Math::Min(WavefrontBatchPixels, End - FirstPixel + 1);
+		const int NumRays = NumPixels * SamplesPerPixel;
+
+		for (int i = 0; i < NumPixels; i++)
+		{
+			GenerateCameraRays(Camera, FirstPixel + i, InOption, &CameraRays[i * SamplesPerPixel]);
+		}
+
+		PathTracer.TracePaths(*Scene, CameraRays, NumRays, MaxBounceCount, Colors, InOption);
+
+		NumCameraRays += NumRays;
+
+		for (int i = 0; i < NumPixels; i++)
+		{
+#if ENABLE_TRAVERSAL_STATS
+			const int DisplayPixelIndex = GetDisplayPixelIndex(FirstPixel + i, InOption);
+			const long long* SampleCosts = PathTracer.GetSampleTraversalCosts() + i * SamplesPerPixel;
+			for (int Sample = 0; Sample < SamplesPerPixel; Sample++)
+			{
+				PixelTraversalCosts[DisplayPixelIndex] += SampleCosts[Sample];
+			}
+			PixelTraversalSamples[DisplayPixelIndex]++;
+#endif
+
+			OutputPixel(FirstPixel + i, &Colors[i * SamplesPerPixel], InOption);
+		}
+	}
+
+	NumPrimaryRays += NumCameraRays;
+}
+
+void RayTracerRenderer::OutputPixel(int PixelIndex, const RVec3 SampleColors[], const RenderOption& InOption)
+{
+	RVec3 c = RVec3::Zero();
+	for (int Sample = 0; Sample < SamplesPerPixel; Sample++)
+	{
+		c += SampleColors[Sample];
+	}
+	c /= (float)SamplesPerPixel;
+
+	if (InOption.UseBaseColor || InOption.PreviewPixelSize > 1)
+	{
+		// ARGB
+		Pixel color = MakeGammaSpacePixelColor(c);
+
+		// Fill all display pixels covered by the pixel
+		const int DisplayPixelIndex = GetDisplayPixelIndex(PixelIndex, InOption);
+		const int BlockWidth = Math::Min(InOption.PreviewPixelSize, bitmapWidth - DisplayPixelIndex % bitmapWidth);
+		const int BlockHeight = Math::Min(InOption.PreviewPixelSize, bitmapHeight - DisplayPixelIndex / bitmapWidth);
+
+		for (int y = 0; y < BlockHeight; y++)
+		{
+			for (int x = 0; x < BlockWidth; x++)
+			{
+				PixelBuffer[DisplayPixelIndex + y * bitmapWidth + x] = color;
+			}
+		}
+	}
+	else
+	{
+		// Display pixels are resolved from the accumulation buffer after the pass
+		AccumulationBuffer[PixelIndex].AddPixel(c);
+	}
+}
@@ -0,0 +1,199 @@
+//=============================================================================
+// RayTracerRenderer.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "Camera.h"
+#include "ColorBuffer.h"
+#include "MemoryArena.h"
+#include "RayTracerScene.h"
+#include "ThreadTaskQueue.h"
+#include "TraversalStats.h"
+#include "WavefrontPathTracer.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AccumulatePixel
+{
+	AccumulatePixel()
+		: AccumulatedColor(0, 0, 0), Num(0)
+	{}
+
+	void AddPixel(RVec3 Color)
+	{
+		AccumulatedColor += Color;
+		Num++;
+	}
+
+	Pixel GetPixel() const
+	{
+		return MakePixelColor(AccumulatedColor / (float)Num);
+	}
+
+	Pixel GetGammaSpacePixel() const
+	{
+		return MakeGammaSpacePixelColor(AccumulatedColor * (1.0f / Num));
+	}
+
+	RVec3 AccumulatedColor;
+	int Num;
+};
+
+struct RenderThreadTask
+{
+	RenderThreadTask()
+	{
+	}
+
+	RenderThreadTask(int InStart, int InEnd, const RenderOption& InOption)
+		: Start(InStart)
+		, End(InEnd)
+		, Option(InOption)
+	{
+	}
+
+	int Start;
+	int End;
+	RenderOption Option;
+};
+
+typedef ThreadTaskQueue<RenderThreadTask> RenderThreadTaskQueue;
+
+// Renders a scene into the accumulation buffer with a pool of worker threads
+class RayTracerRenderer
+{
+public:
+	RayTracerRenderer();
+	~RayTracerRenderer();
+
+	// Start worker threads for rendering a scene
+	void StartWorkers(const RayTracerScene* InScene, int ThreadCount);
+
+	// Ask workers to abort the pass in progress and quit. Returns immediately.
+	void RequestStop();
+
+	// Stop and join all worker threads
+	void StopWorkers();
+
+	// Whether workers have been asked to stop
+	bool IsStopping() const;
+
+	// Set the camera of following passes. Must not be called while a pass is being rendered.
+	void SetCamera(const RCamera& InCamera);
+
+	// Get the camera of rendered passes
+	const RCamera& GetCamera() const;
+
+	// Discard all accumulated samples, so following passes start a new image.
+	// Display pixels keep their colors until they are sampled again.
+	void ResetAccumulation();
+
+	// Render every pixel of the image once. Blocks until the pass is finished or aborted.
+	void RenderPass(const RenderOption& InOption = RenderOption());
+
+	// Convert accumulated linear colors to gamma space pixels for display and output
+	void ResolveAccumulationBuffer();
+
+	// Get display pixels of the image
+	Pixel* GetPixelBuffer();
+
+	// Number of rays tested against the scene since workers started
+	long long GetNumTracedRays() const;
+
+	// Number of camera rays generated since workers started
+	long long GetNumPrimaryRays() const;
+
+#if ENABLE_TRAVERSAL_STATS
+	// Traversal counters of the last finished pass
+	const TraversalCounters& GetPassTraversalCounters() const;
+
+	// Traversal counters of all finished passes since workers started
+	const TraversalCounters& GetTotalTraversalCounters() const;
+
+	// Save average traversal cost of every pixel as a false color image
+	bool SaveTraversalHeatmap(const std::string& Filename) const;
+#endif
+
+private:
+	// Main function of worker threads
+	void WorkerThreadMain(int WorkerIndex);
+
+	// Render pixels of the pass image in range [Begin, End]
+	void RenderPixels(int Begin, int End, int MaxBounceCount, const RenderOption& InOption);
+
+	// Render pixels of the pass image in range [Begin, End] in batches traced by a wavefront path tracer. Batch data is allocated from the arena.
+	void RenderPixelsWavefront(int Begin, int End, int MaxBounceCount, const RenderOption& InOption, WavefrontPathTracer& PathTracer, RMemoryArena& Arena);
+
+	// Average colors of all samples of a pass image pixel and write it to the buffers
+	void OutputPixel(int PixelIndex, const RVec3 SampleColors[], const RenderOption& InOption);
+
+	const RayTracerScene* Scene;
+
+	RCamera Camera;
+
+	std::vector<Pixel> PixelBuffer;
+	std::vector<AccumulatePixel> AccumulationBuffer;
+
+	RenderThreadTaskQueue TaskQueue;
+	std::vector<std::thread> WorkerThreads;
+
+	std::atomic<bool> bStopping;
+	std::atomic<long long> NumTracedRays;
+	std::atomic<long long> NumPrimaryRays;
+
+#if ENABLE_TRAVERSAL_STATS
+	// Counters flushed by workers after each task. Every element is only written by its own worker.
+	std::vector<TraversalCounters> WorkerTraversalCounters;
+
+	TraversalCounters PassTraversalCounters;
+	TraversalCounters TotalTraversalCounters;
+
+	// Sum of traversal cost and number of samples of each pixel
+	std::vector<long long> PixelTraversalCosts;
+	std::vector<int> PixelTraversalSamples;
+#endif
+};
+
+
+FORCEINLINE bool RayTracerRenderer::IsStopping() const
+{
+	return bStopping.load(std::memory_order_relaxed);
+}
+
+FORCEINLINE const RCamera& RayTracerRenderer::GetCamera() const
+{
+	return Camera;
+}
+
+FORCEINLINE Pixel* RayTracerRenderer::GetPixelBuffer()
+{
+	return PixelBuffer.data();
+}
+
+FORCEINLINE long long RayTracerRenderer::GetNumTracedRays() const
+{
+	return NumTracedRays;
+}
+
+FORCEINLINE long long RayTracerRenderer::GetNumPrimaryRays() const
+{
+	return NumPrimaryRays;
+}
+
+#if ENABLE_TRAVERSAL_STATS
+FORCEINLINE const TraversalCounters& RayTracerRenderer::GetPassTraversalCounters() const
+{
+	return PassTraversalCounters;
+}
+
+FORCEINLINE const TraversalCounters& RayTracerRenderer::GetTotalTraversalCounters() const
+{
+	return TotalTraversalCounters;
+}
+#endif
@@ -7,10 +7,17 @@
 #include "RayTracerScene.h"
 #include "Math.h"
 #include "Platform.h"
-#include "RayTracerProgram.h"
+#include "Texture.h"
+#include "TraversalStats.h"
 
 #define USE_LIGHTS 0
 
+namespace
+{
+	// Number of rays tested against the scene by current thread
+	thread_local long long ThreadTracedRayCount = 0;
+}
+
 LightData GSceneLights[] =
 {
 	//{ LT_Directional,	RVec3(0.0f, -1.0f, 0.0f), RVec3(1, 1, 1) },
@@ -24,47 +31,107 @@ RayTracerScene::RayTracerScene()
 
 void RayTracerScene::AddShape(unique_ptr<RShape> Shape, unique_ptr<ISurfaceMaterial> SurfaceMaterial)
 {
+	ShapeMaterialIndices.push_back(SurfaceMaterial ? Materials.AddMaterial(*SurfaceMaterial) : -1);
+
 	Shape->SetSurfaceMaterial(std::move(SurfaceMaterial));
 	SceneShapes.push_back(std::move(Shape));
 }
 
-RVec3 RayTracerScene::RayTrace(const RRay& InRay, int MaxBounceTimes, const RenderOption& InOption /*= RenderOption()*/) const
+void RayTracerScene::SetShapeMaterial(int ShapeIndex, unique_ptr<ISurfaceMaterial> SurfaceMaterial)
+{
+	SceneShapes[ShapeIndex]->SetSurfaceMaterial(std::move(SurfaceMaterial));
+
+	// Records of each material are packed together, so the table is flattened again instead of patched in place
+	RebuildMaterialTable();
+}
+
+void RayTracerScene::MoveShape(int ShapeIndex, const RVec3& Offset)
+{
+	// Shapes are culled by their world bounds one by one, so the scene itself has nothing to refit.
+	// Mesh instances only update their transform and bounds, bare meshes move their vertices and refit their tree.
+	SceneShapes[ShapeIndex]->Translate(Offset);
+}
+
+void RayTracerScene::RebuildMaterialTable()
 {
-	// Stop the recursion function when program is exiting
-	if (RayTracerProgram::GetActiveInstance().IsTerminating())
+	Materials.Clear();
+
+	for (int i = 0; i < (int)SceneShapes.size(); i++)
 	{
-		return RVec3(0, 0, 0);
+		const ISurfaceMaterial* SurfaceMaterial = SceneShapes[i]->GetSurfaceMaterial();
+		ShapeMaterialIndices[i] = SurfaceMaterial ? Materials.AddMaterial(*SurfaceMaterial) : -1;
 	}
+}
 
+RVec3 RayTracerScene::RayTrace(const RRay& InRay, int MaxBounceTimes, const RenderOption& InOption /*= RenderOption()*/) const
+{
 	if (MaxBounceTimes == 0)
 	{
 		return RVec3::Zero();
 	}
 
-	RVec3 FinalColor = RVec3::Zero();
-
 	RayHitResult Result;
 	int HitShapeIndex = FindIntersectionWithScene(InRay, Result);
+	SampleHitTexture(Result);
+
+	return ShadeHit(InRay, HitShapeIndex, Result, MaxBounceTimes, InOption);
+}
+
+void RayTracerScene::RayTracePacket(const RRayPacket& InPacket, int MaxBounceTimes, RVec3 OutColors[], const RenderOption& InOption /*= RenderOption()*/) const
+{
+	if (MaxBounceTimes == 0)
+	{
+		for (int Lane = 0; Lane < InPacket.GetNumRays(); Lane++)
+		{
+			OutColors[Lane] = RVec3::Zero();
+		}
+
+		return;
+	}
+
+	RayHitResult Results[RayPacketSize];
+	int HitShapeIndices[RayPacketSize];
+	FindIntersectionWithScene(InPacket, Results, HitShapeIndices);
+
+	for (int Lane = 0; Lane < InPacket.GetNumRays(); Lane++)
+	{
+		SampleHitTexture(Results[Lane]);
+	}
+
+	// Bounced rays are no longer coherent, shade and continue tracing them one by one
+	for (int Lane = 0; Lane < InPacket.GetNumRays(); Lane++)
+	{
+		OutColors[Lane] = ShadeHit(InPacket.GetRay(Lane), HitShapeIndices[Lane], Results[Lane], MaxBounceTimes, InOption);
+	}
+}
+
+RVec3 RayTracerScene::ShadeHit(const RRay& InRay, int HitShapeIndex, const RayHitResult& Result, int MaxBounceTimes, const RenderOption& InOption) const
+{
+	RVec3 FinalColor = RVec3::Zero();
 
 	if (HitShapeIndex != -1)
 	{
-		auto& HitShape = SceneShapes[HitShapeIndex];
-		ISurfaceMaterial* const SurfaceMaterial = HitShape->GetSurfaceMaterial();
+		const int MaterialIndex = ShapeMaterialIndices[HitShapeIndex];
 
 		if (InOption.UseBaseColor)
 		{
 			// Base color render pass for previewing
-			if (SurfaceMaterial)
+			if (MaterialIndex != -1)
 			{
-				FinalColor += SurfaceMaterial->PreviewColor(Result) * Result.SampledColor;
+				FinalColor += Materials.PreviewColor(MaterialIndex, Result) * Result.SampledColor;
 			}
 		}
 		else
 		{
-			if (SurfaceMaterial)
+			if (MaterialIndex != -1)
 			{
 				RRay OutRay;
-				auto BounceResult = SurfaceMaterial->BounceViewRay(InRay, Result, OutRay);
+				auto BounceResult = Materials.BounceViewRay(MaterialIndex, InRay, Result, OutRay);
+
+				// Ray cone keeps growing from the hit point, bounced rays are treated like mirror reflections
+				const float HitConeWidth = InRay.ConeWidth + InRay.ConeSpreadAngle * Result.Distance;
+				OutRay.ConeWidth = HitConeWidth;
+				OutRay.ConeSpreadAngle = InRay.ConeSpreadAngle;
 
 				if (RMath::Random() <= Result.SampledAlpha)
 				{
@@ -81,6 +148,8 @@ RVec3 RayTracerScene::RayTrace(const RRay& InRay, int MaxBounceTimes, const Rend
 					// Transparent, continue tracing the view ray in current direction
 					float RayDistance = InRay.Distance - Result.Distance;
 					OutRay = RRay(Result.HitPosition + InRay.Direction * BounceRayStartOffset, InRay.Direction, RayDistance);
+					OutRay.ConeWidth = HitConeWidth;
+					OutRay.ConeSpreadAngle = InRay.ConeSpreadAngle;
 					FinalColor += RayTrace(OutRay, MaxBounceTimes - 1, InOption);
 				}
 			}
@@ -89,8 +158,7 @@ RVec3 RayTracerScene::RayTrace(const RRay& InRay, int MaxBounceTimes, const Rend
     else
     {
         // Did not hit any shapes, returns sky color
-        float t = 0.5f * (InRay.Direction.y + 1.0f);
-        return (1.0f - t) * RVec3(1.0f, 1.0f, 1.0f) + t * RVec3(0.5f, 0.7f, 1.0f);
+        return GetSkyColor(InRay.Direction);
     }
 
 	return FinalColor;
@@ -101,13 +169,23 @@ int RayTracerScene::FindIntersectionWithScene(RRay TestRay, RayHitResult& OutRes
 	int HitShapeIndex = -1;
 	int Index = 0;
 
+	ThreadTracedRayCount++;
+	TRAVERSAL_STAT_INC(Rays);
+
 	// Get nearest hit point for this ray
 	for (auto& Shape : SceneShapes)
 	{
 		// If shape has a bound, run bound intersection test for early out.
 		// Note: Shapes such as planes don't have bounds. Always run a full intersection test on them.
+		if (Shape->HasCullingBounds())
+		{
+			TRAVERSAL_STAT_INC(AabbTests);
+		}
+
 		if (!Shape->HasCullingBounds() || TestRay.TestIntersectionWithAabb(Shape->GetBounds()))
 		{
+			TRAVERSAL_STAT_INC(ShapesTested);
+
 			bool hit = Shape->TestRayIntersection(TestRay, &OutResult);
 
 			if (hit)
@@ -124,6 +202,88 @@ int RayTracerScene::FindIntersectionWithScene(RRay TestRay, RayHitResult& OutRes
 	return HitShapeIndex;
 }
 
+void RayTracerScene::FindIntersectionWithScene(RRayPacket TestPacket, RayHitResult OutResults[], int OutHitShapeIndices[]) const
+{
+	const int NumRays = TestPacket.GetNumRays();
+	const int LaneMask = TestPacket.GetLaneMask();
+
+	for (int Lane = 0; Lane < NumRays; Lane++)
+	{
+		OutHitShapeIndices[Lane] = -1;
+	}
+
+	ThreadTracedRayCount += NumRays;
+	TRAVERSAL_STAT_ADD(Rays, NumRays);
+
+	int Index = 0;
+
+	// Get nearest hit point for every ray
+	for (auto& Shape : SceneShapes)
+	{
+		int ShapeLaneMask = LaneMask;
+
+		if (Shape->HasCullingBounds())
+		{
+			TRAVERSAL_STAT_ADD(AabbTests, CountLanes(LaneMask));
+			ShapeLaneMask = TestPacket.TestIntersectionWithAabb(RAabbA(Shape->GetBounds()), LaneMask);
+		}
+
+		if (ShapeLaneMask != 0)
+		{
+			TRAVERSAL_STAT_ADD(ShapesTested, CountLanes(ShapeLaneMask));
+
+			// Distances of hit rays are shortened by the shape
+			const int HitMask = Shape->TestPacketIntersection(TestPacket, ShapeLaneMask, OutResults);
+
+			for (int Lane = 0; Lane < NumRays; Lane++)
+			{
+				if (HitMask & (1 << Lane))
+				{
+					OutHitShapeIndices[Lane] = Index;
+				}
+			}
+		}
+
+		Index++;
+	}
+}
+
+long long RayTracerScene::GetThreadTracedRayCount()
+{
+	return ThreadTracedRayCount;
+}
+
+int RayTracerScene::GetNumShapes() const
+{
+	return (int)SceneShapes.size();
+}
+
+int RayTracerScene::GetShapeMaterialIndex(int ShapeIndex) const
+{
+	return ShapeMaterialIndices[ShapeIndex];
+}
+
+const MaterialTable& RayTracerScene::GetMaterialTable() const
+{
+	return Materials;
+}
+
+RVec3 RayTracerScene::GetSkyColor(const RVec3& Direction)
+{
+	float t = 0.5f * (Direction.y + 1.0f);
+	return (1.0f - t) * RVec3(1.0f, 1.0f, 1.0f) + t * RVec3(0.5f, 0.7f, 1.0f);
+}
+
+void RayTracerScene::SampleHitTexture(RayHitResult& Result)
+{
+	if (Result.Texture)
+	{
+		RVec4 SampledColor = Result.Texture->Sample(Result.Texcoord.x, Result.Texcoord.y, Result.TextureLod);
+		Result.SampledColor = SampledColor.ToVec3();
+		Result.SampledAlpha = SampledColor.w;
+	}
+}
+
 RVec3 RayTracerScene::CalculateLightColor(const LightData* InLight, const RayHitResult &InHitResult, const RVec3& InSurfaceColor) const
 {
 	RVec3 LightDirection = InLight->PositionOrDirection;
@@ -29,8 +29,13 @@ struct RenderOption
 	// Do not ray trace. Use geometry color for a fast preview pass.
 	bool UseBaseColor;
 
+	// Width of the square block of display pixels covered by each rendered pixel.
+	// Larger pixels give a quick preview at reduced resolution, written to display pixels without accumulation.
+	int PreviewPixelSize;
+
 	RenderOption()
 		: UseBaseColor(false)
+		, PreviewPixelSize(1)
 	{}
 };
 
@@ -48,15 +53,56 @@ public:
 	// Add a shape to scene
 	void AddShape(unique_ptr<RShape> Shape, unique_ptr<ISurfaceMaterial> SurfaceMaterial);
 
+	// Replace surface material of a shape. Only the material table is rebuilt, geometry is kept.
+	void SetShapeMaterial(int ShapeIndex, unique_ptr<ISurfaceMaterial> SurfaceMaterial);
+
+	// Move a shape by an offset. Only world bounds of the shape are updated, acceleration structures of meshes are kept.
+	void MoveShape(int ShapeIndex, const RVec3& Offset);
+
 	// Run the ray tracing along a ray and get the color
 	RVec3 RayTrace(const RRay& InRay, int MaxBounceTimes, const RenderOption& InOption = RenderOption()) const;
 
+	// Run the ray tracing for all rays of a packet. Intersections are found for the whole packet, then rays are shaded one by one.
+	void RayTracePacket(const RRayPacket& InPacket, int MaxBounceTimes, RVec3 OutColors[], const RenderOption& InOption = RenderOption()) const;
+
 	// Test a ray against the scene and find intersection result
 	int FindIntersectionWithScene(RRay TestRay, RayHitResult& OutResult) const;
 
+	// Test all rays of a packet against the scene. Outputs index of the hit shape for each ray, -1 if nothing is hit.
+	void FindIntersectionWithScene(RRayPacket TestPacket, RayHitResult OutResults[], int OutHitShapeIndices[]) const;
+
+	// Get number of rays the calling thread has tested against any scene
+	static long long GetThreadTracedRayCount();
+
+	// Number of shapes in the scene
+	int GetNumShapes() const;
+
+	// Get index of a shape's material in the material table, -1 if the shape has no material
+	int GetShapeMaterialIndex(int ShapeIndex) const;
+
+	// Materials of all shapes flattened when shapes are added
+	const MaterialTable& GetMaterialTable() const;
+
+	// Color of rays that leave the scene without hitting anything
+	static RVec3 GetSkyColor(const RVec3& Direction);
+
+	// Sample texture of a hit into its sampled color and alpha
+	static void SampleHitTexture(RayHitResult& Result);
+
 protected:
+	// Flatten materials of all shapes into the material table again
+	void RebuildMaterialTable();
+
+	// Get color of a ray from its intersection with the scene
+	RVec3 ShadeHit(const RRay& InRay, int HitShapeIndex, const RayHitResult& Result, int MaxBounceTimes, const RenderOption& InOption) const;
+
 	RVec3 CalculateLightColor(const LightData* InLight, const RayHitResult &InHitResult, const RVec3& InSurfaceColor) const;
 
 private:
 	std::vector<unique_ptr<RShape>> SceneShapes;
+
+	MaterialTable Materials;
+
+	// Material record of each shape
+	std::vector<int> ShapeMaterialIndices;
 };
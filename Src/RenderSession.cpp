@@ -0,0 +1,96 @@
+//=============================================================================
+// RenderSession.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "RenderSession.h"
+
+#include "Math.h"
+
+namespace
+{
+	// Default width of preview pixels. Previews trace one sixteenth of the camera rays of a sample pass.
+	const int DefaultPreviewPixelSize = 4;
+}
+
+RenderSession::RenderSession(RayTracerScene& InScene, RayTracerRenderer& InRenderer)
+	: Scene(InScene)
+	, Renderer(InRenderer)
+	, bCameraChanged(false)
+	, PreviewPixelSize(DefaultPreviewPixelSize)
+	, NumAccumulatedPasses(0)
+{
+}
+
+void RenderSession::SetCamera(const RCamera& InCamera)
+{
+	std::lock_guard<std::mutex> Lock(EditMutex);
+	bCameraChanged = true;
+	PendingCamera = InCamera;
+}
+
+void RenderSession::SetShapeMaterial(int ShapeIndex, unique_ptr<ISurfaceMaterial> InMaterial)
+{
+	std::lock_guard<std::mutex> Lock(EditMutex);
+	PendingMaterialEdits.push_back(MaterialEdit(ShapeIndex, std::move(InMaterial)));
+}
+
+void RenderSession::MoveShape(int ShapeIndex, const RVec3& Offset)
+{
+	std::lock_guard<std::mutex> Lock(EditMutex);
+	PendingMoveEdits.push_back(MoveEdit(ShapeIndex, Offset));
+}
+
+bool RenderSession::RenderNextPass()
+{
+	if (ApplyPendingEdits())
+	{
+		// Samples of the old scene no longer match, start a new image
+		Renderer.ResetAccumulation();
+		NumAccumulatedPasses = 0;
+
+		RenderOption PreviewOption;
+		PreviewOption.PreviewPixelSize = PreviewPixelSize;
+		Renderer.RenderPass(PreviewOption);
+
+		return true;
+	}
+
+	Renderer.RenderPass();
+	NumAccumulatedPasses++;
+
+	return false;
+}
+
+void RenderSession::SetPreviewPixelSize(int InPixelSize)
+{
+	PreviewPixelSize = Math::Max(InPixelSize, 1);
+}
+
+bool RenderSession::ApplyPendingEdits()
+{
+	std::lock_guard<std::mutex> Lock(EditMutex);
+
+	const bool bHasEdits = bCameraChanged || !PendingMaterialEdits.empty() || !PendingMoveEdits.empty();
+
+	if (bCameraChanged)
+	{
+		Renderer.SetCamera(PendingCamera);
+		bCameraChanged = false;
+	}
+
+	for (MaterialEdit& Edit : PendingMaterialEdits)
+	{
+		Scene.SetShapeMaterial(Edit.ShapeIndex, std::move(Edit.Material));
+	}
+	PendingMaterialEdits.clear();
+
+	for (const MoveEdit& Edit : PendingMoveEdits)
+	{
+		Scene.MoveShape(Edit.ShapeIndex, Edit.Offset);
+	}
+	PendingMoveEdits.clear();
+
+	return bHasEdits;
+}
@@ -0,0 +1,92 @@
+//=============================================================================
+// RenderSession.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "Camera.h"
+#include "RayTracerRenderer.h"
+#include "RayTracerScene.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Interactive rendering of a scene that is edited while being rendered.
+// Edits may be requested from any thread and are applied between passes, keeping everything they don't affect:
+// moving the camera only restarts accumulation, material edits only rebuild the material table and
+// moving a shape never rebuilds the scene. Mesh instances only update their transform and bounds, bare meshes move
+// their vertices and refit their tree. A quick preview at reduced resolution is rendered after edits.
+class RenderSession
+{
+public:
+	RenderSession(RayTracerScene& InScene, RayTracerRenderer& InRenderer);
+
+	// Move the camera
+	void SetCamera(const RCamera& InCamera);
+
+	// Replace surface material of a shape
+	void SetShapeMaterial(int ShapeIndex, unique_ptr<ISurfaceMaterial> InMaterial);
+
+	// Move a shape by an offset
+	void MoveShape(int ShapeIndex, const RVec3& Offset);
+
+	// Apply pending edits and render a preview if there were any, or else accumulate another sample pass.
+	// Returns true if a preview was rendered. Must be called by the thread running passes of the renderer.
+	bool RenderNextPass();
+
+	// Set width of the square block of display pixels covered by each preview pixel
+	void SetPreviewPixelSize(int InPixelSize);
+
+	// Number of sample passes accumulated since the last edit
+	int GetNumAccumulatedPasses() const;
+
+private:
+	struct MaterialEdit
+	{
+		MaterialEdit(int InShapeIndex, unique_ptr<ISurfaceMaterial> InMaterial)
+			: ShapeIndex(InShapeIndex)
+			, Material(std::move(InMaterial))
+		{
+		}
+
+		int ShapeIndex;
+		unique_ptr<ISurfaceMaterial> Material;
+	};
+
+	struct MoveEdit
+	{
+		MoveEdit(int InShapeIndex, const RVec3& InOffset)
+			: ShapeIndex(InShapeIndex)
+			, Offset(InOffset)
+		{
+		}
+
+		int ShapeIndex;
+		RVec3 Offset;
+	};
+
+	// Apply all queued edits to the scene and renderer. Returns true if there were any.
+	bool ApplyPendingEdits();
+
+	RayTracerScene& Scene;
+	RayTracerRenderer& Renderer;
+
+	// Edits queued since the last pass
+	std::mutex EditMutex;
+	bool bCameraChanged;
+	RCamera PendingCamera;
+	std::vector<MaterialEdit> PendingMaterialEdits;
+	std::vector<MoveEdit> PendingMoveEdits;
+
+	int PreviewPixelSize;
+	int NumAccumulatedPasses;
+};
+
+
+FORCEINLINE int RenderSession::GetNumAccumulatedPasses() const
+{
+	return NumAccumulatedPasses;
+}
@@ -0,0 +1,114 @@
+//=============================================================================
+// SceneSetup.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "SceneSetup.h"
+
+#include "RayTracerScene.h"
+#include "Shapes.h"
+#include "MeshShape.h"
+
+template<typename T, typename ...Args>
+std::unique_ptr<T> MakeUnique(Args&&... args)
+{
+    return std::move(std::unique_ptr<T>(new T(std::forward<Args>(args)...)));
+}
+
+namespace SceneSetup
+{
+	void AddPrimitiveShapes(RayTracerScene& Scene)
+	{
+		Scene.AddShape(RSphere::Create(RVec3(1.5f, 2.5f, -2.0f), 0.9f),
+			MakeUnique<SurfaceMaterial_Blend>(
+				MakeUnique<SurfaceMaterial_Reflective>(),
+				MakeUnique<SurfaceMaterial_Diffuse>(RVec3(1.0f, 0.5f, 0.1f)),
+				0.5f)
+		);
+
+		Scene.AddShape(RSphere::Create(RVec3(-1.5f, -0.5f, -3.0f), 0.5f),
+			MakeUnique<SurfaceMaterial_Diffuse>(RVec3(0.1f, 1.0f, 0.2f))
+		);
+
+		Scene.AddShape(RSphere::Create(RVec3(0.8f, -1.5f, -1.0f), 0.5f),
+			MakeUnique<SurfaceMaterial_Blend>(
+				MakeUnique<SurfaceMaterial_Reflective>(),
+				MakeUnique<SurfaceMaterial_Diffuse>(RVec3(0.5f, 0.0f, 0.2f)),
+				0.5f)
+		);
+
+		Scene.AddShape(RSphere::Create(RVec3(2.8f, -1.2f, -4.0f), 1.5f),
+			MakeUnique<SurfaceMaterial_Combine>(
+				MakeUnique<SurfaceMaterial_Blend>(
+					MakeUnique<SurfaceMaterial_Reflective>(RVec3(0.95f, 0.75f, 0.1f)),
+					MakeUnique<SurfaceMaterial_Diffuse>(RVec3(0.95f, 0.75f, 0.1f)),
+					0.5f),
+				MakeUnique<SurfaceMaterial_Emissive>(RVec3(0.95f, 0.75f, 0.1f) * 0.5f)
+			)
+		);
+
+		//// Ceiling light
+		//Scene.AddShape(RSphere::Create(RVec3(0.0f, 5.0f, 0.0f), 0.5f),
+		//	MakeUnique<SurfaceMaterial_Emissive>(RVec3(5.0f, 2.0f, 6.0f))
+		//);
+
+		Scene.AddShape(RCapsule::Create(RVec3(-1.5f, -1.5f, -1.5f), RVec3(-2.0f, -1.5f, 0.0f), 0.5f),
+			MakeUnique<SurfaceMaterial_Blend>(
+				MakeUnique<SurfaceMaterial_Reflective>(RVec3(0.8f, 0.75f, 0.6f), 0.2f),
+				MakeUnique<SurfaceMaterial_Diffuse>(RVec3(0.25f, 0.75f, 0.6f)),
+				0.2f)
+		);
+
+		// Walls
+		{
+			// Ground
+			Scene.AddShape(RPlane::Create(RVec3(0.0f, 1.0f, 0.0f), RVec3(0.0f, -2.0f, 0.0f)),
+				MakeUnique<SurfaceMaterial_Blend>(
+					MakeUnique<SurfaceMaterial_Reflective>(RVec3(1, 1, 1), 0.1f),
+					MakeUnique<SurfaceMaterial_DiffuseChecker>(),
+					0.5f)
+			);
+
+			//// Ceiling / Sky light plane
+			//Scene.AddShape(RPlane::Create(RVec3(0.0f, -1.0f, 0.0f), RVec3(0.0f, 5.0f, 0.0f)),
+			//	MakeUnique<SurfaceMaterial_Diffuse>(RVec3(1.2f, 1.2f, 1.5f))
+			//);
+
+			//// Back wall
+			//Scene.AddShape(RPlane::Create(RVec3(0.0f, 0.0f, 1.0f), RVec3(0.0f, 0.0f, -5.0f)),
+			//	MakeUnique<SurfaceMaterial_DiffuseChecker>()
+			//);
+
+			//// Front wall (behind the camera)
+			//Scene.AddShape(RPlane::Create(RVec3(0.0f, 0.0f, -1.0f), RVec3(0.0f, 0.0f, 10.0f)),
+			//	MakeUnique<SurfaceMaterial_DiffuseChecker>()
+			//);
+
+			//// Right wall
+			//Scene.AddShape(RPlane::Create(RVec3(1.0f, 0.0f, 0.0f), RVec3(-5.0f, 0.0f, 0.0f)),
+			//	MakeUnique<SurfaceMaterial_DiffuseChecker>()
+			//);
+
+			//// Left wall
+			//Scene.AddShape(RPlane::Create(RVec3(-1.0f, 0.0f, 0.0f), RVec3(5.0f, 0.0f, 0.0f)),
+			//	MakeUnique<SurfaceMaterial_DiffuseChecker>()
+			//);
+		}
+	}
+
+	RMeshInstance* AddMesh(RayTracerScene& Scene, const std::string& Filename, const RTransform& Transform /*= RTransform()*/)
+	{
+		unique_ptr<RMeshInstance> Mesh = RMeshInstance::Create(Filename, Transform);
+		RMeshInstance* MeshInstance = Mesh.get();
+
+		Scene.AddShape(std::move(Mesh),
+			MakeUnique<SurfaceMaterial_Blend>(
+				MakeUnique<SurfaceMaterial_Reflective>(RVec3(1, 1, 1), 0.2f),
+				MakeUnique<SurfaceMaterial_Diffuse>(RVec3(1.0f, 1.0f, 1.0f)),
+				1.0f)
+		);
+
+		return MeshInstance;
+	}
+}
@@ -0,0 +1,25 @@
+//=============================================================================
+// SceneSetup.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "RTransform.h"
+
+#include <string>
+
+class RayTracerScene;
+class RMeshInstance;
+
+// Shapes of the reference scenes shared by the program and the benchmark
+namespace SceneSetup
+{
+	// Add spheres, capsule and the ground plane of the default scene
+	void AddPrimitiveShapes(RayTracerScene& Scene);
+
+	// Add an instance of a mesh from OBJ file to the scene with default surface material.
+	// Geometry is shared by all instances of the same file.
+	RMeshInstance* AddMesh(RayTracerScene& Scene, const std::string& Filename, const RTransform& Transform = RTransform());
+}
@@ -0,0 +1,189 @@
+//=============================================================================
+// SequenceRenderer.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "SequenceRenderer.h"
+
+#include "Math.h"
+#include "Profiler.h"
+
+#include <assert.h>
+#include <chrono>
+
+namespace
+{
+	double GetElapsedMs(const std::chrono::steady_clock::time_point& StartTime)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+	}
+
+	// Insert a keyframe after all keyframes of the same or earlier frames
+	template<typename T>
+	void InsertKeyframe(std::vector<T>& Keyframes, const T& Keyframe)
+	{
+		auto Iter = Keyframes.begin();
+		while (Iter != Keyframes.end() && Iter->Frame <= Keyframe.Frame)
+		{
+			++Iter;
+		}
+
+		Keyframes.insert(Iter, Keyframe);
+	}
+
+	// Find the keyframes around a frame and how far the frame is from the first one to the second one
+	template<typename T>
+	void FindKeyframes(const std::vector<T>& Keyframes, int Frame, int& OutIndexA, int& OutIndexB, float& OutAlpha)
+	{
+		assert(!Keyframes.empty());
+
+		int Next = 0;
+		while (Next < (int)Keyframes.size() && Keyframes[Next].Frame <= Frame)
+		{
+			Next++;
+		}
+
+		OutIndexA = Math::Max(Next - 1, 0);
+		OutIndexB = Math::Min(Next, (int)Keyframes.size() - 1);
+
+		const int FrameRange = Keyframes[OutIndexB].Frame - Keyframes[OutIndexA].Frame;
+		OutAlpha = FrameRange > 0 ? (float)(Frame - Keyframes[OutIndexA].Frame) / FrameRange : 0.0f;
+	}
+}
+
+void AnimationSequence::AddCameraKeyframe(int Frame, const RVec3& Position, const RVec3& Target)
+{
+	CameraKeyframe Keyframe;
+	Keyframe.Frame = Frame;
+	Keyframe.Position = Position;
+	Keyframe.Target = Target;
+
+	InsertKeyframe(CameraKeyframes, Keyframe);
+}
+
+void AnimationSequence::AddShapeKeyframe(int ShapeIndex, int Frame, const RVec3& Offset)
+{
+	OffsetKeyframe Keyframe;
+	Keyframe.Frame = Frame;
+	Keyframe.Offset = Offset;
+
+	for (ShapeTrack& Track : ShapeTracks)
+	{
+		if (Track.ShapeIndex == ShapeIndex)
+		{
+			InsertKeyframe(Track.Keyframes, Keyframe);
+			return;
+		}
+	}
+
+	ShapeTrack Track;
+	Track.ShapeIndex = ShapeIndex;
+	Track.Keyframes.push_back(Keyframe);
+	ShapeTracks.push_back(Track);
+}
+
+RCamera AnimationSequence::GetCamera(int Frame) const
+{
+	int a, b;
+	float Alpha;
+	FindKeyframes(CameraKeyframes, Frame, a, b, Alpha);
+
+	return RCamera::MakeLookAt(RVec3::Lerp(CameraKeyframes[a].Position, CameraKeyframes[b].Position, Alpha),
+							   RVec3::Lerp(CameraKeyframes[a].Target, CameraKeyframes[b].Target, Alpha));
+}
+
+RVec3 AnimationSequence::GetShapeOffset(int TrackIndex, int Frame) const
+{
+	const std::vector<OffsetKeyframe>& Keyframes = ShapeTracks[TrackIndex].Keyframes;
+
+	int a, b;
+	float Alpha;
+	FindKeyframes(Keyframes, Frame, a, b, Alpha);
+
+	return RVec3::Lerp(Keyframes[a].Offset, Keyframes[b].Offset, Alpha);
+}
+
+SequenceRenderer::SequenceRenderer(RayTracerScene& InScene, RayTracerRenderer& InRenderer)
+	: Scene(InScene)
+	, Renderer(InRenderer)
+{
+}
+
+SequenceStats SequenceRenderer::RenderFrames(const AnimationSequence& Sequence, int FirstFrame, int LastFrame, int PassesPerFrame, const std::string& FilenamePrefix)
+{
+	SequenceStats Stats;
+
+	const RCamera InitialCamera = Renderer.GetCamera();
+	AppliedShapeOffsets.assign(Sequence.GetNumShapeTracks(), RVec3::Zero());
+
+	const auto StartTime = std::chrono::steady_clock::now();
+
+	for (int Frame = FirstFrame; Frame <= LastFrame; Frame++)
+	{
+		PROFILE_SCOPE_ARG("RenderFrame", Frame);
+
+		SetupFrame(Sequence, Frame);
+		Renderer.ResetAccumulation();
+
+		const auto RenderStartTime = std::chrono::steady_clock::now();
+		for (int Pass = 0; Pass < PassesPerFrame; Pass++)
+		{
+			Renderer.RenderPass();
+		}
+		Stats.RenderTimeMs += GetElapsedMs(RenderStartTime);
+
+		// Passes have been aborted, the frame is incomplete
+		if (Renderer.IsStopping())
+		{
+			break;
+		}
+
+		Renderer.ResolveAccumulationBuffer();
+
+		char FrameNumber[16];
+		RPrintf(FrameNumber, sizeof(FrameNumber), "%04d", Frame);
+
+		// Returns as soon as the previous frame is taken by the writer, the next frame is rendered while this one is written
+		const auto WriteStartTime = std::chrono::steady_clock::now();
+		Writer.WriteImage(FilenamePrefix + FrameNumber + ImageEncoder::GetFileExtension(Writer.GetEncodeOptions().Format), Renderer.GetPixelBuffer(), bitmapWidth, bitmapHeight);
+		Stats.WriteWaitTimeMs += GetElapsedMs(WriteStartTime);
+
+		Stats.NumFrames++;
+	}
+
+	Writer.Flush();
+
+	Stats.TotalTimeMs = GetElapsedMs(StartTime);
+
+	// Leave the scene as it was before the sequence
+	for (int Track = 0; Track < Sequence.GetNumShapeTracks(); Track++)
+	{
+		Scene.MoveShape(Sequence.GetShapeTrackShapeIndex(Track), -AppliedShapeOffsets[Track]);
+	}
+	Renderer.SetCamera(InitialCamera);
+
+	if (Writer.GetNumFailedImages() > 0)
+	{
+		RLog("Failed to save %d frames of the sequence!\n", Writer.GetNumFailedImages());
+	}
+
+	return Stats;
+}
+
+void SequenceRenderer::SetupFrame(const AnimationSequence& Sequence, int Frame)
+{
+	if (Sequence.HasCameraKeyframes())
+	{
+		Renderer.SetCamera(Sequence.GetCamera(Frame));
+	}
+
+	// Shapes are moved by the change of their offsets. Mesh instances only update their transform and bounds,
+	// bare meshes move their vertices and refit their kd-tree.
+	for (int Track = 0; Track < Sequence.GetNumShapeTracks(); Track++)
+	{
+		const RVec3 Offset = Sequence.GetShapeOffset(Track, Frame);
+		Scene.MoveShape(Sequence.GetShapeTrackShapeIndex(Track), Offset - AppliedShapeOffsets[Track]);
+		AppliedShapeOffsets[Track] = Offset;
+	}
+}
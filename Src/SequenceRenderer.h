@@ -0,0 +1,137 @@
+//=============================================================================
+// SequenceRenderer.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "Camera.h"
+#include "ImageWriter.h"
+#include "RayTracerRenderer.h"
+#include "RayTracerScene.h"
+
+#include <string>
+#include <vector>
+
+// Camera and shape motion of an animation. Values are interpolated linearly between keyframes
+// and hold the value of the nearest keyframe outside of them.
+class AnimationSequence
+{
+public:
+	// Place the camera at a frame
+	void AddCameraKeyframe(int Frame, const RVec3& Position, const RVec3& Target);
+
+	// Offset a shape from its place in the scene at a frame
+	void AddShapeKeyframe(int ShapeIndex, int Frame, const RVec3& Offset);
+
+	bool HasCameraKeyframes() const;
+
+	// Get the camera at a frame. The sequence must have camera keyframes.
+	RCamera GetCamera(int Frame) const;
+
+	// Number of shapes moved by the sequence
+	int GetNumShapeTracks() const;
+
+	// Get index of the shape moved by a track
+	int GetShapeTrackShapeIndex(int TrackIndex) const;
+
+	// Get offset of the shape of a track at a frame
+	RVec3 GetShapeOffset(int TrackIndex, int Frame) const;
+
+private:
+	struct CameraKeyframe
+	{
+		int Frame;
+		RVec3 Position;
+		RVec3 Target;
+	};
+
+	struct OffsetKeyframe
+	{
+		int Frame;
+		RVec3 Offset;
+	};
+
+	struct ShapeTrack
+	{
+		int ShapeIndex;
+		std::vector<OffsetKeyframe> Keyframes;
+	};
+
+	// Keyframes are sorted by frame
+	std::vector<CameraKeyframe> CameraKeyframes;
+	std::vector<ShapeTrack> ShapeTracks;
+};
+
+// Timings of rendering a sequence
+struct SequenceStats
+{
+	SequenceStats()
+		: NumFrames(0)
+		, TotalTimeMs(0.0)
+		, RenderTimeMs(0.0)
+		, WriteWaitTimeMs(0.0)
+	{}
+
+	int NumFrames;
+
+	// Time of the whole sequence until the last frame is written
+	double TotalTimeMs;
+
+	// Time spent on sample passes
+	double RenderTimeMs;
+
+	// Time spent waiting for the image writer to accept frames
+	double WriteWaitTimeMs;
+};
+
+// Renders frames of an animation with a running renderer. Assets, acceleration structures and worker threads
+// are shared by all frames, only the camera and shape positions change between them. Shape tracks of mesh instances
+// only update their transform, tracks of bare meshes move the vertices and refit the kd-tree every frame.
+// Each frame is saved in the background while the next one is rendered.
+class SequenceRenderer
+{
+public:
+	SequenceRenderer(RayTracerScene& InScene, RayTracerRenderer& InRenderer);
+
+	// Render frames in range [FirstFrame, LastFrame] with a number of sample passes each.
+	// Frames are saved as <FilenamePrefix><4 digit frame number> with extension of the image format. Moved shapes and the camera are restored afterwards.
+	SequenceStats RenderFrames(const AnimationSequence& Sequence, int FirstFrame, int LastFrame, int PassesPerFrame, const std::string& FilenamePrefix);
+
+	// Set format and compression of saved frames
+	void SetEncodeOptions(const ImageEncodeOptions& InOptions);
+
+private:
+	// Move the camera and shapes to their place at a frame
+	void SetupFrame(const AnimationSequence& Sequence, int Frame);
+
+	RayTracerScene& Scene;
+	RayTracerRenderer& Renderer;
+
+	ImageWriter Writer;
+
+	// Offset applied to the shape of each track of the sequence being rendered
+	std::vector<RVec3> AppliedShapeOffsets;
+};
+
+
+FORCEINLINE bool AnimationSequence::HasCameraKeyframes() const
+{
+	return !CameraKeyframes.empty();
+}
+
+FORCEINLINE int AnimationSequence::GetNumShapeTracks() const
+{
+	return (int)ShapeTracks.size();
+}
+
+FORCEINLINE int AnimationSequence::GetShapeTrackShapeIndex(int TrackIndex) const
+{
+	return ShapeTracks[TrackIndex].ShapeIndex;
+}
+
+FORCEINLINE void SequenceRenderer::SetEncodeOptions(const ImageEncodeOptions& InOptions)
+{
+	Writer.SetEncodeOptions(InOptions);
+}
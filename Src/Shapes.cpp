@@ -15,11 +15,42 @@ ISurfaceMaterial* RShape::GetSurfaceMaterial()
 	return SurfaceMaterial.get();
 }
 
+void RShape::Translate(const RVec3& Offset)
+{
+	if (HasCullingBounds())
+	{
+		Aabb.pMin += Offset;
+		Aabb.pMax += Offset;
+	}
+}
+
+int RShape::TestPacketIntersection(RRayPacket& Packet, int LaneMask, RayHitResult OutResults[]) const
+{
+	int HitMask = 0;
+
+	for (int Lane = 0; Lane < Packet.GetNumRays(); Lane++)
+	{
+		if ((LaneMask & (1 << Lane)) && TestRayIntersection(Packet.GetRay(Lane), &OutResults[Lane]))
+		{
+			Packet.SetDistance(Lane, OutResults[Lane].Distance);
+			HitMask |= (1 << Lane);
+		}
+	}
+
+	return HitMask;
+}
+
 bool RSphere::TestRayIntersection(const RRay& InRay, RayHitResult* OutResult /*= nullptr*/) const
 {
     return InRay.TestIntersectionWithSphere(Center, Radius, OutResult);
 }
 
+void RSphere::Translate(const RVec3& Offset)
+{
+	Center += Offset;
+	RShape::Translate(Offset);
+}
+
 bool RPlane::TestRayIntersection(const RRay& InRay, RayHitResult* OutResult /*= nullptr*/) const
 {
 	return InRay.TestIntersectionWithPlane(Normal, Point, OutResult);
@@ -31,6 +62,11 @@ bool RPlane::HasCullingBounds() const
 	return false;
 }
 
+void RPlane::Translate(const RVec3& Offset)
+{
+	Point += Offset;
+}
+
 bool RCapsule::TestRayIntersection(const RRay& InRay, RayHitResult* OutResult /*= nullptr*/) const
 {
 	if (!TestRayCylinderIntersection(InRay, OutResult))
@@ -62,6 +98,13 @@ bool RCapsule::TestRayIntersection(const RRay& InRay, RayHitResult* OutResult /*
 	return true;
 }
 
+void RCapsule::Translate(const RVec3& Offset)
+{
+	Start += Offset;
+	End += Offset;
+	RShape::Translate(Offset);
+}
+
 bool RCapsule::TestRayCylinderIntersection(const RRay& InRay, RayHitResult* OutResult /*= nullptr*/) const
 {
     RVec3 d = End - Start; // vector from first point on cylinder segment to the end point on cylinder segment
@@ -102,7 +145,7 @@ bool RCapsule::TestRayCylinderIntersection(const RRay& InRay, RayHitResult* OutR
 
 	float r_t = (-b - sqrtf(b * b - a * c)) / a;
 
-	if (r_t < 0)
+	if (r_t < 0 || r_t > InRay.Distance)
 		return false;
 
 	RVec3 v = InRay.Origin + InRay.Direction * r_t;
@@ -128,3 +171,13 @@ bool RTriangle::TestRayIntersection(const RRay& InRay, RayHitResult* OutResult /
 {
 	return InRay.TestIntersectionWithTriangle(Points, OutResult);
 }
+
+void RTriangle::Translate(const RVec3& Offset)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		Points[i] += Offset;
+	}
+
+	RShape::Translate(Offset);
+}
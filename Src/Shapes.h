@@ -7,6 +7,7 @@
 
 #include "RVector.h"
 #include "RRay.h"
+#include "RRayPacket.h"
 #include "SurfaceMaterials.h"
 
 #include <memory>
@@ -21,6 +22,10 @@ public:
     
 	virtual bool TestRayIntersection(const RRay& InRay, RayHitResult* OutResult = nullptr) const { return false; }
 
+	// Test selected rays of a packet, rays that hit are shortened. Returns mask of rays that hit.
+	// Tests rays one by one unless overridden.
+	virtual int TestPacketIntersection(RRayPacket& Packet, int LaneMask, RayHitResult OutResults[]) const;
+
 	// Assign a surface material to the shape
 	void SetSurfaceMaterial(unique_ptr<ISurfaceMaterial> InMaterial);
 
@@ -32,6 +37,9 @@ public:
 
 	// Get the bounds of this shape for culling
 	const RAabb& GetBounds() const;
+
+	// Move the shape by an offset and update its bounds
+	virtual void Translate(const RVec3& Offset);
     
 protected:
 	// World bounding box of the shape
@@ -58,6 +66,8 @@ public:
 	static unique_ptr<RSphere> Create(const RVec3& InCenter, float InRadius) { return std::unique_ptr<RSphere>(new RSphere(InCenter, InRadius)); }
 
 	virtual bool TestRayIntersection(const RRay& InRay, RayHitResult* OutResult = nullptr) const override;
+
+	virtual void Translate(const RVec3& Offset) override;
 };
 
 // Plane
@@ -76,6 +86,8 @@ public:
 	virtual bool TestRayIntersection(const RRay& InRay, RayHitResult* OutResult = nullptr) const override;
 
 	virtual bool HasCullingBounds() const override;
+
+	virtual void Translate(const RVec3& Offset) override;
 };
 
 // Capsule
@@ -97,6 +109,8 @@ public:
 
 	virtual bool TestRayIntersection(const RRay& InRay, RayHitResult* OutResult = nullptr) const override;
 
+	virtual void Translate(const RVec3& Offset) override;
+
 protected:
 	bool TestRayCylinderIntersection(const RRay& InRay, RayHitResult* OutResult = nullptr) const;
 };
@@ -120,6 +134,8 @@ public:
 	static unique_ptr<RShape> Create(const RVec3& p0, const RVec3& p1, const RVec3& p2) { return std::unique_ptr<RTriangle>(new RTriangle(p0, p1, p2)); }
 
 	virtual bool TestRayIntersection(const RRay& InRay, RayHitResult* OutResult /* = nullptr */) const override;
+
+	virtual void Translate(const RVec3& Offset) override;
 };
 
 
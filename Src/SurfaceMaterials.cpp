@@ -12,6 +12,118 @@ using namespace std;
 
 float BounceRayStartOffset = 0.0001f;
 
+// Shading of each material type, shared by material classes and the flattened material table
+namespace
+{
+	ViewRayBounceResult BounceDiffuse(const RVec3& Albedo, const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay)
+	{
+		// The remaining distance ray will travel
+		float RayDistance = InViewRay.Distance - HitResult.Distance;
+
+		// Ray bounces off a surface in a random direction of a hemisphere
+		RVec3 DiffuseReflectionDirection = RMath::RandomHemisphereDirection(HitResult.HitNormal);
+		OutViewRay = RRay(HitResult.HitPosition + DiffuseReflectionDirection * BounceRayStartOffset, DiffuseReflectionDirection, RayDistance);
+
+		// Lambertian reflectance
+		float DotProductResult = Math::Max(0.0f, RVec3::Dot(HitResult.HitNormal, DiffuseReflectionDirection));
+
+		return ViewRayBounceResult(Albedo * DotProductResult);
+	}
+
+	RVec3 PreviewDiffuse(const RVec3& Albedo, const RayHitResult& HitResult)
+	{
+		return Albedo * (RVec3::Dot(HitResult.HitNormal, RVec3(0, 1, 0)) * 0.5f + 0.5f);
+	}
+
+	// Brightness of the checker pattern at a position
+	float GetCheckerFactor(const RVec3& WorldPosition, float ReciprocalPatternSize)
+	{
+		bool bResult = false;
+		float fx = WorldPosition.x * ReciprocalPatternSize;
+		float fy = WorldPosition.y * ReciprocalPatternSize;
+		float fz = WorldPosition.z * ReciprocalPatternSize;
+
+		if (fx - floorf(fx) > 0.5f)
+		{
+			bResult = !bResult;
+		}
+
+		if (fz - floorf(fz) > 0.5f)
+		{
+			bResult = !bResult;
+		}
+
+		if (fy - floorf(fy) > 0.5f)
+		{
+			bResult = !bResult;
+		}
+
+		return bResult ? 1.0f : 0.5f;
+	}
+
+	ViewRayBounceResult BounceDiffuseChecker(const RVec3& Albedo, float ReciprocalPatternSize, const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay)
+	{
+		float Factor = GetCheckerFactor(HitResult.HitPosition, ReciprocalPatternSize);
+		auto Result = BounceDiffuse(Albedo, InViewRay, HitResult, OutViewRay);
+		Result.Attenuation *= Factor;
+		return Result;
+	}
+
+	RVec3 PreviewDiffuseChecker(const RVec3& Albedo, float ReciprocalPatternSize, const RayHitResult& HitResult)
+	{
+		float Factor = GetCheckerFactor(HitResult.HitPosition, ReciprocalPatternSize);
+		return PreviewDiffuse(Albedo, HitResult) * Factor;
+	}
+
+	ViewRayBounceResult BounceReflective(const RVec3& Albedo, float Fuzziness, const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay)
+	{
+		//if (RVec3::Dot(InViewRay.Direction, HitResult.HitNormal) >= 0)
+		//{
+		//	return RVec3(0, 0, 0);
+		//}
+
+		// The remaining distance ray will travel
+		float RayDistance = InViewRay.Distance - HitResult.Distance;
+
+		// The direction of reflection
+		RVec3 newDir = InViewRay.Direction.Reflect(HitResult.HitNormal);
+
+		if (Fuzziness > 0.0f)
+		{
+			newDir += RMath::RandomUnitVector() * Fuzziness;
+			newDir.Normalize();
+		}
+
+		OutViewRay = RRay(HitResult.HitPosition + newDir * BounceRayStartOffset, newDir, RayDistance);
+
+		return ViewRayBounceResult(Albedo);
+	}
+
+	ViewRayBounceResult BounceEmissive(const RVec3& Color, const RRay& InViewRay, RRay& OutViewRay)
+	{
+		OutViewRay = InViewRay;
+
+		// Use 0 attenuation so view ray will trace no further
+		return ViewRayBounceResult(RVec3(0, 0, 0), Color);
+	}
+
+	ViewRayBounceResult BounceNull(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay)
+	{
+		// The remaining distance ray will travel
+		float RayDistance = InViewRay.Distance - HitResult.Distance;
+
+		OutViewRay = RRay(HitResult.HitPosition + InViewRay.Direction * BounceRayStartOffset, InViewRay.Direction, RayDistance);
+
+		return ViewRayBounceResult(RVec3(1, 1, 1));
+	}
+
+	// Whether a blend chooses its first material for a sample
+	bool ChooseBlendMaterialA(float BlendFactor)
+	{
+		return RMath::Random() > BlendFactor;
+	}
+}
+
 SurfaceMaterial_Diffuse::SurfaceMaterial_Diffuse(const RVec3 InAlbedo /*= RVec3(1.0f, 1.0f, 1.0f)*/)
 	: Albedo(InAlbedo)
 {
@@ -19,22 +131,17 @@ SurfaceMaterial_Diffuse::SurfaceMaterial_Diffuse(const RVec3 InAlbedo /*= RVec3(
 
 ViewRayBounceResult SurfaceMaterial_Diffuse::BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const
 {
-	// The remaining distance ray will travel
-	float RayDistance = InViewRay.Distance - HitResult.Distance;
-
-	// Ray bounces off a surface in a random direction of a hemisphere
-	RVec3 DiffuseReflectionDirection = RMath::RandomHemisphereDirection(HitResult.HitNormal);
-	OutViewRay = RRay(HitResult.HitPosition + DiffuseReflectionDirection * BounceRayStartOffset, DiffuseReflectionDirection, RayDistance);
-
-	// Lambertian reflectance
-	float DotProductResult = Math::Max(0.0f, RVec3::Dot(HitResult.HitNormal, DiffuseReflectionDirection));
-
-	return ViewRayBounceResult(Albedo * DotProductResult);
+	return BounceDiffuse(Albedo, InViewRay, HitResult, OutViewRay);
 }
 
 RVec3 SurfaceMaterial_Diffuse::PreviewColor(const RayHitResult& HitResult) const
 {
-	return Albedo * (RVec3::Dot(HitResult.HitNormal, RVec3(0, 1, 0)) * 0.5f + 0.5f);
+	return PreviewDiffuse(Albedo, HitResult);
+}
+
+int SurfaceMaterial_Diffuse::AddToTable(MaterialTable& Table) const
+{
+	return Table.AddRecord(MaterialRecord(MRT_Diffuse, Albedo));
 }
 
 SurfaceMaterial_DiffuseChecker::SurfaceMaterial_DiffuseChecker(const RVec3 InAlbedo /*= RVec3(1.0f, 1.0f, 1.0f)*/, float InPatternSize /*= 5.0f*/)
@@ -52,41 +159,17 @@ SurfaceMaterial_DiffuseChecker::SurfaceMaterial_DiffuseChecker(const RVec3 InAlb
 
 ViewRayBounceResult SurfaceMaterial_DiffuseChecker::BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const
 {
-	float Factor = IsBrighterArea(HitResult.HitPosition) ? 1.0f : 0.5f;
-	auto Result = SurfaceMaterial_Diffuse::BounceViewRay(InViewRay, HitResult, OutViewRay);
-	Result.Attenuation *= Factor;
-	return Result;
+	return BounceDiffuseChecker(Albedo, ReciprocalPatternSize, InViewRay, HitResult, OutViewRay);
 }
 
 RVec3 SurfaceMaterial_DiffuseChecker::PreviewColor(const RayHitResult& HitResult) const
 {
-	float Factor = IsBrighterArea(HitResult.HitPosition) ? 1.0f : 0.5f;
-	return SurfaceMaterial_Diffuse::PreviewColor(HitResult) * Factor;
+	return PreviewDiffuseChecker(Albedo, ReciprocalPatternSize, HitResult);
 }
 
-bool SurfaceMaterial_DiffuseChecker::IsBrighterArea(const RVec3& WorldPosition) const
+int SurfaceMaterial_DiffuseChecker::AddToTable(MaterialTable& Table) const
 {
-	bool bResult = false;
-	float fx = WorldPosition.x * ReciprocalPatternSize;
-	float fy = WorldPosition.y * ReciprocalPatternSize;
-	float fz = WorldPosition.z * ReciprocalPatternSize;
-
-	if (fx - floorf(fx) > 0.5f)
-	{
-		bResult = !bResult;
-	}
-
-	if (fz - floorf(fz) > 0.5f)
-	{
-		bResult = !bResult;
-	}
-
-	if (fy - floorf(fy) > 0.5f)
-	{
-		bResult = !bResult;
-	}
-
-	return bResult;
+	return Table.AddRecord(MaterialRecord(MRT_DiffuseChecker, Albedo, ReciprocalPatternSize));
 }
 
 SurfaceMaterial_Reflective::SurfaceMaterial_Reflective(const RVec3 InAlbedo /*= RVec3(1.0f, 1.0f, 1.0f)*/, float InFuzziness /*= 0.0f*/)
@@ -97,26 +180,7 @@ SurfaceMaterial_Reflective::SurfaceMaterial_Reflective(const RVec3 InAlbedo /*=
 
 ViewRayBounceResult SurfaceMaterial_Reflective::BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const
 {
-	//if (RVec3::Dot(InViewRay.Direction, HitResult.HitNormal) >= 0)
-	//{
-	//	return RVec3(0, 0, 0);
-	//}
-
-	// The remaining distance ray will travel
-	float RayDistance = InViewRay.Distance - HitResult.Distance;
-
-	// The direction of reflection
-	RVec3 newDir = InViewRay.Direction.Reflect(HitResult.HitNormal);
-
-	if (Fuzziness > 0.0f)
-	{
-		newDir += RMath::RandomUnitVector() * Fuzziness;
-		newDir.Normalize();
-	}
-
-	OutViewRay = RRay(HitResult.HitPosition + newDir * BounceRayStartOffset, newDir, RayDistance);
-
-	return ViewRayBounceResult(Albedo);
+	return BounceReflective(Albedo, Fuzziness, InViewRay, HitResult, OutViewRay);
 }
 
 RVec3 SurfaceMaterial_Reflective::PreviewColor(const RayHitResult& HitResult) const
@@ -124,6 +188,11 @@ RVec3 SurfaceMaterial_Reflective::PreviewColor(const RayHitResult& HitResult) co
 	return Albedo;
 }
 
+int SurfaceMaterial_Reflective::AddToTable(MaterialTable& Table) const
+{
+	return Table.AddRecord(MaterialRecord(MRT_Reflective, Albedo, Fuzziness));
+}
+
 SurfaceMaterial_Emissive::SurfaceMaterial_Emissive(const RVec3 InColor)
 	: Color(InColor)
 {
@@ -131,10 +200,7 @@ SurfaceMaterial_Emissive::SurfaceMaterial_Emissive(const RVec3 InColor)
 
 ViewRayBounceResult SurfaceMaterial_Emissive::BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const
 {
-	OutViewRay = InViewRay;
-	
-	// Use 0 attenuation so view ray will trace no further
-	return ViewRayBounceResult(RVec3(0, 0, 0), Color);
+	return BounceEmissive(Color, InViewRay, OutViewRay);
 }
 
 RVec3 SurfaceMaterial_Emissive::PreviewColor(const RayHitResult& HitResult) const
@@ -142,6 +208,11 @@ RVec3 SurfaceMaterial_Emissive::PreviewColor(const RayHitResult& HitResult) cons
 	return Color;
 }
 
+int SurfaceMaterial_Emissive::AddToTable(MaterialTable& Table) const
+{
+	return Table.AddRecord(MaterialRecord(MRT_Emissive, Color));
+}
+
 SurfaceMaterial_Blend::SurfaceMaterial_Blend(unique_ptr<ISurfaceMaterial> InMaterialA, unique_ptr<ISurfaceMaterial> InMaterialB, float InBlendFactor)
 	: BlendMaterialA(std::move(InMaterialA))
 	, BlendMaterialB(std::move(InMaterialB))
@@ -152,12 +223,19 @@ SurfaceMaterial_Blend::SurfaceMaterial_Blend(unique_ptr<ISurfaceMaterial> InMate
 
 ViewRayBounceResult SurfaceMaterial_Blend::BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const
 {
-	return RMath::Random() > BlendFactor ? BlendMaterialA->BounceViewRay(InViewRay, HitResult, OutViewRay) : BlendMaterialB->BounceViewRay(InViewRay, HitResult, OutViewRay);
+	return ChooseBlendMaterialA(BlendFactor) ? BlendMaterialA->BounceViewRay(InViewRay, HitResult, OutViewRay) : BlendMaterialB->BounceViewRay(InViewRay, HitResult, OutViewRay);
 }
 
 RVec3 SurfaceMaterial_Blend::PreviewColor(const RayHitResult& HitResult) const
 {
-	return RMath::Random() > BlendFactor ? BlendMaterialA->PreviewColor(HitResult) : BlendMaterialB->PreviewColor(HitResult);
+	return ChooseBlendMaterialA(BlendFactor) ? BlendMaterialA->PreviewColor(HitResult) : BlendMaterialB->PreviewColor(HitResult);
+}
+
+int SurfaceMaterial_Blend::AddToTable(MaterialTable& Table) const
+{
+	const int IndexA = BlendMaterialA->AddToTable(Table);
+	const int IndexB = BlendMaterialB->AddToTable(Table);
+	return Table.AddRecord(MaterialRecord(MRT_Blend, RVec3(0, 0, 0), BlendFactor, IndexA, IndexB));
 }
 
 SurfaceMaterial_Combine::SurfaceMaterial_Combine(std::unique_ptr<ISurfaceMaterial> InMaterialA, std::unique_ptr<ISurfaceMaterial> InMaterialB)
@@ -168,25 +246,127 @@ SurfaceMaterial_Combine::SurfaceMaterial_Combine(std::unique_ptr<ISurfaceMateria
 
 ViewRayBounceResult SurfaceMaterial_Combine::BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const
 {
-	return MaterialA->BounceViewRay(InViewRay, HitResult, OutViewRay) + MaterialB->BounceViewRay(InViewRay, HitResult, OutViewRay);
+	// Bounced ray of the first material is kept
+	const ViewRayBounceResult ResultB = MaterialB->BounceViewRay(InViewRay, HitResult, OutViewRay);
+	return MaterialA->BounceViewRay(InViewRay, HitResult, OutViewRay) + ResultB;
 }
 
 RVec3 SurfaceMaterial_Combine::PreviewColor(const RayHitResult& HitResult) const
 {
-	return MaterialA->PreviewColor(HitResult) + MaterialB->PreviewColor(HitResult);
+	const RVec3 ColorB = MaterialB->PreviewColor(HitResult);
+	return MaterialA->PreviewColor(HitResult) + ColorB;
 }
 
-ViewRayBounceResult SurfaceMaterial_Null::BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const
+int SurfaceMaterial_Combine::AddToTable(MaterialTable& Table) const
 {
-	// The remaining distance ray will travel
-	float RayDistance = InViewRay.Distance - HitResult.Distance;
-
-	OutViewRay = RRay(HitResult.HitPosition + InViewRay.Direction * BounceRayStartOffset, InViewRay.Direction, RayDistance);
+	const int IndexA = MaterialA->AddToTable(Table);
+	const int IndexB = MaterialB->AddToTable(Table);
+	return Table.AddRecord(MaterialRecord(MRT_Combine, RVec3(0, 0, 0), 0.0f, IndexA, IndexB));
+}
 
-	return ViewRayBounceResult(RVec3(1, 1, 1));
+ViewRayBounceResult SurfaceMaterial_Null::BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const
+{
+	return BounceNull(InViewRay, HitResult, OutViewRay);
 }
 
 RVec3 SurfaceMaterial_Null::PreviewColor(const RayHitResult& HitResult) const
 {
 	return RVec3(0, 0, 0);
 }
+
+int SurfaceMaterial_Null::AddToTable(MaterialTable& Table) const
+{
+	return Table.AddRecord(MaterialRecord(MRT_Null));
+}
+
+void MaterialTable::Clear()
+{
+	Records.clear();
+}
+
+int MaterialTable::AddMaterial(const ISurfaceMaterial& Material)
+{
+	return Material.AddToTable(*this);
+}
+
+int MaterialTable::AddRecord(const MaterialRecord& Record)
+{
+	Records.push_back(Record);
+	return (int)Records.size() - 1;
+}
+
+int MaterialTable::GetNumRecords() const
+{
+	return (int)Records.size();
+}
+
+const MaterialRecord& MaterialTable::ResolveBlend(int MaterialIndex) const
+{
+	const MaterialRecord* Record = &Records[MaterialIndex];
+
+	while (Record->Type == MRT_Blend)
+	{
+		Record = &Records[ChooseBlendMaterialA(Record->Param) ? Record->ChildA : Record->ChildB];
+	}
+
+	return *Record;
+}
+
+ViewRayBounceResult MaterialTable::BounceViewRay(int MaterialIndex, const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const
+{
+	const MaterialRecord& Record = ResolveBlend(MaterialIndex);
+
+	switch (Record.Type)
+	{
+	case MRT_Diffuse:
+		return BounceDiffuse(Record.Color, InViewRay, HitResult, OutViewRay);
+
+	case MRT_DiffuseChecker:
+		return BounceDiffuseChecker(Record.Color, Record.Param, InViewRay, HitResult, OutViewRay);
+
+	case MRT_Reflective:
+		return BounceReflective(Record.Color, Record.Param, InViewRay, HitResult, OutViewRay);
+
+	case MRT_Emissive:
+		return BounceEmissive(Record.Color, InViewRay, OutViewRay);
+
+	case MRT_Combine:
+	{
+		// Bounced ray of the first material is kept
+		const ViewRayBounceResult ResultB = BounceViewRay(Record.ChildB, InViewRay, HitResult, OutViewRay);
+		return BounceViewRay(Record.ChildA, InViewRay, HitResult, OutViewRay) + ResultB;
+	}
+
+	case MRT_Null:
+	default:
+		return BounceNull(InViewRay, HitResult, OutViewRay);
+	}
+}
+
+RVec3 MaterialTable::PreviewColor(int MaterialIndex, const RayHitResult& HitResult) const
+{
+	const MaterialRecord& Record = ResolveBlend(MaterialIndex);
+
+	switch (Record.Type)
+	{
+	case MRT_Diffuse:
+		return PreviewDiffuse(Record.Color, HitResult);
+
+	case MRT_DiffuseChecker:
+		return PreviewDiffuseChecker(Record.Color, Record.Param, HitResult);
+
+	case MRT_Reflective:
+	case MRT_Emissive:
+		return Record.Color;
+
+	case MRT_Combine:
+	{
+		const RVec3 ColorB = PreviewColor(Record.ChildB, HitResult);
+		return PreviewColor(Record.ChildA, HitResult) + ColorB;
+	}
+
+	case MRT_Null:
+	default:
+		return RVec3(0, 0, 0);
+	}
+}
@@ -10,9 +10,12 @@
 #include "RRay.h"
 
 #include <memory>
+#include <vector>
 
 extern float BounceRayStartOffset;
 
+class MaterialTable;
+
 /// The result struct after a view ray bounces off a surface with materials
 struct ViewRayBounceResult
 {
@@ -42,6 +45,9 @@ public:
 
 	/// Get a preview color for this material used when rendering the base color
 	virtual RVec3 PreviewColor(const RayHitResult& HitResult) const = 0;
+
+	/// Add records of this material and all materials it uses to a flattened table. Returns index of the material's record.
+	virtual int AddToTable(MaterialTable& Table) const = 0;
 };
 
 /// Diffuse material
@@ -52,6 +58,7 @@ public:
 
 	virtual ViewRayBounceResult BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const override;
 	virtual RVec3 PreviewColor(const RayHitResult& HitResult) const override;
+	virtual int AddToTable(MaterialTable& Table) const override;
 
 protected:
 	RVec3 Albedo;
@@ -65,10 +72,9 @@ public:
 
 	virtual ViewRayBounceResult BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const override;
 	virtual RVec3 PreviewColor(const RayHitResult& HitResult) const override;
+	virtual int AddToTable(MaterialTable& Table) const override;
 
 private:
-	bool IsBrighterArea(const RVec3& WorldPosition) const;
-    
     // One divide pattern size
     float ReciprocalPatternSize;
 };
@@ -82,6 +88,7 @@ public:
 
 	virtual ViewRayBounceResult BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const override;
 	virtual RVec3 PreviewColor(const RayHitResult& HitResult) const override;
+	virtual int AddToTable(MaterialTable& Table) const override;
 private:
 	RVec3 Albedo;
 	float Fuzziness;
@@ -95,6 +102,7 @@ public:
 
 	virtual ViewRayBounceResult BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const override;
 	virtual RVec3 PreviewColor(const RayHitResult& HitResult) const override;
+	virtual int AddToTable(MaterialTable& Table) const override;
 
 private:
 	RVec3 Color;
@@ -109,6 +117,7 @@ public:
 
 	virtual ViewRayBounceResult BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const override;
 	virtual RVec3 PreviewColor(const RayHitResult& HitResult) const override;
+	virtual int AddToTable(MaterialTable& Table) const override;
 private:
 	std::unique_ptr<ISurfaceMaterial> BlendMaterialA;
 	std::unique_ptr<ISurfaceMaterial> BlendMaterialB;
@@ -122,6 +131,7 @@ public:
 
 	virtual ViewRayBounceResult BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const override;
 	virtual RVec3 PreviewColor(const RayHitResult& HitResult) const override;
+	virtual int AddToTable(MaterialTable& Table) const override;
 
 private:
 	std::unique_ptr<ISurfaceMaterial> MaterialA;
@@ -138,4 +148,72 @@ public:
 
 	virtual ViewRayBounceResult BounceViewRay(const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const override;
 	virtual RVec3 PreviewColor(const RayHitResult& HitResult) const override;
+	virtual int AddToTable(MaterialTable& Table) const override;
+};
+
+
+/// Types of records in a flattened material table
+enum EMaterialRecordType
+{
+	MRT_Diffuse,
+	MRT_DiffuseChecker,
+	MRT_Reflective,
+	MRT_Emissive,
+	MRT_Blend,
+	MRT_Combine,
+	MRT_Null,
+};
+
+/// A single material in a flattened material table. Materials using other materials refer to them by record index.
+struct MaterialRecord
+{
+	MaterialRecord(EMaterialRecordType InType, const RVec3& InColor = RVec3(0, 0, 0), float InParam = 0.0f, int InChildA = -1, int InChildB = -1)
+		: Type(InType)
+		, Color(InColor)
+		, Param(InParam)
+		, ChildA(InChildA)
+		, ChildB(InChildB)
+	{
+	}
+
+	EMaterialRecordType Type;
+
+	/// Albedo, or emissive color of emissive materials
+	RVec3 Color;
+
+	/// Fuzziness of reflective materials, reciprocal pattern size of checker materials, or blend factor of blend materials
+	float Param;
+
+	/// Records used by blend and combine materials
+	int ChildA;
+	int ChildB;
+};
+
+/// Surface materials flattened into an array of records. Materials are evaluated with a switch on record type
+/// instead of virtual calls, giving the same results as the material classes.
+class MaterialTable
+{
+public:
+	/// Remove all records
+	void Clear();
+
+	/// Add records of a material. Returns index of its record.
+	int AddMaterial(const ISurfaceMaterial& Material);
+
+	/// Add a single record. Returns its index.
+	int AddRecord(const MaterialRecord& Record);
+
+	int GetNumRecords() const;
+
+	/// Same as ISurfaceMaterial::BounceViewRay for the material of a record
+	ViewRayBounceResult BounceViewRay(int MaterialIndex, const RRay& InViewRay, const RayHitResult& HitResult, RRay& OutViewRay) const;
+
+	/// Same as ISurfaceMaterial::PreviewColor for the material of a record
+	RVec3 PreviewColor(int MaterialIndex, const RayHitResult& HitResult) const;
+
+private:
+	/// Follow blend records to the material chosen for a sample
+	const MaterialRecord& ResolveBlend(int MaterialIndex) const;
+
+	std::vector<MaterialRecord> Records;
 };
@@ -8,38 +8,272 @@
 #include "Platform.h"
 #include "Math.h"
 #include "ColorBuffer.h"
+#include "Profiler.h"
 
 #include <math.h>
+#include <assert.h>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
 
 #include "png.h"
 
+namespace
+{
+	// Textures loaded by RTexture::LoadShared, released when the last user is destroyed
+	std::mutex SharedTexturesMutex;
+	std::unordered_map<std::string, std::weak_ptr<const RTexture>> SharedTextures;
+
+	// Default max memory used by resident texture pages
+	const size_t DefaultTextureMemoryBudget = (size_t)1024 * 1024 * 1024;
+
+	// Resident page of a texture
+	struct CachedTexturePage
+	{
+		const RTexture*	Texture;
+		int				PageIndex;
+	};
+
+	// Evicted page waiting for samplers to finish reading it
+	struct EvictedTexturePage
+	{
+		const UINT32*	Texels;
+		unsigned		Epoch;
+	};
+
+	// Texture cache state, only accessed when pages are loaded, evicted or released
+	std::mutex TextureCacheMutex;
+	std::vector<CachedTexturePage> ResidentPages;
+	std::vector<EvictedTexturePage> EvictedPages;
+	size_t ResidentPagesClockHand = 0;
+	size_t TextureMemoryBudget = DefaultTextureMemoryBudget;
+
+	// Pages read from page files since program start
+	std::atomic<long long> NumPageLoads(0);
+
+	// Max number of threads sampling textures at the same time
+	const int MaxSamplerThreads = 256;
+
+	// Advanced every time pages are evicted. Samplers announce the epoch they started sampling in,
+	// so evicted pages are only released after all samplers which could have read them are done.
+	std::atomic<unsigned> TextureCacheEpoch(1);
+	std::atomic<unsigned> SamplerEpochs[MaxSamplerThreads];
+	std::atomic<bool> SamplerSlotsUsed[MaxSamplerThreads];
+
+	// Epochs of samplers on threads which found no free slot. Much slower than slots, only used when there are too many threads.
+	std::mutex OverflowSamplerMutex;
+	std::vector<unsigned> OverflowSamplerEpochs;
+
+	// Slot of sampler epoch owned by a thread. Index is -1 when all slots are taken.
+	struct SamplerEpochSlot
+	{
+		SamplerEpochSlot()
+			: Index(-1)
+		{
+			for (int i = 0; i < MaxSamplerThreads && Index == -1; i++)
+			{
+				if (!SamplerSlotsUsed[i].exchange(true))
+				{
+					Index = i;
+				}
+			}
+
+			if (Index == -1)
+			{
+				RLog("Warning - More than %d threads sample textures, extra threads take a locked path\n", MaxSamplerThreads);
+			}
+		}
+
+		~SamplerEpochSlot()
+		{
+			if (Index != -1)
+			{
+				SamplerEpochs[Index].store(0);
+				SamplerSlotsUsed[Index].store(false);
+			}
+		}
+
+		int Index;
+	};
+
+	thread_local SamplerEpochSlot ThreadSamplerEpochSlot;
+
+	// Announce current thread is reading texture pages during its lifetime
+	class ScopedSamplerEpoch
+	{
+	public:
+		ScopedSamplerEpoch()
+			: Epoch(nullptr)
+			, OverflowEpoch(0)
+		{
+			const int SlotIndex = ThreadSamplerEpochSlot.Index;
+			if (SlotIndex != -1)
+			{
+				Epoch = &SamplerEpochs[SlotIndex];
+				Epoch->store(TextureCacheEpoch.load());
+			}
+			else
+			{
+				std::lock_guard<std::mutex> Lock(OverflowSamplerMutex);
+				OverflowEpoch = TextureCacheEpoch.load();
+				OverflowSamplerEpochs.push_back(OverflowEpoch);
+			}
+		}
+
+		~ScopedSamplerEpoch()
+		{
+			if (Epoch)
+			{
+				Epoch->store(0, std::memory_order_release);
+			}
+			else
+			{
+				std::lock_guard<std::mutex> Lock(OverflowSamplerMutex);
+				auto Iter = std::find(OverflowSamplerEpochs.begin(), OverflowSamplerEpochs.end(), OverflowEpoch);
+				*Iter = OverflowSamplerEpochs.back();
+				OverflowSamplerEpochs.pop_back();
+			}
+		}
+
+	private:
+		// Epoch slot of the thread, or nullptr when the thread has none
+		std::atomic<unsigned>* Epoch;
+
+		unsigned OverflowEpoch;
+	};
+
+	// Evicted pages can be released once every sampler started after they were evicted
+	void ReleaseEvictedPages()
+	{
+		unsigned OldestSamplerEpoch = TextureCacheEpoch.load();
+		for (int i = 0; i < MaxSamplerThreads; i++)
+		{
+			const unsigned Epoch = SamplerEpochs[i].load();
+			if (Epoch != 0 && Epoch < OldestSamplerEpoch)
+			{
+				OldestSamplerEpoch = Epoch;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> Lock(OverflowSamplerMutex);
+			for (unsigned Epoch : OverflowSamplerEpochs)
+			{
+				OldestSamplerEpoch = Math::Min(OldestSamplerEpoch, Epoch);
+			}
+		}
+
+		for (size_t i = 0; i < EvictedPages.size(); )
+		{
+			if (EvictedPages[i].Epoch < OldestSamplerEpoch)
+			{
+				delete [] EvictedPages[i].Texels;
+				EvictedPages[i] = EvictedPages.back();
+				EvictedPages.pop_back();
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+
+	// Sampled when texture pages can't be read from the page file, as large as RTexture pages
+	const UINT32 MissingPageTexels[1 << 12] = { 0 };
+
+	FORCEINLINE UINT32 PackTexel(png_byte r, png_byte g, png_byte b, png_byte a)
+	{
+		return (UINT32)r | ((UINT32)g << 8) | ((UINT32)b << 16) | ((UINT32)a << 24);
+	}
+}
+
 RTexture::RTexture()
 	: Width(0)
 	, Height(0)
+	, LodOffset(0.0f)
+	, MipTailLevel(0)
+	, NumPages(0)
+	, TailTexelCount(0)
+	, PageFile(nullptr)
+	, bLoaded(false)
+	, bLoadFailed(false)
 {
 
 }
 
-RVec4 RTexture::Sample(float u, float v)
+RTexture::~RTexture()
 {
-#if DEBUG_CHECK_NAN
-	if (isnan(u) || isnan(v))
 	{
-		RLog("Error: RTexture::Sample() - Detected NaN! (u = %f, v = %f)\n", u, v);
-		DebugBreak();
+		std::unique_lock<std::mutex> Lock(TextureCacheMutex);
+
+		for (size_t i = 0; i < ResidentPages.size(); )
+		{
+			if (ResidentPages[i].Texture == this)
+			{
+				ResidentPages[i] = ResidentPages.back();
+				ResidentPages.pop_back();
+			}
+			else
+			{
+				i++;
+			}
+		}
 	}
-#endif	// DEBUG_CHECK_NAN
 
-	// Clamp mode
-	//u = RMath::Clamp(u, 0.0f, 1.0f);
-	//v = RMath::Clamp(v, 0.0f, 1.0f);
+	for (int i = 0; i < NumPages; i++)
+	{
+		delete [] Pages[i].load();
+	}
+
+	if (PageFile)
+	{
+		fclose(PageFile);
+	}
+}
+
+FORCEINLINE RVec4 RTexture::DecodeTexel(UINT32 Texel)
+{
+	return RVec4(GammaByteToLinear(Texel & 0xFF),
+				 GammaByteToLinear((Texel >> 8) & 0xFF),
+				 GammaByteToLinear((Texel >> 16) & 0xFF),
+				 (float)(Texel >> 24) / 255);
+}
+
+FORCEINLINE const UINT32* RTexture::AcquirePage(int PageIndex) const
+{
+	const UINT32* Page = Pages[PageIndex].load();
+	if (!Page)
+	{
+		Page = LoadPage(PageIndex);
+	}
+
+	// Avoid writing to the shared cache line when it's already set
+	if (!PagesReferenced[PageIndex].load(std::memory_order_relaxed))
+	{
+		PagesReferenced[PageIndex].store(true, std::memory_order_relaxed);
+	}
+
+	return Page;
+}
+
+FORCEINLINE size_t RTexture::GetTexelIndex(const MipLevel& Level, int x, int y)
+{
+	const int TileIndex = (y >> TileSizeShift) * Level.TilesX + (x >> TileSizeShift);
+	const int TexelInTile = ((y & (TileSize - 1)) << TileSizeShift) + (x & (TileSize - 1));
+
+	return Level.Offset + TileIndex * TileSize * TileSize + TexelInTile;
+}
+
+RVec4 RTexture::SampleLevel(int LevelIndex, float u, float v) const
+{
+	const MipLevel& Level = MipLevels[LevelIndex];
 
 	// Repeat mode
 	float cu = u - floor(u);
 	float cv = v - floor(v);
 
-	float fx = cu * (Width - 1);
-	float fy = cv * (Height - 1);
+	float fx = cu * (Level.Width - 1);
+	float fy = cv * (Level.Height - 1);
 
 	int x0 = (int)floorf(fx);
 	int y0 = (int)floorf(fy);
@@ -49,17 +283,392 @@ RVec4 RTexture::Sample(float u, float v)
 	float dx = fx - x0;
 	float dy = fy - y0;
 
+	const size_t Index00 = GetTexelIndex(Level, x0, y0);
+	const size_t Index10 = GetTexelIndex(Level, x1, y0);
+	const size_t Index01 = GetTexelIndex(Level, x0, y1);
+	const size_t Index11 = GetTexelIndex(Level, x1, y1);
+
+	UINT32 Texel00, Texel10, Texel01, Texel11;
+
+	if (LevelIndex >= MipTailLevel)
+	{
+		Texel00 = TailTexels[Index00];
+		Texel10 = TailTexels[Index10];
+		Texel01 = TailTexels[Index01];
+		Texel11 = TailTexels[Index11];
+	}
+	else
+	{
+		// Taps usually fall in the same tile, only look up other pages when they don't
+		const int Page00 = (int)(Index00 >> PageSizeShift);
+		const UINT32* Page = AcquirePage(Page00);
+
+		Texel00 = Page[Index00 & (PageSize - 1)];
+		Texel10 = ((int)(Index10 >> PageSizeShift) == Page00 ? Page : AcquirePage((int)(Index10 >> PageSizeShift)))[Index10 & (PageSize - 1)];
+		Texel01 = ((int)(Index01 >> PageSizeShift) == Page00 ? Page : AcquirePage((int)(Index01 >> PageSizeShift)))[Index01 & (PageSize - 1)];
+		Texel11 = ((int)(Index11 >> PageSizeShift) == Page00 ? Page : AcquirePage((int)(Index11 >> PageSizeShift)))[Index11 & (PageSize - 1)];
+	}
+
 	return RVec4::Lerp(
-		RVec4::Lerp(Pixels[y0 * Width + x0], Pixels[y0 * Width + x1], dx),
-		RVec4::Lerp(Pixels[y1 * Width + x0], Pixels[y1 * Width + x1], dx),
+		RVec4::Lerp(DecodeTexel(Texel00), DecodeTexel(Texel10), dx),
+		RVec4::Lerp(DecodeTexel(Texel01), DecodeTexel(Texel11), dx),
 		dy
 	);
 }
 
+RVec4 RTexture::Sample(float u, float v, float Lod /*= 0.0f*/) const
+{
+#if DEBUG_CHECK_NAN
+	if (isnan(u) || isnan(v))
+	{
+		RLog("Error: RTexture::Sample() - Detected NaN! (u = %f, v = %f)\n", u, v);
+		DebugBreak();
+	}
+#endif	// DEBUG_CHECK_NAN
+
+	// Clamp mode
+	//u = RMath::Clamp(u, 0.0f, 1.0f);
+	//v = RMath::Clamp(v, 0.0f, 1.0f);
+
+	// Texture is decoded by the first sampler
+	if (!bLoaded.load(std::memory_order_acquire) && (bLoadFailed.load(std::memory_order_relaxed) || !LoadTexels()))
+	{
+		return RVec4(1.0f, 1.0f, 1.0f, 1.0f);
+	}
+
+	// Magnified textures and rays without footprint are sampled from base level
+	const int LastLevel = (int)MipLevels.size() - 1;
+	int Level = 0;
+	float LevelBlend = 0.0f;
+
+	if (Lod >= (float)LastLevel)
+	{
+		Level = LastLevel;
+	}
+	else if (Lod > 0.0f)
+	{
+		Level = (int)Lod;
+		LevelBlend = Lod - Level;
+	}
+
+	// Mip tail is always resident
+	if (Level >= MipTailLevel)
+	{
+		if (LevelBlend == 0.0f)
+		{
+			return SampleLevel(Level, u, v);
+		}
+
+		return RVec4::Lerp(SampleLevel(Level, u, v), SampleLevel(Level + 1, u, v), LevelBlend);
+	}
+
+	// Pages read here won't be released until the sampler is done
+	ScopedSamplerEpoch SamplerEpoch;
+
+	if (LevelBlend == 0.0f)
+	{
+		return SampleLevel(Level, u, v);
+	}
+
+	return RVec4::Lerp(SampleLevel(Level, u, v), SampleLevel(Level + 1, u, v), LevelBlend);
+}
+
+float RTexture::GetLodForFootprint(float UvFootprint) const
+{
+	if (!(UvFootprint > 0.0f))
+	{
+		return 0.0f;
+	}
+
+	return log2f(UvFootprint) + LodOffset;
+}
+
+void RTexture::SetMemoryBudget(size_t Bytes)
+{
+	std::unique_lock<std::mutex> Lock(TextureCacheMutex);
+	TextureMemoryBudget = Bytes;
+}
+
+size_t RTexture::GetResidentMemorySize()
+{
+	std::unique_lock<std::mutex> Lock(TextureCacheMutex);
+	return ResidentPages.size() * PageSize * sizeof(UINT32);
+}
+
+long long RTexture::GetNumPageLoads()
+{
+	return NumPageLoads.load(std::memory_order_relaxed);
+}
+
+bool RTexture::LoadTexels() const
+{
+	std::unique_lock<std::mutex> Lock(LoadMutex);
+
+	// Texture may have been loaded while waiting for the lock
+	if (bLoaded || bLoadFailed)
+	{
+		return bLoaded;
+	}
+
+	PROFILE_SCOPE("LoadTexture");
+
+	int width, height;
+	std::vector<UINT32> BaseTexels;
+	if (!DecodePNG(Filename, width, height, &BaseTexels) || width != Width || height != Height)
+	{
+		RLog("Unable to load texels of texture %s\n", Filename.c_str());
+		bLoadFailed = true;
+		return false;
+	}
+
+	std::vector<UINT32> MainTexels((size_t)NumPages * PageSize);
+	TailTexels.resize(TailTexelCount);
+
+	BuildMipChain(BaseTexels, MainTexels.data(), TailTexels.data());
+
+	// Pages are read back from a temporary file when they're needed, it's removed automatically when closed
+	if (NumPages > 0)
+	{
+		PageFile = tmpfile();
+		if (!PageFile || fwrite(MainTexels.data(), sizeof(UINT32), MainTexels.size(), PageFile) != MainTexels.size())
+		{
+			RLog("Unable to write pages of texture %s\n", Filename.c_str());
+			bLoadFailed = true;
+			return false;
+		}
+	}
+
+	bLoaded.store(true, std::memory_order_release);
+	return true;
+}
+
+const UINT32* RTexture::LoadPage(int PageIndex) const
+{
+	std::unique_lock<std::mutex> Lock(LoadMutex);
+
+	// Page may have been loaded while waiting for the lock
+	const UINT32* Page = Pages[PageIndex].load();
+	if (Page)
+	{
+		return Page;
+	}
+
+	UINT32* NewPage = new UINT32[PageSize];
+	if (fseek(PageFile, (long)PageIndex * PageSize * sizeof(UINT32), SEEK_SET) != 0 || fread(NewPage, sizeof(UINT32), PageSize, PageFile) != PageSize)
+	{
+		RLog("Unable to read page %d of texture %s\n", PageIndex, Filename.c_str());
+		delete [] NewPage;
+		return MissingPageTexels;
+	}
+
+	Pages[PageIndex].store(NewPage, std::memory_order_release);
+	AddPageToCache(PageIndex);
+
+	NumPageLoads.fetch_add(1, std::memory_order_relaxed);
+
+	return NewPage;
+}
+
+void RTexture::AddPageToCache(int PageIndex) const
+{
+	std::unique_lock<std::mutex> Lock(TextureCacheMutex);
+
+	CachedTexturePage NewPage;
+	NewPage.Texture = this;
+	NewPage.PageIndex = PageIndex;
+	ResidentPages.push_back(NewPage);
+
+	// Evict pages not referenced since the clock hand passed them last time, until memory fits in the budget
+	bool bEvicted = false;
+	while (ResidentPages.size() * PageSize * sizeof(UINT32) > TextureMemoryBudget && ResidentPages.size() > 1)
+	{
+		if (ResidentPagesClockHand >= ResidentPages.size())
+		{
+			ResidentPagesClockHand = 0;
+		}
+
+		const CachedTexturePage& Candidate = ResidentPages[ResidentPagesClockHand];
+		if (Candidate.Texture->PagesReferenced[Candidate.PageIndex].exchange(false, std::memory_order_relaxed))
+		{
+			ResidentPagesClockHand++;
+			continue;
+		}
+
+		EvictedTexturePage Evicted;
+		Evicted.Texels = Candidate.Texture->Pages[Candidate.PageIndex].exchange(nullptr);
+		Evicted.Epoch = TextureCacheEpoch.load();
+		EvictedPages.push_back(Evicted);
+
+		ResidentPages[ResidentPagesClockHand] = ResidentPages.back();
+		ResidentPages.pop_back();
+		bEvicted = true;
+	}
+
+	if (bEvicted)
+	{
+		TextureCacheEpoch++;
+	}
+
+	ReleaseEvictedPages();
+}
+
+void RTexture::InitMipLevels()
+{
+	MipLevels.clear();
+	MipTailLevel = -1;
+
+	size_t MainTexelCount = 0;
+	TailTexelCount = 0;
+
+	// Each level is padded to whole tiles
+	for (int w = Width, h = Height; ; w = Math::Max(w / 2, 1), h = Math::Max(h / 2, 1))
+	{
+		if (MipTailLevel == -1 && w <= MipTailSize && h <= MipTailSize)
+		{
+			MipTailLevel = (int)MipLevels.size();
+		}
+
+		size_t& TexelCount = (MipTailLevel == -1) ? MainTexelCount : TailTexelCount;
+
+		MipLevel Level;
+		Level.Width = w;
+		Level.Height = h;
+		Level.TilesX = (w + TileSize - 1) >> TileSizeShift;
+		Level.Offset = TexelCount;
+		MipLevels.push_back(Level);
+
+		TexelCount += (size_t)Level.TilesX * ((h + TileSize - 1) >> TileSizeShift) * TileSize * TileSize;
+
+		if (w == 1 && h == 1)
+		{
+			break;
+		}
+	}
+
+	NumPages = (int)((MainTexelCount + PageSize - 1) >> PageSizeShift);
+	Pages.reset(new std::atomic<const UINT32*>[NumPages]);
+	PagesReferenced.reset(new std::atomic<bool>[NumPages]);
+
+	for (int i = 0; i < NumPages; i++)
+	{
+		Pages[i].store(nullptr);
+		PagesReferenced[i].store(false);
+	}
+
+	LodOffset = 0.5f * log2f((float)Width * (float)Height);
+}
+
+void RTexture::BuildMipChain(const std::vector<UINT32>& BaseTexels, UINT32* OutMainTexels, UINT32* OutTailTexels) const
+{
+	// Row-major texels of the level being generated and the level above it
+	std::vector<UINT32> LevelTexels = BaseTexels;
+	std::vector<UINT32> PrevLevelTexels;
+
+	for (int LevelIndex = 0; LevelIndex < (int)MipLevels.size(); LevelIndex++)
+	{
+		const MipLevel& Level = MipLevels[LevelIndex];
+
+		if (LevelIndex > 0)
+		{
+			LevelTexels.swap(PrevLevelTexels);
+			LevelTexels.resize(Level.Width * Level.Height);
+
+			const MipLevel& PrevLevel = MipLevels[LevelIndex - 1];
+
+			// 2x2 box filter, colors are averaged in linear space. Odd last row and column of the level above are dropped.
+			for (int y = 0; y < Level.Height; y++)
+			{
+				for (int x = 0; x < Level.Width; x++)
+				{
+					const int x0 = Math::Min(x * 2, PrevLevel.Width - 1);
+					const int x1 = Math::Min(x * 2 + 1, PrevLevel.Width - 1);
+					const int y0 = Math::Min(y * 2, PrevLevel.Height - 1);
+					const int y1 = Math::Min(y * 2 + 1, PrevLevel.Height - 1);
+
+					const UINT32 Texel00 = PrevLevelTexels[y0 * PrevLevel.Width + x0];
+					const UINT32 Texel10 = PrevLevelTexels[y0 * PrevLevel.Width + x1];
+					const UINT32 Texel01 = PrevLevelTexels[y1 * PrevLevel.Width + x0];
+					const UINT32 Texel11 = PrevLevelTexels[y1 * PrevLevel.Width + x1];
+
+					RVec4 Color = (DecodeTexel(Texel00) + DecodeTexel(Texel10) + DecodeTexel(Texel01) + DecodeTexel(Texel11)) * 0.25f;
+					UINT32 Alpha = ((Texel00 >> 24) + (Texel10 >> 24) + (Texel01 >> 24) + (Texel11 >> 24) + 2) / 4;
+
+					LevelTexels[y * Level.Width + x] = PackTexel(LinearToGammaByte(Color.x), LinearToGammaByte(Color.y), LinearToGammaByte(Color.z), (png_byte)Alpha);
+				}
+			}
+		}
+
+		UINT32* OutTexels = (LevelIndex < MipTailLevel) ? OutMainTexels : OutTailTexels;
+		if (!OutTexels)
+		{
+			continue;
+		}
+
+		for (int y = 0; y < Level.Height; y++)
+		{
+			for (int x = 0; x < Level.Width; x++)
+			{
+				const int TileIndex = (y >> TileSizeShift) * Level.TilesX + (x >> TileSizeShift);
+				const int TexelInTile = ((y & (TileSize - 1)) << TileSizeShift) + (x & (TileSize - 1));
+
+				OutTexels[Level.Offset + TileIndex * TileSize * TileSize + TexelInTile] = LevelTexels[y * Level.Width + x];
+			}
+		}
+	}
+}
+
+std::shared_ptr<const RTexture> RTexture::LoadShared(const std::string& Filename)
+{
+	// Also held during loading, so concurrent requests of the same file don't load it twice
+	std::unique_lock<std::mutex> Lock(SharedTexturesMutex);
+
+	std::shared_ptr<const RTexture> Texture = SharedTextures[Filename].lock();
+	if (!Texture)
+	{
+		int width, height;
+		if (DecodePNG(Filename, width, height, nullptr))
+		{
+			std::shared_ptr<RTexture> NewTexture(new RTexture());
+			NewTexture->Filename = Filename;
+			NewTexture->Width = width;
+			NewTexture->Height = height;
+			NewTexture->InitMipLevels();
+
+			Texture = NewTexture;
+		}
+
+		SharedTextures[Filename] = Texture;
+	}
+
+	return Texture;
+}
+
 std::unique_ptr<RTexture> RTexture::LoadTexturePNG(const std::string& Filename)
 {
 	std::unique_ptr<RTexture> Texture;
 
+	int width, height;
+	if (DecodePNG(Filename, width, height, nullptr))
+	{
+		Texture = std::unique_ptr<RTexture>(new RTexture());
+		Texture->Filename = Filename;
+		Texture->Width = width;
+		Texture->Height = height;
+		Texture->InitMipLevels();
+
+		if (!Texture->LoadTexels())
+		{
+			Texture.reset();
+		}
+	}
+
+	return Texture;
+}
+
+bool RTexture::DecodePNG(const std::string& Filename, int& OutWidth, int& OutHeight, std::vector<UINT32>* OutTexels)
+{
+	bool bResult = false;
+
 	FILE* png_file = fopen(Filename.c_str(), "rb");
 	if (png_file)
 	{
@@ -93,8 +702,15 @@ std::unique_ptr<RTexture> RTexture::LoadTexturePNG(const std::string& Filename)
 						int color_type = png_get_color_type(png_ptr, info_ptr);
 						int bit_depth = png_get_bit_depth(png_ptr, info_ptr);
 
+						OutWidth = width;
+						OutHeight = height;
+
 						// Only support 8-bit RGB and RGBA formats For now
-						if ((color_type == 2 || color_type == 6) && bit_depth == 8)
+						if ((color_type == 2 || color_type == 6) && bit_depth == 8 && !OutTexels)
+						{
+							bResult = true;
+						}
+						else if ((color_type == 2 || color_type == 6) && bit_depth == 8)
 						{
 							int num_of_passes = png_set_interlace_handling(png_ptr);
 							png_read_update_info(png_ptr, info_ptr);
@@ -110,11 +726,8 @@ std::unique_ptr<RTexture> RTexture::LoadTexturePNG(const std::string& Filename)
 
 								png_read_image(png_ptr, row_ptrs);
 
-								Texture = std::unique_ptr<RTexture>(new RTexture());
-
-								Texture->Width = width;
-								Texture->Height = height;
-								Texture->Pixels.resize(width * height);
+								std::vector<UINT32>& BaseTexels = *OutTexels;
+								BaseTexels.resize(width * height);
 
 								if (color_type == 2)
 								{
@@ -126,9 +739,7 @@ std::unique_ptr<RTexture> RTexture::LoadTexturePNG(const std::string& Filename)
 											png_byte g = *(row_ptrs[y] + 3 * x + 1);
 											png_byte b = *(row_ptrs[y] + 3 * x + 2);
 
-											RVec3 Color((float)r / 255, (float)g / 255, (float)b / 255);
-											RVec3 LinearColor = GammaToLinear(Color);
-											Texture->Pixels[y * width + x] = RVec4(LinearColor, 1.0f);
+											BaseTexels[y * width + x] = PackTexel(r, g, b, 255);
 										}
 									}
 								}
@@ -143,12 +754,12 @@ std::unique_ptr<RTexture> RTexture::LoadTexturePNG(const std::string& Filename)
 											png_byte b = *(row_ptrs[y] + 4 * x + 2);
 											png_byte a = *(row_ptrs[y] + 4 * x + 3);
 
-											RVec3 Color((float)r / 255, (float)g / 255, (float)b / 255);
-											RVec3 LinearColor = GammaToLinear(Color);
-											Texture->Pixels[y * width + x] = RVec4(LinearColor, (float)a / 255);
+											BaseTexels[y * width + x] = PackTexel(r, g, b, a);
 										}
 									}
 								}
+
+								bResult = true;
                                 
                                 // Release memory
                                 for (int y = 0; y < height; y++)
@@ -177,6 +788,9 @@ std::unique_ptr<RTexture> RTexture::LoadTexturePNG(const std::string& Filename)
 				{
 					RLog("png_create_info_struct failed: %s\n", Filename.c_str());
 				}
+
+				// Textures may be decoded many times when they're evicted
+				png_destroy_read_struct(&png_ptr, info_ptr ? &info_ptr : nullptr, nullptr);
 			}
 			else
 			{
@@ -195,7 +809,7 @@ std::unique_ptr<RTexture> RTexture::LoadTexturePNG(const std::string& Filename)
 		RLog("File could not be opened for reading: %s\n", Filename.c_str());
 	}
 
-	return Texture;
+	return bResult;
 }
 
 bool RTexture::SaveBufferToPNG(const std::string& Filename, const UINT32* Pixels, int width, int height)
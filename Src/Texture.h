@@ -9,7 +9,10 @@
 #include "Platform.h"
 #include "RVector.h"
 
+#include <stdio.h>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -17,17 +20,117 @@ class RTexture
 {
 public:
 	RTexture();
+	~RTexture();
 
-	/// Sample a color by texture coordinate
-	RVec4 Sample(float u, float v);
+	/// Sample a color by texture coordinate. Lod selects the mip level, fractional values blend two adjacent levels.
+	RVec4 Sample(float u, float v, float Lod = 0.0f) const;
+
+	/// Get the mip level whose texels match a footprint of given size in texture coordinates
+	float GetLodForFootprint(float UvFootprint) const;
+
+	int GetNumMipLevels() const { return (int)MipLevels.size(); }
 
 	/// Load a texture from png
 	static std::unique_ptr<RTexture> LoadTexturePNG(const std::string& Filename);
+
+	/// Get a texture shared by all materials using the same file. Only the png header is read here,
+	/// texels are decoded when the texture is sampled the first time.
+	static std::shared_ptr<const RTexture> LoadShared(const std::string& Filename);
     
     static bool SaveBufferToPNG(const std::string& Filename, const UINT32* Pixels, int width, int height);
 
+	/// Memory used by texels of all mip levels in bytes, when the texture is fully resident
+	size_t GetMemorySize() const { return ((size_t)NumPages * PageSize + TailTexelCount) * sizeof(UINT32); }
+
+	/// Set max memory used by texture pages of all textures. Least recently used pages are evicted when it's exceeded.
+	static void SetMemoryBudget(size_t Bytes);
+
+	/// Memory used by texture pages currently resident
+	static size_t GetResidentMemorySize();
+
+	/// Number of pages read from page files by all textures
+	static long long GetNumPageLoads();
+
 private:
-	std::vector<RVec4>	Pixels;
+	/// Size and location of a mip level in the texel array it belongs to
+	struct MipLevel
+	{
+		int		Width;
+		int		Height;
+		int		TilesX;
+		size_t	Offset;
+	};
+
+	/// Texels are stored in square tiles of (1 << TileSizeShift) texels, so bilinear taps mostly stay in the same cache lines
+	static const int TileSizeShift = 3;
+	static const int TileSize = 1 << TileSizeShift;
+
+	/// Mip levels before the tail are split in pages of 64 tiles, which are loaded on demand and may be evicted
+	static const int PageSizeShift = 12;
+	static const int PageSize = 1 << PageSizeShift;
+
+	/// Mip levels no larger than this in both dimensions form the mip tail, which stays resident once loaded
+	static const int MipTailSize = 64;
+
+	/// Convert a texel to linear color
+	static RVec4 DecodeTexel(UINT32 Texel);
+
+	/// Read a png file. Only the image size is read if OutTexels is null.
+	static bool DecodePNG(const std::string& Filename, int& OutWidth, int& OutHeight, std::vector<UINT32>* OutTexels);
+
+	/// Get index of a texel in the texel array its mip level belongs to
+	static size_t GetTexelIndex(const MipLevel& Level, int x, int y);
+
+	/// Bilinear filtered sample from a single mip level
+	RVec4 SampleLevel(int LevelIndex, float u, float v) const;
+
+	/// Compute size and location of all mip levels from base level size
+	void InitMipLevels();
+
+	/// Generate mip levels from row-major base level texels and store them in tiles
+	void BuildMipChain(const std::vector<UINT32>& BaseTexels, UINT32* OutMainTexels, UINT32* OutTailTexels) const;
+
+	/// Decode the texture, keep its mip tail and write the other levels to the page file. Returns false if failed.
+	bool LoadTexels() const;
+
+	/// Get texels of a page, reading it from the page file if it's not resident
+	const UINT32* AcquirePage(int PageIndex) const;
+
+	/// Read a page from the page file and add it to the texture cache
+	const UINT32* LoadPage(int PageIndex) const;
+
+	/// Register a loaded page to the texture cache and evict other pages if budget is exceeded
+	void AddPageToCache(int PageIndex) const;
+
+	std::string Filename;
+
+	std::vector<MipLevel> MipLevels;
 	int	Width;
 	int Height;
+
+	/// Log2 of base level texels per unit of texture coordinate
+	float LodOffset;
+
+	/// Index of the first mip level stored in the tail
+	int MipTailLevel;
+	int NumPages;
+	size_t TailTexelCount;
+
+	/// 8-bit gamma space RGBA texels of resident pages, red in the lowest byte. Null if a page is not resident.
+	std::unique_ptr<std::atomic<const UINT32*>[]> Pages;
+
+	/// Set when a page is sampled, cleared by the texture cache when looking for pages to evict
+	std::unique_ptr<std::atomic<bool>[]> PagesReferenced;
+
+	/// Texels of the mip tail, written once before bLoaded is set
+	mutable std::vector<UINT32> TailTexels;
+
+	/// Temporary file holding tiled texels of all pages
+	mutable FILE* PageFile;
+
+	mutable std::atomic<bool> bLoaded;
+	mutable std::atomic<bool> bLoadFailed;
+
+	/// Held while decoding texture and reading pages
+	mutable std::mutex LoadMutex;
 };
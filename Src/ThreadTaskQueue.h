@@ -6,29 +6,32 @@
 
 #pragma once
 
-#include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <utility>
+#include <vector>
 
 template<typename T>
 class ThreadTaskQueue
 {
 public:
-	static ThreadTaskQueue<T>& Get()
+	ThreadTaskQueue()
+		: FirstTask(0)
+		, NumTasks(0)
+		, NumUnfinishedTasks(0)
+		, bQuit(false)
 	{
-		static ThreadTaskQueue<T> Instance;
-		return Instance;
 	}
 
 	// Add a task to task queue
-	void PushTask(T Task);
+	void PushTask(const T& Task);
 
 	// Get a task from task queue
 	bool PopTask(T* OutTask);
 
 	int GetNumTasks() const
 	{
-		return (int)EnqueuedTasks.size();
+		return NumTasks;
 	}
 
 	std::mutex& GetMutex()
@@ -41,15 +44,30 @@ public:
 		return WorkerThreadCondition;
 	}
 
+	// Has the queue been told to quit. Mutex must be locked when calling this.
+	bool IsQuitting() const
+	{
+		return bQuit;
+	}
+
 	// Notify the task queue about one task finished
 	void NotifySingleTaskDone()
 	{
+		{
+			std::lock_guard<std::mutex> Lock(QueueMutex);
+			NumUnfinishedTasks--;
+		}
+
 		QueueCondition.notify_one();
 	}
 
 	void NotifyQuit()
 	{
-		bQuit = true;
+		{
+			std::lock_guard<std::mutex> Lock(QueueMutex);
+			bQuit = true;
+		}
+
 		QueueCondition.notify_all();
 		WorkerThreadCondition.notify_all();
 	}
@@ -58,20 +76,21 @@ public:
 	{
 		std::unique_lock<std::mutex> ThreadLock(QueueMutex);
 
-		// Wait until task queue is empty
+		// Wait until all queued tasks are popped and finished by workers
 		QueueCondition.wait(ThreadLock, [this] {
-			return EnqueuedTasks.size() == 0 || bQuit;
+			return NumUnfinishedTasks == 0 || bQuit;
 		});
 	}
 
-protected:
-	ThreadTaskQueue()
-		: bQuit(false)
-	{
-	}
-
 private:
-	std::queue<T> EnqueuedTasks;
+	// Tasks are stored in a ring buffer, which only grows when it is full.
+	// Memory is reused by later passes.
+	std::vector<T> EnqueuedTasks;
+	int FirstTask;
+	int NumTasks;
+
+	// Number of tasks pushed but not yet reported as done
+	int NumUnfinishedTasks;
 	
 	// Mutex for queue accessing
 	std::mutex QueueMutex;
@@ -82,11 +101,28 @@ private:
 };
 
 template<typename T>
-void ThreadTaskQueue<T>::PushTask(T Task)
+void ThreadTaskQueue<T>::PushTask(const T& Task)
 {
 	{
 		std::lock_guard<std::mutex> Lock(QueueMutex);
-		EnqueuedTasks.push(Task);
+
+		const int Capacity = (int)EnqueuedTasks.size();
+		if (NumTasks == Capacity)
+		{
+			// Unwrap tasks to the front of a larger buffer
+			std::vector<T> Tasks(Capacity > 0 ? Capacity * 2 : 16);
+			for (int i = 0; i < NumTasks; i++)
+			{
+				Tasks[i] = std::move(EnqueuedTasks[(FirstTask + i) % Capacity]);
+			}
+
+			EnqueuedTasks.swap(Tasks);
+			FirstTask = 0;
+		}
+
+		EnqueuedTasks[(FirstTask + NumTasks) % (int)EnqueuedTasks.size()] = Task;
+		NumTasks++;
+		NumUnfinishedTasks++;
 	}
 
 	WorkerThreadCondition.notify_one();
@@ -95,10 +131,11 @@ void ThreadTaskQueue<T>::PushTask(T Task)
 template<typename T>
 bool ThreadTaskQueue<T>::PopTask(T* OutTask)
 {
-	if (!EnqueuedTasks.empty() && OutTask)
+	if (NumTasks > 0 && OutTask)
 	{
-		*OutTask = EnqueuedTasks.front();
-		EnqueuedTasks.pop();
+		*OutTask = std::move(EnqueuedTasks[FirstTask]);
+		FirstTask = (FirstTask + 1) % (int)EnqueuedTasks.size();
+		NumTasks--;
 		return true;
 	}
 
@@ -0,0 +1,76 @@
+//=============================================================================
+// TraversalStats.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "TraversalStats.h"
+#include "ColorBuffer.h"
+#include "Texture.h"
+
+#include <algorithm>
+#include <vector>
+
+#if ENABLE_TRAVERSAL_STATS
+thread_local TraversalCounters GThreadTraversalCounters;
+#endif
+
+namespace
+{
+	// Map [0, 1] to blue - cyan - green - yellow - red
+	RVec3 HeatmapColor(float t)
+	{
+		const int NumColors = 5;
+		static const RVec3 Colors[NumColors] =
+		{
+			RVec3(0.0f, 0.0f, 1.0f),
+			RVec3(0.0f, 1.0f, 1.0f),
+			RVec3(0.0f, 1.0f, 0.0f),
+			RVec3(1.0f, 1.0f, 0.0f),
+			RVec3(1.0f, 0.0f, 0.0f),
+		};
+
+		float f = Math::Min(Math::Max(t, 0.0f), 1.0f) * (NumColors - 1);
+		int Index = Math::Min((int)f, NumColors - 2);
+
+		return RVec3::Lerp(Colors[Index], Colors[Index + 1], f - Index);
+	}
+}
+
+namespace TraversalStats
+{
+	void LogCounters(const char* Title, const TraversalCounters& Counters)
+	{
+		const double Rays = (double)Math::Max(Counters.Rays, 1LL);
+
+		RLog("%s - Rays: %lld | Per ray - Shapes: %.2f, Nodes: %.2f, AABB tests: %.2f, Triangle tests: %.2f\n",
+			Title, Counters.Rays,
+			Counters.ShapesTested / Rays, Counters.NodesVisited / Rays, Counters.AabbTests / Rays, Counters.TriangleTests / Rays);
+	}
+
+	bool SaveHeatmapPNG(const std::string& Filename, const long long* PixelCosts, const int* PixelSamples, int Width, int Height)
+	{
+		const int NumPixels = Width * Height;
+		std::vector<float> AverageCosts(NumPixels);
+
+		for (int i = 0; i < NumPixels; i++)
+		{
+			AverageCosts[i] = PixelSamples[i] > 0 ? (float)PixelCosts[i] / PixelSamples[i] : 0.0f;
+		}
+
+		// Normalize by 99th percentile so a few expensive pixels don't wash out the image
+		std::vector<float> SortedCosts(AverageCosts);
+		const int PercentileIndex = (int)(NumPixels * 0.99f);
+		std::nth_element(SortedCosts.begin(), SortedCosts.begin() + PercentileIndex, SortedCosts.end());
+		const float MaxCost = Math::Max(SortedCosts[PercentileIndex], 1.0f);
+
+		std::vector<UINT32> Pixels(NumPixels);
+		for (int i = 0; i < NumPixels; i++)
+		{
+			Pixels[i] = MakePixelColor(HeatmapColor(AverageCosts[i] / MaxCost));
+		}
+
+		RLog("Saving traversal heatmap, red is %.1f cost per sample or more\n", MaxCost);
+		return RTexture::SaveBufferToPNG(Filename, Pixels.data(), Width, Height);
+	}
+}
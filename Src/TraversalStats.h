@@ -0,0 +1,79 @@
+//=============================================================================
+// TraversalStats.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "Platform.h"
+
+#include <string>
+
+// Count traversal work of rays for finding acceleration structure issues.
+// Counting code is compiled out when disabled.
+#define ENABLE_TRAVERSAL_STATS 0
+
+// Amount of work spent on traversing the scene
+struct TraversalCounters
+{
+	TraversalCounters()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		Rays = 0;
+		ShapesTested = 0;
+		NodesVisited = 0;
+		AabbTests = 0;
+		TriangleTests = 0;
+	}
+
+	TraversalCounters& operator+=(const TraversalCounters& rhs)
+	{
+		Rays += rhs.Rays;
+		ShapesTested += rhs.ShapesTested;
+		NodesVisited += rhs.NodesVisited;
+		AabbTests += rhs.AabbTests;
+		TriangleTests += rhs.TriangleTests;
+		return *this;
+	}
+
+	// Single number used for comparing cost of pixels
+	long long GetCost() const
+	{
+		return NodesVisited + TriangleTests + ShapesTested;
+	}
+
+	long long Rays;
+	long long ShapesTested;
+	long long NodesVisited;
+	long long AabbTests;
+	long long TriangleTests;
+};
+
+namespace TraversalStats
+{
+	// Log total and per ray counters
+	void LogCounters(const char* Title, const TraversalCounters& Counters);
+
+	// Save per-pixel traversal cost as a false color image
+	bool SaveHeatmapPNG(const std::string& Filename, const long long* PixelCosts, const int* PixelSamples, int Width, int Height);
+}
+
+#if ENABLE_TRAVERSAL_STATS
+
+// Counters of the calling thread
+extern thread_local TraversalCounters GThreadTraversalCounters;
+
+#define TRAVERSAL_STAT_INC(Counter)		{ GThreadTraversalCounters.Counter++; }
+#define TRAVERSAL_STAT_ADD(Counter, Value)	{ GThreadTraversalCounters.Counter += (Value); }
+
+#else
+
+#define TRAVERSAL_STAT_INC(Counter)
+#define TRAVERSAL_STAT_ADD(Counter, Value)
+
+#endif	// ENABLE_TRAVERSAL_STATS
@@ -0,0 +1,350 @@
+//=============================================================================
+// WavefrontPathTracer.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#include "WavefrontPathTracer.h"
+
+#include "Math.h"
+#include "RRayPacket.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+// Sort secondary rays by origin and direction before tracing them in packets
+#define USE_RAY_REORDERING 1
+
+namespace
+{
+	// Origins are quantized to a grid of 2^MortonBitsPerAxis cells per axis inside bounds of all origins
+	const int MortonBitsPerAxis = 9;
+
+	// Direction octant is stored above the Morton code of origin cell
+	const int RayKeyBits = MortonBitsPerAxis * 3 + 3;
+
+	// Bits sorted by each radix sort pass
+	const int RadixBits = 8;
+	const int RadixBuckets = 1 << RadixBits;
+
+	// Insert two zero bits between each of the lower 10 bits of a value
+	uint32_t SpreadBits(uint32_t Value)
+	{
+		Value = (Value | (Value << 16)) & 0x030000FF;
+		Value = (Value | (Value << 8)) & 0x0300F00F;
+		Value = (Value | (Value << 4)) & 0x030C30C3;
+		Value = (Value | (Value << 2)) & 0x09249249;
+		return Value;
+	}
+
+	// Quantize a coordinate to a grid cell
+	uint32_t GetCellCoord(float Value, float Min, float Scale)
+	{
+		const int MaxCoord = (1 << MortonBitsPerAxis) - 1;
+		return (uint32_t)Math::Min((int)((Value - Min) * Scale), MaxCoord);
+	}
+}
+
+void PathStateQueue::Clear()
+{
+	Rays.clear();
+	Throughputs.clear();
+	SampleIndices.clear();
+}
+
+void PathStateQueue::Reserve(int NumPaths)
+{
+	Rays.reserve(NumPaths);
+	Throughputs.reserve(NumPaths);
+	SampleIndices.reserve(NumPaths);
+}
+
+void PathStateQueue::Push(const RRay& InRay, const RVec3& InThroughput, int InSampleIndex)
+{
+	Rays.push_back(InRay);
+	Throughputs.push_back(InThroughput);
+	SampleIndices.push_back(InSampleIndex);
+}
+
+void WavefrontPathTracer::TracePaths(const RayTracerScene& Scene, const RRay CameraRays[], int NumRays, int MaxBounceTimes, RVec3 OutColors[], const RenderOption& InOption /*= RenderOption()*/)
+{
+	// Every path continues with at most one ray, so no buffer ever holds more entries than there are camera rays.
+	// Reserving them up front keeps later batches from allocating.
+	Paths.Reserve(NumRays);
+	NextPaths.Reserve(NumRays);
+	HitResults.reserve(NumRays);
+	HitShapeIndices.reserve(NumRays);
+	RayKeys.reserve(NumRays);
+	TempRayKeys.reserve(NumRays);
+	RayOrder.reserve(NumRays);
+	TempRayOrder.reserve(NumRays);
+	TextureOrder.reserve(NumRays);
+	ShadeOrder.reserve(NumRays);
+
+	// Generate
+	Paths.Clear();
+	for (int i = 0; i < NumRays; i++)
+	{
+		OutColors[i] = RVec3::Zero();
+		Paths.Push(CameraRays[i], RVec3(1.0f, 1.0f, 1.0f), i);
+	}
+
+#if ENABLE_TRAVERSAL_STATS
+	SampleTraversalCosts.assign(NumRays, 0);
+#endif
+
+	// Paths are traced until they leave the scene, get absorbed or run out of bounces
+	for (int BouncesLeft = MaxBounceTimes; BouncesLeft > 0 && Paths.GetNumPaths() > 0; BouncesLeft--)
+	{
+		const bool bCameraRays = (BouncesLeft == MaxBounceTimes);
+
+#if USE_RAY_REORDERING
+		// Camera rays are generated in coherent order
+		if (!bCameraRays)
+		{
+			ReorderPaths();
+		}
+
+		Extend(Scene, true);
+#else
+		// Only camera rays are coherent enough for packets
+		Extend(Scene, bCameraRays);
+#endif  // USE_RAY_REORDERING
+
+		SampleTextures();
+		SortByMaterial(Scene);
+		Shade(Scene, BouncesLeft, OutColors, InOption);
+
+		std::swap(Paths, NextPaths);
+	}
+}
+
+void WavefrontPathTracer::ReorderPaths()
+{
+	const int NumPaths = Paths.GetNumPaths();
+
+	RAabb OriginBounds;
+	for (const RRay& Ray : Paths.Rays)
+	{
+		OriginBounds.Expand(Ray.Origin);
+	}
+
+	const RVec3 Extent = OriginBounds.pMax - OriginBounds.pMin;
+	const float NumCells = (float)(1 << MortonBitsPerAxis);
+	const float ScaleX = Extent.x > 0.0f ? NumCells / Extent.x : 0.0f;
+	const float ScaleY = Extent.y > 0.0f ? NumCells / Extent.y : 0.0f;
+	const float ScaleZ = Extent.z > 0.0f ? NumCells / Extent.z : 0.0f;
+
+	RayKeys.resize(NumPaths);
+	RayOrder.resize(NumPaths);
+	for (int i = 0; i < NumPaths; i++)
+	{
+		const RRay& Ray = Paths.Rays[i];
+		const uint32_t CellX = GetCellCoord(Ray.Origin.x, OriginBounds.pMin.x, ScaleX);
+		const uint32_t CellY = GetCellCoord(Ray.Origin.y, OriginBounds.pMin.y, ScaleY);
+		const uint32_t CellZ = GetCellCoord(Ray.Origin.z, OriginBounds.pMin.z, ScaleZ);
+
+		RayKeys[i] = ((uint32_t)Ray.DirectionSignMask << (MortonBitsPerAxis * 3)) | (SpreadBits(CellX) << 2) | (SpreadBits(CellY) << 1) | SpreadBits(CellZ);
+		RayOrder[i] = i;
+	}
+
+	// Least significant digit radix sort, stable so rays with equal keys keep their order
+	TempRayKeys.resize(NumPaths);
+	TempRayOrder.resize(NumPaths);
+	for (int Shift = 0; Shift < RayKeyBits; Shift += RadixBits)
+	{
+		int BucketOffsets[RadixBuckets + 1] = { 0 };
+		for (int i = 0; i < NumPaths; i++)
+		{
+			BucketOffsets[((RayKeys[i] >> Shift) & (RadixBuckets - 1)) + 1]++;
+		}
+
+		for (int Bucket = 1; Bucket <= RadixBuckets; Bucket++)
+		{
+			BucketOffsets[Bucket] += BucketOffsets[Bucket - 1];
+		}
+
+		for (int i = 0; i < NumPaths; i++)
+		{
+			const int Dest = BucketOffsets[(RayKeys[i] >> Shift) & (RadixBuckets - 1)]++;
+			TempRayKeys[Dest] = RayKeys[i];
+			TempRayOrder[Dest] = RayOrder[i];
+		}
+
+		std::swap(RayKeys, TempRayKeys);
+		std::swap(RayOrder, TempRayOrder);
+	}
+
+	NextPaths.Clear();
+	for (int PathIndex : RayOrder)
+	{
+		NextPaths.Push(Paths.Rays[PathIndex], Paths.Throughputs[PathIndex], Paths.SampleIndices[PathIndex]);
+	}
+
+	std::swap(Paths, NextPaths);
+}
+
+void WavefrontPathTracer::Extend(const RayTracerScene& Scene, bool bCoherent)
+{
+	const int NumPaths = Paths.GetNumPaths();
+
+	HitResults.assign(NumPaths, RayHitResult());
+	HitShapeIndices.resize(NumPaths);
+
+	if (bCoherent)
+	{
+		for (int First = 0; First < NumPaths; First += RayPacketSize)
+		{
+			const int NumRays = Math::Min(RayPacketSize, NumPaths - First);
+
+#if ENABLE_TRAVERSAL_STATS
+			const long long CostBefore = GThreadTraversalCounters.GetCost();
+#endif
+
+			Scene.FindIntersectionWithScene(RRayPacket(&Paths.Rays[First], NumRays), &HitResults[First], &HitShapeIndices[First]);
+
+#if ENABLE_TRAVERSAL_STATS
+			// Rays of a packet share its traversal cost. The remainder goes to the first rays, so the packet's total is kept.
+			const long long PacketCost = GThreadTraversalCounters.GetCost() - CostBefore;
+			for (int i = 0; i < NumRays; i++)
+			{
+				SampleTraversalCosts[Paths.SampleIndices[First + i]] += PacketCost / NumRays + (i < PacketCost % NumRays ? 1 : 0);
+			}
+#endif
+		}
+	}
+	else
+	{
+		for (int i = 0; i < NumPaths; i++)
+		{
+#if ENABLE_TRAVERSAL_STATS
+			const long long CostBefore = GThreadTraversalCounters.GetCost();
+#endif
+
+			HitShapeIndices[i] = Scene.FindIntersectionWithScene(Paths.Rays[i], HitResults[i]);
+
+#if ENABLE_TRAVERSAL_STATS
+			SampleTraversalCosts[Paths.SampleIndices[i]] += GThreadTraversalCounters.GetCost() - CostBefore;
+#endif
+		}
+	}
+}
+
+void WavefrontPathTracer::SampleTextures()
+{
+	const int NumPaths = Paths.GetNumPaths();
+
+	TextureOrder.clear();
+	for (int i = 0; i < NumPaths; i++)
+	{
+		if (HitResults[i].Texture)
+		{
+			TextureOrder.push_back(i);
+		}
+	}
+
+	// Sampling uses no random numbers, so results don't depend on the order of textures in memory
+	std::sort(TextureOrder.begin(), TextureOrder.end(), [this](int a, int b) {
+		return std::less<const RTexture*>()(HitResults[a].Texture, HitResults[b].Texture);
+	});
+
+	for (int HitIndex : TextureOrder)
+	{
+		RayTracerScene::SampleHitTexture(HitResults[HitIndex]);
+	}
+}
+
+void WavefrontPathTracer::SortByMaterial(const RayTracerScene& Scene)
+{
+	const int NumPaths = Paths.GetNumPaths();
+
+	// Counting sort on material record. Key 0 is for paths hitting nothing, key 1 for hits without materials.
+	auto GetMaterialKey = [this, &Scene](int PathIndex) {
+		const int HitShapeIndex = HitShapeIndices[PathIndex];
+		return HitShapeIndex == -1 ? 0 : Scene.GetShapeMaterialIndex(HitShapeIndex) + 2;
+	};
+
+	MaterialOffsets.assign(Scene.GetMaterialTable().GetNumRecords() + 3, 0);
+	for (int i = 0; i < NumPaths; i++)
+	{
+		MaterialOffsets[GetMaterialKey(i) + 1]++;
+	}
+
+	for (size_t Bucket = 1; Bucket < MaterialOffsets.size(); Bucket++)
+	{
+		MaterialOffsets[Bucket] += MaterialOffsets[Bucket - 1];
+	}
+
+	ShadeOrder.resize(NumPaths);
+	for (int i = 0; i < NumPaths; i++)
+	{
+		ShadeOrder[MaterialOffsets[GetMaterialKey(i)]++] = i;
+	}
+}
+
+void WavefrontPathTracer::Shade(const RayTracerScene& Scene, int BouncesLeft, RVec3 OutColors[], const RenderOption& InOption)
+{
+	NextPaths.Clear();
+
+	// Bounced rays are only queued if they still have bounces left
+	const bool bContinuePaths = BouncesLeft > 1;
+
+	const MaterialTable& Materials = Scene.GetMaterialTable();
+
+	for (int PathIndex : ShadeOrder)
+	{
+		const RRay& InRay = Paths.Rays[PathIndex];
+		const RVec3& Throughput = Paths.Throughputs[PathIndex];
+		const int SampleIndex = Paths.SampleIndices[PathIndex];
+		const RayHitResult& Result = HitResults[PathIndex];
+		const int HitShapeIndex = HitShapeIndices[PathIndex];
+
+		if (HitShapeIndex == -1)
+		{
+			OutColors[SampleIndex] += Throughput * RayTracerScene::GetSkyColor(InRay.Direction);
+			continue;
+		}
+
+		const int MaterialIndex = Scene.GetShapeMaterialIndex(HitShapeIndex);
+		if (MaterialIndex == -1)
+		{
+			continue;
+		}
+
+		if (InOption.UseBaseColor)
+		{
+			// Base color render pass for previewing
+			OutColors[SampleIndex] += Throughput * Materials.PreviewColor(MaterialIndex, Result) * Result.SampledColor;
+			continue;
+		}
+
+		RRay OutRay;
+		auto BounceResult = Materials.BounceViewRay(MaterialIndex, InRay, Result, OutRay);
+
+		// Ray cone keeps growing from the hit point, bounced rays are treated like mirror reflections
+		const float HitConeWidth = InRay.ConeWidth + InRay.ConeSpreadAngle * Result.Distance;
+
+		if (RMath::Random() <= Result.SampledAlpha)
+		{
+			// Early out further ray tracing if attenuation reaches zero
+			if (bContinuePaths && BounceResult.Attenuation.IsNonZero())
+			{
+				OutRay.ConeWidth = HitConeWidth;
+				OutRay.ConeSpreadAngle = InRay.ConeSpreadAngle;
+				NextPaths.Push(OutRay, Throughput * BounceResult.Attenuation * Result.SampledColor, SampleIndex);
+			}
+
+			OutColors[SampleIndex] += Throughput * BounceResult.Emissive;
+		}
+		else if (bContinuePaths)
+		{
+			// Transparent, continue tracing the view ray in current direction
+			float RayDistance = InRay.Distance - Result.Distance;
+			OutRay = RRay(Result.HitPosition + InRay.Direction * BounceRayStartOffset, InRay.Direction, RayDistance);
+			OutRay.ConeWidth = HitConeWidth;
+			OutRay.ConeSpreadAngle = InRay.ConeSpreadAngle;
+			NextPaths.Push(OutRay, Throughput, SampleIndex);
+		}
+	}
+}
@@ -0,0 +1,104 @@
+//=============================================================================
+// WavefrontPathTracer.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// 
+//=============================================================================
+
+#pragma once
+
+#include "RayTracerScene.h"
+#include "TraversalStats.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Path states stored as one array per field. States are appended in order, so queues never have holes.
+struct PathStateQueue
+{
+	void Clear();
+
+	// Reserve memory for a number of paths, so pushing them never allocates
+	void Reserve(int NumPaths);
+
+	void Push(const RRay& InRay, const RVec3& InThroughput, int InSampleIndex);
+
+	int GetNumPaths() const;
+
+	std::vector<RRay> Rays;
+
+	// Fraction of light carried along the path back to its sample
+	std::vector<RVec3> Throughputs;
+
+	// Sample receiving light found by the path
+	std::vector<int> SampleIndices;
+};
+
+// Traces batches of paths stage by stage instead of following one path at a time.
+// Each bounce intersects all live paths with the scene, sorts the hits by material and shades them,
+// then continues with the queue of bounced rays.
+class WavefrontPathTracer
+{
+public:
+	// Trace paths starting from camera rays and output color of each ray.
+	// Neighbouring camera rays are expected to be coherent and are traced in packets.
+	void TracePaths(const RayTracerScene& Scene, const RRay CameraRays[], int NumRays, int MaxBounceTimes, RVec3 OutColors[], const RenderOption& InOption = RenderOption());
+
+#if ENABLE_TRAVERSAL_STATS
+	// Traversal cost of each camera ray's path during the last call to TracePaths
+	const long long* GetSampleTraversalCosts() const;
+#endif
+
+private:
+	// Reorder paths by ray origin and direction octant, so neighbouring rays of the queue traverse similar parts of the scene
+	void ReorderPaths();
+
+	// Find intersections of all live paths with the scene
+	void Extend(const RayTracerScene& Scene, bool bCoherent);
+
+	// Sample textures of all hits ordered by texture, so lookups of a texture are done together
+	void SampleTextures();
+
+	// Order hits by material, so all hits of a material are shaded together
+	void SortByMaterial(const RayTracerScene& Scene);
+
+	// Shade hits in material order, add light to samples and queue bounced rays
+	void Shade(const RayTracerScene& Scene, int BouncesLeft, RVec3 OutColors[], const RenderOption& InOption);
+
+	// Paths of the current bounce and the ones continuing to the next bounce
+	PathStateQueue Paths;
+	PathStateQueue NextPaths;
+
+	// Intersections of current paths by path index. Shape index is -1 if nothing is hit.
+	std::vector<RayHitResult> HitResults;
+	std::vector<int> HitShapeIndices;
+
+	// Sort keys of paths and path indices in sorted order. Temporary buffers are used by radix sort passes.
+	std::vector<uint32_t> RayKeys;
+	std::vector<uint32_t> TempRayKeys;
+	std::vector<int> RayOrder;
+	std::vector<int> TempRayOrder;
+
+	// Indices of textured hits sorted by texture
+	std::vector<int> TextureOrder;
+
+	// Path indices sorted by material record of the hit. Paths hitting nothing come first, then hits without materials.
+	std::vector<int> ShadeOrder;
+	std::vector<int> MaterialOffsets;
+
+#if ENABLE_TRAVERSAL_STATS
+	std::vector<long long> SampleTraversalCosts;
+#endif
+};
+
+
+FORCEINLINE int PathStateQueue::GetNumPaths() const
+{
+	return (int)Rays.size();
+}
+
+#if ENABLE_TRAVERSAL_STATS
+FORCEINLINE const long long* WavefrontPathTracer::GetSampleTraversalCosts() const
+{
+	return SampleTraversalCosts.data();
+}
+#endif